@@ -23,6 +23,8 @@
 
 #include <SPI.h>
 #include <Ethernet.h>
+#include <utility/w5100.h>
+#include <utility/socket.h>
 #include <EthernetBonjour.h>
 
 // Enter a MAC address and IP address for your controller below.
@@ -36,10 +38,11 @@ byte ip[] = {10,0,1,100};
 // Initialize the Ethernet server library
 // with the IP address and port you want to use 
 // (port 80 is default for HTTP):
+#define SERVERPORT 80
 #if defined(ARDUINO) && ARDUINO >= 100
-EthernetServer server(80);
+EthernetServer server(SERVERPORT);
 #else
-Server server(80);
+Server server(SERVERPORT);
 #endif
 
 void setup()
@@ -64,236 +67,3203 @@ void setup()
   // report the dhcp IP address:
   Serial.println(Ethernet.localIP());
 #endif
+#endif
+#if DEBUG
+  Serial.println(BOARDNAME);
 #endif
   server.begin();
+
+  startScanner();
   
   EthernetBonjour.begin("restduino");
 }
 
-//  url buffer size
+//  url buffer size; on a 2K board it holds a method and URL of up
+//  to about 110 characters
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
 #define BUFSIZE 255
+#else
+#define BUFSIZE 112
+#endif
 
 // Toggle case sensitivity
 #define CASESENSE true
 
-void loop()
-{
-  // needed to continue Bonjour/Zeroconf name registration
-  EthernetBonjour.run();
-  
-  char clientline[BUFSIZE];
-  int index = 0;
-  // listen for incoming clients
-#if defined(ARDUINO) && ARDUINO >= 100
-  EthernetClient client = server.available();
+//  maximum number of path segments kept per request
+#define MAXSEGMENTS 5
+
+//  response bytes collected before they are handed to the W5100;
+//  a 2K board gives up some segment size for SRAM
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define TXSIZE 255
 #else
-  Client client = server.available();
+#define TXSIZE 192
 #endif
-  if (client) {
 
-    //  reset input buffer
-    index = 0;
+//  room kept in front of each HTTP chunk for its size (three hex
+//  digits, enough for any TXSIZE up to 4K) and line break
+#define CHUNKHEADER 5
 
-    while (client.connected()) {
-      if (client.available()) {
-        char c = client.read();
+//  contentLength values for bodies whose length isn't known up front
+#define CHUNKED -1
+#define UNTILCLOSE -2
 
-        //  fill url the buffer
-        if(c != '\n' && c != '\r' && index < BUFSIZE){ // Reads until either an eol character is reached or the buffer is full
-          clientline[index++] = c;
-          continue;
-        }  
-
-#if DEBUG
-        Serial.print("client available bytes before flush: "); Serial.println(client.available());
-        Serial.print("request = "); Serial.println(clientline);
+//  input registers captured by a port snapshot, indexed
+//  by the core's port numbers (PA = 1, PB = 2, ...)
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define PORTCOUNT 13
+#else
+#define PORTCOUNT 5
 #endif
 
-        // Flush any remaining bytes from the client buffer
-        client.flush();
+//  the board descriptor: which board this is, and the pins its
+//  Ethernet hardware claims for itself (W5100 and SD card selects,
+//  on top of the SPI pins the core names); pin counts and PWM
+//  capability come from the core's pin definitions for the board
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define BOARDNAME "Mega2560"
+#define ETHERNETSELECT 10
+#define SDSELECT 4
+#elif defined(__AVR_ATmega1284P__)
+#define BOARDNAME "WildFire"
+#define ETHERNETSELECT 10
+#define SDSELECT 4
+#elif defined(ARDUINO_AVR_ETHERNET)
+#define BOARDNAME "Ethernet"
+#define ETHERNETSELECT 10
+#define SDSELECT 4
+#else
+#define BOARDNAME "Uno"
+#define ETHERNETSELECT 10
+#define SDSELECT 4
+#endif
 
-#if DEBUG
-        // Should be 0
-        Serial.print("client available bytes after flush: "); Serial.println(client.available());
+//  analog inputs A0 up to SCANCHANNELS - 1 are sampled all the time
+//  by the ADC interrupt, so reading one never waits on a conversion;
+//  each keeps HISTORYSIZE (a power of two) samples, one every
+//  HISTORY_INTERVAL milliseconds
+#define SCANCHANNELS NUM_ANALOG_INPUTS
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define HISTORYSIZE 32
+#else
+#define HISTORYSIZE 8
 #endif
+#define HISTORY_INTERVAL 100
+
+//  a conversion takes 13 ADC clocks at the core's prescaler of 128,
+//  so each channel is converted every SCANPERIOD microseconds and
+//  one in HISTORY_DECIMATE conversions goes into its history
+#define SCANPERIOD (SCANCHANNELS * 13L * 128 / (F_CPU / 1000000L))
+#define HISTORY_DECIMATE (HISTORY_INTERVAL * 1000L / SCANPERIOD)
 
-        //  convert clientline into a proper
-        //  string for further processing
-        String urlString = String(clientline);
+//  oversampling goes up to 4^MAXOVERSAMPLE (64x, 13 bits) and the
+//  moving average weight down to 1/2^MAXEMA
+#define MAXOVERSAMPLE 3
+#define MAXEMA 8
 
-        //  extract the operation
-        String op = urlString.substring(0,urlString.indexOf(' '));
+//  logic capture: the input register of one port is sampled by the
+//  Timer2 interrupt at up to MAXCAPTURERATE Hz and stored as runs of
+//  unchanged values, CAPTURESIZE runs of 3 bytes at most
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define CAPTURESIZE 512
+#else
+#define CAPTURESIZE 32
+#endif
+#define MAXCAPTURERATE 50000
 
-        //  we're only interested in the first part...
-        urlString = urlString.substring(urlString.indexOf('/'), urlString.indexOf(' ', urlString.indexOf('/')));
+//  capture states
+#define CAPTURE_IDLE 0
+#define CAPTURE_ARMED 1
+#define CAPTURE_RUNNING 2
+#define CAPTURE_DONE 3
 
-        //  put what's left of the URL back in client line
-#if CASESENSE
-        urlString.toUpperCase();
+//  edges of the trigger pin that start a capture; EDGE_NONE
+//  starts it straight away and keeps the latest runs until stopped
+#define EDGE_NONE 0
+#define EDGE_RISE 1
+#define EDGE_FALL 2
+#define EDGE_ANY 3
+
+//  pulse counters: external interrupts 0 and 1 count edges timed by
+//  micros(), the input capture pin FREQPIN of a 16-bit timer times
+//  them to the CPU clock; the timer's bit positions are the same as
+//  Timer1's on every board
+#define COUNTERS 3
+#define FREQCOUNTER 2
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+//  the Mega doesn't bring ICP1 out, Timer5's is on D48
+#define FREQPIN 48
+#define FREQ_TCCRA TCCR5A
+#define FREQ_TCCRB TCCR5B
+#define FREQ_TIMSK TIMSK5
+#define FREQ_TIFR TIFR5
+#define FREQ_TCNT TCNT5
+#define FREQ_ICR ICR5
+#define FREQ_CAPT_vect TIMER5_CAPT_vect
+#define FREQ_OVF_vect TIMER5_OVF_vect
+#define FREQ_TIMER(t) ((t) == TIMER5A || (t) == TIMER5B || (t) == TIMER5C)
+#else
+#if defined(__AVR_ATmega1284P__)
+#define FREQPIN 14
+#else
+#define FREQPIN 8
+#endif
+#define FREQ_TCCRA TCCR1A
+#define FREQ_TCCRB TCCR1B
+#define FREQ_TIMSK TIMSK1
+#define FREQ_TIFR TIFR1
+#define FREQ_TCNT TCNT1
+#define FREQ_ICR ICR1
+#define FREQ_CAPT_vect TIMER1_CAPT_vect
+#define FREQ_OVF_vect TIMER1_OVF_vect
+#define FREQ_TIMER(t) ((t) == TIMER1A || (t) == TIMER1B)
 #endif
-        urlString.toCharArray(clientline, BUFSIZE);
 
-        //  get the first two parameters
-        char *pin = strtok(clientline,"/");
-        char *value = strtok(NULL,"/");
+//  pins covered by the pin table, enough for a Mega
+#define MAXPINS 70
 
-        //  this is where we actually *do something*!
-        char outValue[10] = "MU";
-        String jsonOut = String();
+//  pin table flags
+#define PIN_DIGITAL 0x01
+#define PIN_PWM 0x02
+#define PIN_RESERVED 0x04
 
-        if(pin != NULL){
-          if(value != NULL){
+//  pin modes kept in the pin state table; UNSET pins haven't been
+//  used since reset
+#define MODE_UNSET 0
+#define MODE_INPUT 1
+#define MODE_OUTPUT 2
+#define MODE_PWM 3
 
-#if DEBUG
-            //  set the pin value
-            Serial.println("setting pin");
+//  outcome of addressing a pin, PIN_UNKNOWN answers 404,
+//  PIN_BADVALUE 400 and PIN_BUSY (no room to schedule) 503
+#define PIN_OK 0
+#define PIN_UNKNOWN 1
+#define PIN_BADVALUE 2
+#define PIN_BUSY 3
+
+//  timed pin actions wait in a heap of SCHEDULESIZE events, at most
+//  SCHEDULE_MAXDELAY microseconds ahead; pulses up to PULSE_INLINE
+//  microseconds are timed inline with interrupts off instead, for
+//  less than one ADC conversion so the scan doesn't lose one
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define SCHEDULESIZE 16
+#else
+#define SCHEDULESIZE 6
 #endif
+#define SCHEDULE_MAXDELAY 2000000000UL
+#define PULSE_INLINE 50
 
-            //  select the pin
-            int selectedPin = atoi (pin);
-#if DEBUG
-            Serial.println(selectedPin);
+//  scheduled event kinds
+#define EVENT_LEVEL 0
+#define EVENT_PWM 1
+#define EVENT_RAMP 2
+
+//  clients served at once; the W5100 has four sockets and
+//  Bonjour keeps one, each connection costs a BUFSIZE buffer
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define MAXCONNECTIONS 3
+#else
+#define MAXCONNECTIONS 2
 #endif
 
-            //  set the pin for output
-            pinMode(selectedPin, OUTPUT);
+//  bytes read from one connection per pass through loop()
+#define READ_BUDGET 32
 
-            //  determine digital or analog (PWM)
-            if(strncmp(value, "HIGH", 4) == 0 || strncmp(value, "LOW", 3) == 0){
+//  close a persistent connection after this many idle milliseconds,
+//  or a client that stalls part way through a request
+#define KEEPALIVE_TIMEOUT 5000
+#define REQUEST_TIMEOUT 2000
 
-#if DEBUG
-              //  digital
-              Serial.println("digital");
-#endif
+//  give up on a peer that does not take our data or our FIN
+//  within this many milliseconds and drop the socket
+#define CLOSE_TIMEOUT 1000
 
-              if(strncmp(value, "HIGH", 4) == 0){
-#if DEBUG
-                Serial.println("HIGH");
+//  a response is only started once the socket has sent everything
+//  before it; drop a client that leaves it unread this many
+//  milliseconds. A response larger than the socket's buffer waits
+//  at most SEND_WAIT milliseconds for each buffer full to go.
+#define SEND_TIMEOUT 2000
+#define SEND_WAIT 100
+
+//  server-sent event streams: how many pins each may watch, how often
+//  (ms) the pins are sampled, how far an analog reading must move
+//  before it is reported and how often (ms) an idle stream gets a
+//  comment line to keep it alive
+#define MAXWATCH 8
+#define EVENTS_INTERVAL 50
+#define EVENTS_DEADBAND 4
+#define EVENTS_HEARTBEAT 15000
+
+//  connection states
+#define CONN_FREE 0
+#define CONN_READING 1
+#define CONN_DISPATCH 2
+#define CONN_STREAMING 3
+#define CONN_DRAINING 4
+#define CONN_CLOSING 5
+
+//  request parser states
+#define PARSE_METHOD 0
+#define PARSE_PATH 1
+#define PARSE_QUERY 2
+#define PARSE_VERSION 3
+#define PARSE_HEADERS 4
+#define PARSE_DONE 5
+
+//  the request currently being parsed; method, path segments
+//  and query string are null-terminated slices of buffer
+typedef struct {
+  byte state;
+  boolean error;
+  byte index;
+  byte lineLength;
+  byte headerMatch;
+  boolean newSegment;
+  boolean keepAlive;
+  boolean chunked;
+  char *method;
+  char *segments[MAXSEGMENTS];
+  byte segmentCount;
+  char *query;
+  char buffer[BUFSIZE];
+} Request;
+
+//  a pin watched by an event stream and the value last reported
+typedef struct {
+  boolean analog;
+  byte pin;
+  int value;
+} Watch;
+
+//  the watch list of an /EVENTS connection
+typedef struct {
+  int deadband;
+  unsigned long lastSample;
+  unsigned long lastSent;
+  byte watchCount;
+  Watch watches[MAXWATCH];
+} EventStream;
+
+//  one client socket; a streaming connection no longer needs
+//  its request, so the two share storage
+typedef struct {
+#if defined(ARDUINO) && ARDUINO >= 100
+  EthernetClient client;
+#else
+  Client client;
 #endif
-                digitalWrite(selectedPin, HIGH);
-              }
+  byte state;
+  unsigned long lastActivity;
+  union {
+    Request request;
+    EventStream events;
+  };
+} Connection;
+
+Connection connections[MAXCONNECTIONS];
 
-              if(strncmp(value, "LOW", 3) == 0){
 #if DEBUG
-                Serial.println("LOW");
+//  longest pass through loop() so far, in microseconds
+unsigned long worstLoopMicros = 0;
 #endif
-                digitalWrite(selectedPin, LOW);
-              }
 
-            } 
-            else {
+//  header name matched (lower case) to pick up keep-alive requests
+const char connectionHeader[] PROGMEM = "connection:";
 
-#if DEBUG
-              //  analog
-              Serial.println("analog");
+//  flags for every digital pin of the board, worked out at compile
+//  time from the core's pin macros and the board descriptor
+#define PINFLAGS(p) ((p) >= NUM_DIGITAL_PINS ? 0 : \
+  PIN_DIGITAL | \
+  (digitalPinHasPWM(p) ? PIN_PWM : 0) | \
+  (((p) == SS || (p) == MOSI || (p) == MISO || (p) == SCK || \
+    (p) == ETHERNETSELECT || (p) == SDSELECT) ? PIN_RESERVED : 0))
+#define PINROW(p) PINFLAGS(p), PINFLAGS(p + 1), PINFLAGS(p + 2), \
+  PINFLAGS(p + 3), PINFLAGS(p + 4), PINFLAGS(p + 5), PINFLAGS(p + 6), \
+  PINFLAGS(p + 7), PINFLAGS(p + 8), PINFLAGS(p + 9)
+
+const byte pinTable[MAXPINS] PROGMEM = {
+  PINROW(0), PINROW(10), PINROW(20), PINROW(30),
+  PINROW(40), PINROW(50), PINROW(60)
+};
+
+//  what each digital pin was last set to: its mode, and the level
+//  or PWM duty written to it (up to the TOP of a reconfigured timer)
+typedef struct {
+  byte mode;
+  unsigned int value;
+} PinState;
+
+PinState pinStates[NUM_DIGITAL_PINS];
+
+//  the latest reading of a scanned analog input and its history,
+//  oldest sample at next once the ring has filled; with oversample
+//  n each reading is 4^n conversions summed and shifted down to
+//  10 + n bits, then optionally smoothed by a moving average of
+//  weight 1/2^emaShift
+typedef struct {
+  int latest;
+  int samples[HISTORYSIZE];
+  byte next;
+  byte count;
+  unsigned int countdown;
+  byte oversample;
+  byte emaShift;
+  boolean emaPrimed;
+  byte accumulated;
+  unsigned int accumulator;
+  long emaSum;
+} AnalogChannel;
+
+volatile AnalogChannel analogChannels[SCANCHANNELS];
+volatile byte scanChannel;
+
+//  a run of identical port samples
+typedef struct {
+  byte value;
+  unsigned int length;
+} CaptureRun;
+
+//  the capture in progress or last finished; runs is a ring, the
+//  run being extended at head and the oldest after it once full.
+//  Timer2 is borrowed for the capture and its registers put back
+//  afterwards
+typedef struct {
+  byte state;
+  byte edge;
+  byte port;
+  byte triggerMask;
+  byte last;
+  volatile uint8_t *input;
+  long rate;
+  unsigned int head;
+  unsigned int count;
+  byte savedTCCR2A;
+  byte savedTCCR2B;
+  byte savedOCR2A;
+  byte savedTIMSK2;
+  CaptureRun runs[CAPTURESIZE];
+} Capture;
+
+volatile Capture capture;
+
+//  an edge counter; last and period are in ticks of its clock
+//  (microseconds, or CPU cycles for input capture) and the reported
+//  fields mark where the previous reading left off
+typedef struct {
+  boolean active;
+  unsigned long count;
+  unsigned long last;
+  unsigned long period;
+  unsigned long reportedCount;
+  unsigned long reportedLast;
+} PulseCounter;
+
+volatile PulseCounter pulseCounters[COUNTERS];
+
+//  overflows of the input capture timer, which extend it to 32 bits,
+//  and its registers from before it was taken over
+volatile unsigned int freqOverflows;
+byte freqSavedTCCRA;
+byte freqSavedTCCRB;
+byte freqSavedTIMSK;
+
+//  a pending pin action: drive the pin to level or PWM duty to, or
+//  step a PWM ramp from from to to over duration microseconds
+//  begun at start
+typedef struct {
+  unsigned long due;
+  unsigned long start;
+  unsigned long duration;
+  byte kind;
+  byte pin;
+  unsigned int from;
+  unsigned int to;
+} ScheduledEvent;
+
+//  pending actions as a binary min-heap on due time
+ScheduledEvent schedule[SCHEDULESIZE];
+byte scheduleCount = 0;
+
+//  a 16-bit timer whose PWM frequency and resolution can be set
+//  through /PWM/<number>: its registers and the core's timer ids of
+//  its outputs A, B and C, which never change and stay in flash
+typedef struct {
+  byte number;
+  volatile uint8_t *tccra;
+  volatile uint8_t *tccrb;
+  volatile uint16_t *tcnt;
+  volatile uint16_t *icr;
+  volatile uint16_t *ocr[3];
+  byte outputs[3];
+} PwmTimerInfo;
+
+#if defined(OCR1C)
+#define PWMTIMER(n) { n, &TCCR##n##A, &TCCR##n##B, &TCNT##n, &ICR##n, \
+  { &OCR##n##A, &OCR##n##B, &OCR##n##C }, \
+  { TIMER##n##A, TIMER##n##B, TIMER##n##C } }
+#else
+#define PWMTIMER(n) { n, &TCCR##n##A, &TCCR##n##B, &TCNT##n, &ICR##n, \
+  { &OCR##n##A, &OCR##n##B, NULL }, \
+  { TIMER##n##A, TIMER##n##B, NOT_ON_TIMER } }
 #endif
-              //  get numeric value
-              int selectedValue = atoi(value);              
-#if DEBUG
-              Serial.println(selectedValue);
+
+const PwmTimerInfo pwmTimerInfo[] PROGMEM = {
+  PWMTIMER(1),
+#if defined(TCCR3A)
+  PWMTIMER(3),
+#endif
+#if defined(TCCR4A)
+  PWMTIMER(4),
 #endif
-              analogWrite(selectedPin, selectedValue);
+#if defined(TCCR5A)
+  PWMTIMER(5),
+#endif
+};
 
-            }
+#define PWMTIMERS (sizeof(pwmTimerInfo) / sizeof(pwmTimerInfo[0]))
 
-            //  return status
-            client.println("HTTP/1.1 200 OK");
-            client.println("Content-Type: text/html");
-            client.println("Access-Control-Allow-Origin: *");
-            client.println();
+//  how each timer has been set up, in the order of pwmTimerInfo;
+//  until then it runs the core's 8-bit phase correct PWM
+typedef struct {
+  boolean configured;
+  boolean phaseCorrect;
+  byte prescale;
+  unsigned int top;
+  byte savedTCCRA;
+  byte savedTCCRB;
+} PwmTimer;
 
-          } 
-          else {
-#if DEBUG
-            //  read the pin value
-            Serial.println("reading pin");
+PwmTimer pwmTimers[PWMTIMERS];
+
+//  the clock dividers a 16-bit timer's CSn2:0 select, from 1
+const unsigned int timerPrescalers[] PROGMEM = { 1, 8, 64, 256, 1024 };
+
+//  a pin named in a request: an analog input channel or a digital
+//  pin number
+typedef struct {
+  boolean analog;
+  byte pin;
+} PinAddress;
+
+void resetRequest(Request *req)
+{
+  req->state = PARSE_METHOD;
+  req->error = false;
+  req->index = 0;
+  req->lineLength = 0;
+  req->headerMatch = 0;
+  req->newSegment = false;
+  req->keepAlive = false;
+  req->chunked = false;
+  req->method = req->buffer;
+  req->segmentCount = 0;
+  req->query = NULL;
+  req->buffer[0] = '\0';
+}
+
+//  append one byte to the request buffer, leaving room for
+//  the terminator; overlong requests are flagged, not truncated
+void storeRequestByte(Request *req, char c)
+{
+  if(req->index < BUFSIZE - 1){
+    req->buffer[req->index++] = c;
+  } 
+  else {
+    req->error = true;
+  }
+}
+
+//  feed one byte from the client into the parser and
+//  return the resulting parser state
+byte parseRequest(Request *req, char c)
+{
+  switch(req->state){
+  case PARSE_METHOD:
+    if(c == ' '){
+      storeRequestByte(req, '\0');
+      req->state = PARSE_PATH;
+    } 
+    else if(c == '\r' || c == '\n'){
+      //  tolerate blank lines ahead of the request line
+      if(req->index > 0){
+        req->error = true;
+        req->state = PARSE_DONE;
+      }
+    } 
+    else {
+      storeRequestByte(req, c);
+    }
+    break;
+
+  case PARSE_PATH:
+  case PARSE_QUERY:
+    if(c == ' ' || c == '\r' || c == '\n'){
+      storeRequestByte(req, '\0');
+
+      //  a request line without a version has no headers
+      req->state = (c == ' ') ? PARSE_VERSION : PARSE_DONE;
+      break;
+    }
+
+    if(req->state == PARSE_PATH && c == '?'){
+      storeRequestByte(req, '\0');
+      req->query = &req->buffer[req->index];
+      req->state = PARSE_QUERY;
+      //  a slash ahead of the '?' doesn't start a segment
+      req->newSegment = false;
+      break;
+    }
+
+#if CASESENSE
+    c = toupper(c);
 #endif
 
-            //  determine analog or digital
-            if(pin[0] == 'a' || pin[0] == 'A'){
+    if(req->state == PARSE_PATH && c == '/'){
+      //  collapse runs of slashes into one separator
+      if(!req->newSegment && req->segmentCount > 0){
+        storeRequestByte(req, '\0');
+      }
+      req->newSegment = true;
+      break;
+    }
+
+    if(req->newSegment){
+      if(req->segmentCount < MAXSEGMENTS && req->index < BUFSIZE - 1){
+        req->segments[req->segmentCount++] = &req->buffer[req->index];
+      }
+      req->newSegment = false;
+    }
+    storeRequestByte(req, c);
+    break;
 
-              //  analog
-              int selectedPin = pin[1] - '0';
+  case PARSE_VERSION:
+    //  HTTP/1.1 and later keep the connection open by default
+    //  and understand chunked bodies
+    if(c >= '0' && c <= '9'){
+      req->keepAlive = (c != '0');
+      req->chunked = (c != '0');
+    }
 
-#if DEBUG
-              Serial.println(selectedPin);
-              Serial.println("analog");
+    if(c == '\n'){
+      req->lineLength = 0;
+      req->state = PARSE_HEADERS;
+    }
+    break;
+
+  case PARSE_HEADERS:
+    if(c == '\n'){
+      //  an empty line ends the headers
+      if(req->lineLength == 0){
+        req->state = PARSE_DONE;
+      }
+      req->lineLength = 0;
+      req->headerMatch = 0;
+      break;
+    }
+
+    if(c == '\r'){
+      break;
+    }
+
+    //  match "Connection:" and look at the first letter of its value
+    if(req->headerMatch == req->lineLength && req->lineLength < sizeof(connectionHeader) - 1){
+      if(tolower(c) == pgm_read_byte(&connectionHeader[req->lineLength])){
+        req->headerMatch++;
+      }
+    } 
+    else if(req->headerMatch == sizeof(connectionHeader) - 1 && c != ' '){
+      if(c == 'c' || c == 'C'){
+        req->keepAlive = false;
+      }
+      if(c == 'k' || c == 'K'){
+        req->keepAlive = true;
+      }
+      req->headerMatch = 0;
+    }
+
+    if(req->lineLength < 255){
+      req->lineLength++;
+    }
+    break;
+  }
+
+  return req->state;
+}
+
+//  fixed response headers, kept in flash rather than SRAM
+const char header200[] PROGMEM = "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/html\r\n"
+  "Access-Control-Allow-Origin: *\r\n";
+const char header400[] PROGMEM = "HTTP/1.1 400 Bad Request\r\n"
+  "Content-Type: text/html\r\n"
+  "Access-Control-Allow-Origin: *\r\n";
+const char header404[] PROGMEM = "HTTP/1.1 404 Not Found\r\n"
+  "Content-Type: text/html\r\n"
+  "Access-Control-Allow-Origin: *\r\n";
+const char header503[] PROGMEM = "HTTP/1.1 503 Service Unavailable\r\n"
+  "Content-Type: text/html\r\n"
+  "Access-Control-Allow-Origin: *\r\n";
+const char headerEvents[] PROGMEM = "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/event-stream\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "\r\n";
+const char headerLength[] PROGMEM = "Content-Length: ";
+const char headerChunked[] PROGMEM = "Transfer-Encoding: chunked\r\n";
+const char headerKeepAlive[] PROGMEM = "Connection: keep-alive\r\n\r\n";
+const char headerClose[] PROGMEM = "Connection: close\r\n\r\n";
+
+//  response bytes are gathered here and handed to the W5100 in one
+//  write, so a response normally leaves in a single TCP segment;
+//  between beginChunks() and endChunks() every buffer full is
+//  framed as one HTTP chunk, so bodies of any length can be sent
+//  without being held in SRAM first
+char txBuffer[TXSIZE];
+
+//  SRAM on a 2K board: everything the sketch can name is counted by
+//  its size, and what it can't is kept back as measured for an
+//  ATmega328P at -Os: 150 bytes of string literals and vtables in the
+//  sketch and EthernetBonjour, 40 of EthernetBonjour's file statics,
+//  46 for DHCP and 19 for the core, then 520 of stack for the deepest
+//  call, an mDNS answer sent from loop() with an interrupt on top
+#if defined(__AVR__) && RAMEND < 0x1000
+#define SRAMUNNAMED (150 + 40 + 46 + 19)
+#define STACKRESERVE 520
+
+static_assert(sizeof(connections) + sizeof(txBuffer) + sizeof(analogChannels) +
+  sizeof(scanChannel) + sizeof(capture) + sizeof(schedule) + sizeof(scheduleCount) +
+  sizeof(pulseCounters) + sizeof(freqOverflows) + sizeof(freqSavedTCCRA) +
+  sizeof(freqSavedTCCRB) + sizeof(freqSavedTIMSK) + sizeof(pinStates) +
+  sizeof(pwmTimers) + sizeof(mac) + sizeof(server) +
+  sizeof(Ethernet) + sizeof(EthernetClass::_state) + sizeof(EthernetClass::_server_port) +
+  sizeof(W5100) + sizeof(EthernetBonjour) +
+  SRAMUNNAMED + STACKRESERVE <= RAMEND + 1 - RAMSTART, "sketch too large for the board's SRAM");
 #endif
 
-              sprintf(outValue,"%d",analogRead(selectedPin));
+//  digits for chunk sizes and port masks
+const char hexDigits[] PROGMEM = "0123456789ABCDEF";
 
-#if DEBUG
-              Serial.println(outValue);
+//  free space in a socket's W5100 transmit buffer; all of it,
+//  W5100.SSIZE, once everything written before has been sent
+unsigned int transmitRoom(byte sock)
+{
+#if defined(SPI_ETHERNET_SETTINGS)
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+#endif
+  unsigned int room = W5100.getTXFreeSize(sock);
+#if defined(SPI_ETHERNET_SETTINGS)
+  SPI.endTransaction();
 #endif
+  return room;
+}
 
-            } 
-            else if(pin[0] != NULL) {
+//  copy bytes into a socket's transmit buffer behind those already
+//  there, for the next transmitSend(); the caller makes sure there
+//  is room
+void transmitQueue(byte sock, const char *data, unsigned int length)
+{
+#if defined(SPI_ETHERNET_SETTINGS)
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+#endif
+  W5100.send_data_processing(sock, (const uint8_t *)data, length);
+#if defined(SPI_ETHERNET_SETTINGS)
+  SPI.endTransaction();
+#endif
+}
 
-              //  digital
-              int selectedPin = pin[0] - '0';
+//  send what has been queued on a socket; unlike the library's
+//  send() this doesn't wait for the client to take it
+void transmitSend(byte sock)
+{
+#if defined(SPI_ETHERNET_SETTINGS)
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+#endif
+  W5100.writeSnIR(sock, SnIR::SEND_OK);
+  W5100.execCmdSn(sock, Sock_SEND);
+#if defined(SPI_ETHERNET_SETTINGS)
+  SPI.endTransaction();
+#endif
+}
 
-#if DEBUG
-              Serial.println(selectedPin);
-              Serial.println("digital");
+class ResponseBuffer : public Print {
+public:
+  //  only made for a socket that has sent everything before, so a
+  //  response up to the size of its buffer never waits on the client
+  ResponseBuffer(byte sock) : sock(sock), length(0), chunkStart(-1), queued(0),
+    dropped(false) {}
+  ~ResponseBuffer()
+  {
+    flush();
+    if(queued > 0){
+      transmitSend(sock);
+    }
+  }
+
+#if defined(ARDUINO) && ARDUINO >= 100
+  size_t write(uint8_t c)
+#else
+  void write(uint8_t c)
+#endif
+  {
+    //  a chunk needs two bytes left for its closing line break
+    if(length == ((chunkStart < 0) ? TXSIZE : TXSIZE - 2)){
+      flush();
+    }
+    txBuffer[length++] = c;
+#if defined(ARDUINO) && ARDUINO >= 100
+    return 1;
 #endif
+  }
+
+  void flush()
+  {
+    if(chunkStart >= 0){
+      closeChunk();
+    }
+    if(length > 0){
+      if(queued + length > W5100.SSIZE && !dropped){
+        dropped = !waitForRoom();
+      }
+      if(!dropped){
+        transmitQueue(sock, txBuffer, length);
+        queued += length;
+      }
+      length = 0;
+      //  a long response gives timed actions a turn after each buffer
+      runSchedule();
+    }
+    if(chunkStart >= 0){
+      beginChunks();
+    }
+  }
 
-              pinMode(selectedPin, INPUT);
+  void beginChunks()
+  {
+    chunkStart = length;
+    length += CHUNKHEADER;
+  }
+
+  //  the last chunk has size zero
+  void endChunks()
+  {
+    closeChunk();
+    chunkStart = -1;
+    print(F("0\r\n\r\n"));
+  }
 
-              int inValue = digitalRead(selectedPin);
+private:
+  //  a response that has outgrown the socket's buffer, which only
+  //  the longest on a Mega do, sends what it has and waits for the
+  //  client to take it; the client is dropped when it doesn't
+  boolean waitForRoom()
+  {
+    unsigned long start = millis();
 
-              if(inValue == 0){
-                sprintf(outValue,"%s","LOW");
-                //sprintf(outValue,"%d",digitalRead(selectedPin));
-              }
+    transmitSend(sock);
+    queued = 0;
+    while(transmitRoom(sock) < W5100.SSIZE){
+      if(millis() - start > SEND_WAIT){
+        close(sock);
+        return false;
+      }
+      runSchedule();
+    }
+    return true;
+  }
 
-              if(inValue == 1){
-                sprintf(outValue,"%s","HIGH");
-              }
+  //  fill in the size of the chunk being collected and end it; an
+  //  empty one is dropped, a zero size would end the body
+  void closeChunk()
+  {
+    int size = length - chunkStart - CHUNKHEADER;
 
-#if DEBUG
-              Serial.println(outValue);
-#endif
-            }
-
-            //  assemble the json output
-            jsonOut += "{\"";
-            jsonOut += pin;
-            jsonOut += "\":\"";
-            jsonOut += outValue;
-            jsonOut += "\"}";
-
-            //  return value with wildcarded Cross-origin policy
-            client.println("HTTP/1.1 200 OK");
-            client.println("Content-Type: text/html");
-            client.println("Access-Control-Allow-Origin: *");
-            client.println();
-            client.println(jsonOut);
-          }
-        } 
-        else {
-
-          //  error
-#if DEBUG
-          Serial.println("erroring");
+    if(size == 0){
+      length = chunkStart;
+      return;
+    }
+
+    for(int i = CHUNKHEADER - 3; i >= 0; i--){
+      txBuffer[chunkStart + i] = pgm_read_byte(&hexDigits[size & 0x0F]);
+      size >>= 4;
+    }
+    txBuffer[chunkStart + CHUNKHEADER - 2] = '\r';
+    txBuffer[chunkStart + CHUNKHEADER - 1] = '\n';
+    txBuffer[length++] = '\r';
+    txBuffer[length++] = '\n';
+  }
+
+  byte sock;
+  int length;
+  int chunkStart;
+  unsigned int queued;
+  boolean dropped;
+};
+
+//  writes a flat json object straight to the response as it is
+//  produced, values are formatted in place and never collected
+class JsonWriter {
+public:
+  JsonWriter(Print &out) : out(out), first(true) {}
+
+  void beginObject()
+  {
+    out.print('{');
+    first = true;
+  }
+
+  void key(const char *name)
+  {
+    separate();
+    out.print('"');
+    out.print(name);
+    out.print(F("\":"));
+  }
+
+  //  keys and values written as F("...") stay in flash
+  void key(const __FlashStringHelper *name)
+  {
+    separate();
+    out.print('"');
+    out.print(name);
+    out.print(F("\":"));
+  }
+
+  //  a key made of a letter and a number, like D13
+  void key(char prefix, int number)
+  {
+    separate();
+    out.print('"');
+    out.print(prefix);
+    out.print(number);
+    out.print(F("\":"));
+  }
+
+  void value(const char *text)
+  {
+    out.print('"');
+    out.print(text);
+    out.print('"');
+  }
+
+  void value(const __FlashStringHelper *text)
+  {
+    out.print('"');
+    out.print(text);
+    out.print('"');
+  }
+
+  void value(int number)
+  {
+    out.print(number);
+  }
+
+  void value(long number)
+  {
+    out.print(number);
+  }
+
+  void value(double number, byte digits)
+  {
+    out.print(number, digits);
+  }
+
+  //  arrays hold plain numbers
+  void beginArray()
+  {
+    out.print('[');
+    first = true;
+  }
+
+  void item(int number)
+  {
+    separate();
+    out.print(number);
+  }
+
+  void item(long number)
+  {
+    separate();
+    out.print(number);
+  }
+
+  void endArray()
+  {
+    out.print(']');
+    first = false;
+  }
+
+  //  objects nest as values of a key
+  void endObject()
+  {
+    out.print('}');
+    first = false;
+  }
+
+private:
+  void separate()
+  {
+    if(!first){
+      out.print(',');
+    }
+    first = false;
+  }
+
+  Print &out;
+  boolean first;
+};
+
+//  copy a string out of flash
+void printProgmem(Print &out, const char *text)
+{
+  char c;
+  while((c = pgm_read_byte(text++)) != '\0'){
+    out.print(c);
+  }
+}
+
+//  write one of the fixed header blocks plus the length and
+//  connection headers; exactly contentLength bytes must follow,
+//  or a chunked body, or one that ends when the connection does
+void sendHeaders(Print &client, const char *header, int contentLength, boolean keepAlive)
+{
+  printProgmem(client, header);
+  if(contentLength >= 0){
+    printProgmem(client, headerLength);
+    client.print(contentLength);
+    client.print(F("\r\n"));
+  } 
+  else if(contentLength == CHUNKED){
+    printProgmem(client, headerChunked);
+  }
+  printProgmem(client, keepAlive ? headerKeepAlive : headerClose);
+}
+
+//  start a 200 response whose body is streamed as it is produced:
+//  chunked for HTTP/1.1 clients, anything older reads until the
+//  connection is closed
+void beginBody(ResponseBuffer &out, Request *req)
+{
+  if(req->chunked){
+    sendHeaders(out, header200, CHUNKED, req->keepAlive);
+    out.beginChunks();
+  } 
+  else {
+    req->keepAlive = false;
+    sendHeaders(out, header200, UNTILCLOSE, false);
+  }
+}
+
+void endBody(ResponseBuffer &out, Request *req)
+{
+  if(req->chunked){
+    out.endChunks();
+  }
+}
+
+//  point the ADC at an analog input, referenced to AVcc like the
+//  core's DEFAULT
+void selectChannel(byte channel)
+{
+#if defined(MUX5)
+  ADCSRB = (ADCSRB & ~_BV(MUX5)) | ((channel & 0x08) ? _BV(MUX5) : 0);
 #endif
-          client.println("HTTP/1.1 404 Not Found");
-          client.println("Content-Type: text/html");
-          client.println();
+  ADMUX = _BV(REFS0) | (channel & 0x07);
+}
 
-        }
-        break;
+//  each finished conversion is filed under its channel and the next
+//  channel's conversion started straight away
+ISR(ADC_vect)
+{
+  volatile AnalogChannel *channel = &analogChannels[scanChannel];
+  int sample = ADC;
+
+  //  decimate: 4^n conversions give one reading 10 + n bits wide
+  channel->accumulator += sample;
+  if(++channel->accumulated >= (1 << (2 * channel->oversample))){
+    sample = channel->accumulator >> channel->oversample;
+    channel->accumulator = 0;
+    channel->accumulated = 0;
+
+    if(channel->emaShift > 0){
+      if(!channel->emaPrimed){
+        channel->emaSum = (long)sample << channel->emaShift;
+        channel->emaPrimed = true;
       }
+      channel->emaSum += sample - (channel->emaSum >> channel->emaShift);
+      sample = channel->emaSum >> channel->emaShift;
+    }
+    channel->latest = sample;
+  }
+
+  sample = channel->latest;
+  if(channel->countdown == 0){
+    channel->countdown = HISTORY_DECIMATE;
+    if(channel->count < HISTORYSIZE){
+      channel->count++;
+    }
+    channel->samples[channel->next] = sample;
+    channel->next = (channel->next + 1) & (HISTORYSIZE - 1);
+  }
+  channel->countdown--;
+
+  scanChannel = (scanChannel + 1 < SCANCHANNELS) ? scanChannel + 1 : 0;
+  selectChannel(scanChannel);
+  ADCSRA |= _BV(ADSC);
+}
+
+void startScanner()
+{
+  //  drop a result left over from analogRead()
+  ADCSRA |= _BV(ADIF);
+  selectChannel(scanChannel);
+  ADCSRA |= _BV(ADIE) | _BV(ADSC);
+}
+
+//  hand the ADC back for analogRead(), once the conversion in
+//  flight has finished
+void stopScanner()
+{
+  ADCSRA &= ~_BV(ADIE);
+  while(ADCSRA & _BV(ADSC))
+    ;
+}
+
+//  copy a channel out from under the interrupt
+void copyChannel(byte channel, AnalogChannel *copy)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  memcpy(copy, (const void *)&analogChannels[channel], sizeof(AnalogChannel));
+  SREG = oldSREG;
+}
+
+//  set how a scanned channel's readings are produced; its history
+//  is cleared, old samples would be on a different scale
+void configureChannel(byte channel, byte oversample, byte emaShift)
+{
+  volatile AnalogChannel *ch = &analogChannels[channel];
+  uint8_t oldSREG = SREG;
+  cli();
+  ch->latest = (ch->latest >> ch->oversample) << oversample;
+  ch->oversample = oversample;
+  ch->emaShift = emaShift;
+  ch->emaPrimed = false;
+  ch->accumulated = 0;
+  ch->accumulator = 0;
+  ch->count = 0;
+  ch->next = 0;
+  SREG = oldSREG;
+}
+
+//  the current reading of an analog input: the scanner's latest
+//  conversion, or a one-off analogRead() for channels it skips
+int analogSample(byte channel)
+{
+  if(channel < SCANCHANNELS){
+    uint8_t oldSREG = SREG;
+    cli();
+    int sample = analogChannels[channel].latest;
+    SREG = oldSREG;
+    return sample;
+  }
+
+  stopScanner();
+  int sample = analogRead(channel);
+  startScanner();
+  return sample;
+}
+
+//  stop sampling and give Timer2 back to the core as it was found
+void endCapture(byte state)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  if(capture.state == CAPTURE_ARMED || capture.state == CAPTURE_RUNNING){
+    TIMSK2 = capture.savedTIMSK2;
+    TCCR2A = capture.savedTCCR2A;
+    TCCR2B = capture.savedTCCR2B;
+    OCR2A = capture.savedOCR2A;
+    capture.state = state;
+  }
+  SREG = oldSREG;
+}
+
+//  one port sample per compare match: wait for the trigger edge,
+//  then extend the current run or start the next one
+ISR(TIMER2_COMPA_vect)
+{
+  byte sample = *capture.input;
+
+  if(capture.state == CAPTURE_ARMED){
+    byte changed = (sample ^ capture.last) & capture.triggerMask;
+    byte level = sample & capture.triggerMask;
+    capture.last = sample;
+    if(!changed || (capture.edge == EDGE_RISE && !level) ||
+       (capture.edge == EDGE_FALL && level)){
+      return;
     }
+    capture.state = CAPTURE_RUNNING;
+  }
 
-    // give the web browser time to receive the data
-    delay(1);
+  if(capture.count > 0){
+    volatile CaptureRun *run = &capture.runs[capture.head];
+    if(run->value == sample && run->length < 0xFFFF){
+      run->length++;
+      return;
+    }
 
-    // close the connection:
-    //client.stop();
-    client.stop();
-      while(client.status() != 0){
-      delay(5);
+    //  a triggered capture ends when the ring is full, a free
+    //  running one drops its oldest run
+    if(capture.count == CAPTURESIZE && capture.edge != EDGE_NONE){
+      endCapture(CAPTURE_DONE);
+      return;
     }
+    capture.head = (capture.head + 1 < CAPTURESIZE) ? capture.head + 1 : 0;
+  }
+  if(capture.count < CAPTURESIZE){
+    capture.count++;
   }
+  capture.runs[capture.head].value = sample;
+  capture.runs[capture.head].length = 1;
 }
 
+//  sample the port of pin rate times a second from Timer2 in CTC
+//  mode, with the smallest prescaler that fits the rate into 8 bits;
+//  false when the rate can't be had
+boolean armCapture(byte pin, long rate, byte edge)
+{
+  static const unsigned int prescalers[] PROGMEM = { 1, 8, 32, 64, 128, 256, 1024 };
+  unsigned long top = 0;
+  byte cs;
+
+  if(rate < 1 || rate > MAXCAPTURERATE){
+    return false;
+  }
+  for(cs = 0; cs < 7; cs++){
+    top = F_CPU / pgm_read_word(&prescalers[cs]) / rate;
+    if(top <= 256){
+      break;
+    }
+  }
+  if(cs == 7 || top == 0){
+    return false;
+  }
+
+  endCapture(CAPTURE_IDLE);
+
+  uint8_t oldSREG = SREG;
+  cli();
+  capture.savedTCCR2A = TCCR2A;
+  capture.savedTCCR2B = TCCR2B;
+  capture.savedOCR2A = OCR2A;
+  capture.savedTIMSK2 = TIMSK2;
+
+  capture.edge = edge;
+  capture.port = digitalPinToPort(pin);
+  capture.input = portInputRegister(capture.port);
+  capture.triggerMask = digitalPinToBitMask(pin);
+  capture.last = *capture.input;
+  capture.rate = F_CPU / pgm_read_word(&prescalers[cs]) / top;
+  capture.head = 0;
+  capture.count = 0;
+  capture.state = (edge == EDGE_NONE) ? CAPTURE_RUNNING : CAPTURE_ARMED;
+
+  TIMSK2 = 0;
+  TCCR2A = _BV(WGM21);
+  TCCR2B = cs + 1;
+  OCR2A = top - 1;
+  TCNT2 = 0;
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 = _BV(OCIE2A);
+  SREG = oldSREG;
+  return true;
+}
+
+//  table flags for a digital pin, none for pins the board lacks
+byte pinFlags(byte pin)
+{
+  return (pin < MAXPINS) ? pgm_read_byte(&pinTable[pin]) : 0;
+}
+
+//  parse an unsigned decimal number of up to three digits,
+//  false unless the whole string is digits
+boolean parseNumber(const char *text, int *number)
+{
+  *number = 0;
+  if(*text == '\0' || strlen(text) > 3){
+    return false;
+  }
+  for(; *text != '\0'; text++){
+    if(*text < '0' || *text > '9'){
+      return false;
+    }
+    *number = *number * 10 + (*text - '0');
+  }
+  return true;
+}
+
+//  the same for numbers of up to nine digits
+boolean parseLong(const char *text, long *number)
+{
+  *number = 0;
+  if(*text == '\0' || strlen(text) > 9){
+    return false;
+  }
+  for(; *text != '\0'; text++){
+    if(*text < '0' || *text > '9'){
+      return false;
+    }
+    *number = *number * 10 + (*text - '0');
+  }
+  return true;
+}
+
+//  parse a duration of up to SCHEDULE_MAXDELAY into microseconds:
+//  digits followed by US, MS (the default) or S
+boolean parseDuration(const char *text, unsigned long *duration)
+{
+  char digits[10];
+  unsigned long scale;
+  long number;
+  size_t length = strspn(text, "0123456789");
+
+  if(length == 0 || length >= sizeof(digits)){
+    return false;
+  }
+  memcpy(digits, text, length);
+  digits[length] = '\0';
+  parseLong(digits, &number);
+
+  text += length;
+  if(strcmp_P(text, PSTR("US")) == 0){
+    scale = 1;
+  } 
+  else if(*text == '\0' || strcmp_P(text, PSTR("MS")) == 0){
+    scale = 1000;
+  } 
+  else if(strcmp_P(text, PSTR("S")) == 0){
+    scale = 1000000;
+  } 
+  else {
+    return false;
+  }
+
+  if((unsigned long)number > SCHEDULE_MAXDELAY / scale){
+    return false;
+  }
+  *duration = number * scale;
+  return true;
+}
+
+//  resolve A<n>, D<n> or a bare <n> to a pin this board has and
+//  leaves free; false for anything else
+boolean parsePin(const char *name, PinAddress *addr)
+{
+  int number;
+
+  addr->analog = (name[0] == 'a' || name[0] == 'A');
+  if(addr->analog || name[0] == 'd' || name[0] == 'D'){
+    name++;
+  }
+  if(!parseNumber(name, &number)){
+    return false;
+  }
+
+  if(addr->analog){
+    if(number >= NUM_ANALOG_INPUTS){
+      return false;
+    }
+  } 
+  else {
+    byte flags = pinFlags(number);
+    if(!(flags & PIN_DIGITAL) || (flags & PIN_RESERVED)){
+      return false;
+    }
+  }
+
+  addr->pin = number;
+  return true;
+}
+
+//  the digital pin a write goes to, analog inputs are
+//  driven as digital pins
+byte outputPin(PinAddress *addr)
+{
+  return addr->analog ? analogInputToDigitalPin(addr->pin) : addr->pin;
+}
+
+//  the reconfigurable timer driving a pin's PWM and which of its
+//  outputs the pin is, NULL for pins on other timers
+PwmTimer *pinTimer(byte pin, byte *output)
+{
+  byte timer = digitalPinToTimer(pin);
+
+  if(timer == NOT_ON_TIMER){
+    return NULL;
+  }
+  for(byte t = 0; t < PWMTIMERS; t++){
+    for(byte o = 0; o < 3; o++){
+      if(pgm_read_byte(&pwmTimerInfo[t].outputs[o]) == timer){
+        *output = o;
+        return &pwmTimers[t];
+      }
+    }
+  }
+  return NULL;
+}
+
+//  the largest PWM value a pin takes: 255, or the TOP its timer
+//  has been set up with
+unsigned int pwmTop(byte pin)
+{
+  byte output;
+  PwmTimer *timer = pinTimer(pin, &output);
+  return (timer != NULL && timer->configured) ? timer->top : 255;
+}
+
+//  is the timer behind a pin's PWM running a capture or a frequency
+//  reading instead?
+boolean timerBusy(byte pin)
+{
+  byte timer = digitalPinToTimer(pin);
+
+  if((timer == TIMER2 || timer == TIMER2A || timer == TIMER2B) &&
+     (capture.state == CAPTURE_ARMED || capture.state == CAPTURE_RUNNING)){
+    return true;
+  }
+  return FREQ_TIMER(timer) && pulseCounters[FREQCOUNTER].active;
+}
+
+//  can value be written to the pin? HIGH and LOW always can, PWM
+//  values need a PWM pin and must be 0-255, or up to the TOP of a
+//  timer set up through /PWM
+byte checkWrite(PinAddress *addr, const char *value)
+{
+  long number;
+
+  if(strcmp_P(value, PSTR("HIGH")) == 0 || strcmp_P(value, PSTR("LOW")) == 0){
+    return PIN_OK;
+  }
+  if(!parseLong(value, &number) || number > pwmTop(outputPin(addr)) ||
+     !(pinFlags(outputPin(addr)) & PIN_PWM)){
+    return PIN_BADVALUE;
+  }
+
+  if(timerBusy(outputPin(addr))){
+    return PIN_BADVALUE;
+  }
+  return PIN_OK;
+}
+
+//  change a pin's mode only when it differs from the one in the
+//  pin state table; PWM pins are outputs as far as the hardware goes
+void setPinMode(byte pin, byte mode)
+{
+  byte current = pinStates[pin].mode;
+  if(current == mode || (current >= MODE_OUTPUT && mode >= MODE_OUTPUT)){
+    pinStates[pin].mode = mode;
+    return;
+  }
+
+  pinMode(pin, (mode == MODE_INPUT) ? INPUT : OUTPUT);
+  pinStates[pin].mode = mode;
+}
+
+//  file an edge seen at stamp
+void countEdge(volatile PulseCounter *counter, unsigned long stamp)
+{
+  if(counter->count > 0){
+    counter->period = stamp - counter->last;
+  }
+  counter->last = stamp;
+  counter->count++;
+}
+
+void countInterrupt0()
+{
+  countEdge(&pulseCounters[0], micros());
+}
+
+void countInterrupt1()
+{
+  countEdge(&pulseCounters[1], micros());
+}
+
+//  the input capture timer extended to 32 bits; with interrupts off,
+//  an overflow still pending belongs before ticks that have wrapped
+unsigned long freqStamp(unsigned int ticks)
+{
+  unsigned int high = freqOverflows;
+  if((FREQ_TIFR & _BV(TOV1)) && ticks < 0x8000){
+    high++;
+  }
+  return ((unsigned long)high << 16) | ticks;
+}
+
+ISR(FREQ_CAPT_vect)
+{
+  countEdge(&pulseCounters[FREQCOUNTER], freqStamp(FREQ_ICR));
+}
+
+ISR(FREQ_OVF_vect)
+{
+  freqOverflows++;
+}
+
+//  the counter a pin can drive, -1 if it has none
+int pinCounter(byte pin, boolean freq)
+{
+  if(freq){
+    return (pin == FREQPIN) ? FREQCOUNTER : -1;
+  }
+#if defined(digitalPinToInterrupt)
+  int interrupt = digitalPinToInterrupt(pin);
+#else
+  int interrupt = (pin == 2) ? 0 : ((pin == 3) ? 1 : -1);
+#endif
+  return (interrupt == 0 || interrupt == 1) ? interrupt : -1;
+}
+
+//  stop counting, giving the input capture timer back as it was
+void stopCounter(byte counter)
+{
+  if(!pulseCounters[counter].active){
+    return;
+  }
+  if(counter == FREQCOUNTER){
+    uint8_t oldSREG = SREG;
+    cli();
+    FREQ_TIMSK = freqSavedTIMSK;
+    FREQ_TCCRA = freqSavedTCCRA;
+    FREQ_TCCRB = freqSavedTCCRB;
+    SREG = oldSREG;
+  }
+  else {
+    detachInterrupt(counter);
+  }
+  pulseCounters[counter].active = false;
+}
+
+//  (re)start a counter from zero on the given edges of its pin;
+//  input capture can't take both edges
+boolean startCounter(byte counter, byte pin, byte edge)
+{
+  volatile PulseCounter *c = &pulseCounters[counter];
+
+  if(counter == FREQCOUNTER && edge == EDGE_ANY){
+    return false;
+  }
+  stopCounter(counter);
+  setPinMode(pin, MODE_INPUT);
+
+  uint8_t oldSREG = SREG;
+  cli();
+  c->count = 0;
+  c->last = 0;
+  c->period = 0;
+  c->reportedCount = 0;
+  c->reportedLast = 0;
+  c->active = true;
+  SREG = oldSREG;
+
+  if(counter == FREQCOUNTER){
+    cli();
+    freqSavedTCCRA = FREQ_TCCRA;
+    freqSavedTCCRB = FREQ_TCCRB;
+    freqSavedTIMSK = FREQ_TIMSK;
+    freqOverflows = 0;
+
+    //  normal mode at the full clock, noise canceller on
+    FREQ_TIMSK = 0;
+    FREQ_TCCRA = 0;
+    FREQ_TCCRB = _BV(ICNC1) | ((edge == EDGE_FALL) ? 0 : _BV(ICES1)) | _BV(CS10);
+    FREQ_TCNT = 0;
+    FREQ_TIFR = _BV(ICF1) | _BV(TOV1);
+    FREQ_TIMSK = _BV(ICIE1) | _BV(TOIE1);
+    SREG = oldSREG;
+  }
+  else {
+    attachInterrupt(counter, (counter == 0) ? countInterrupt0 : countInterrupt1,
+      (edge == EDGE_FALL) ? FALLING : ((edge == EDGE_ANY) ? CHANGE : RISING));
+  }
+  return true;
+}
+
+//  the registers and outputs of a timer, from flash
+void timerInfo(PwmTimer *timer, PwmTimerInfo *info)
+{
+  memcpy_P(info, &pwmTimerInfo[timer - pwmTimers], sizeof(PwmTimerInfo));
+}
+
+//  PWM on a timer set up through /PWM: like analogWrite(), 0 and TOP
+//  are plain levels, anything between goes to the compare register
+void timerWrite(PwmTimer *timer, byte output, byte pin, unsigned int value)
+{
+  PwmTimerInfo info;
+
+  if(value == 0 || value >= timer->top){
+    digitalWrite(pin, (value == 0) ? LOW : HIGH);
+    return;
+  }
+  timerInfo(timer, &info);
+  *info.ocr[output] = value;
+
+  //  non-inverting output, COMnx1 (same place on every 16-bit timer)
+  *info.tccra |= _BV(COM1A1 - 2 * output);
+}
+
+//  drive a pin as an output at a level or PWM duty and remember it
+void drivePin(byte pin, byte mode, unsigned int value)
+{
+  setPinMode(pin, mode);
+  if(mode == MODE_PWM){
+    byte output;
+    PwmTimer *timer = pinTimer(pin, &output);
+    if(timer != NULL && timer->configured){
+      timerWrite(timer, output, pin, value);
+    } 
+    else {
+      analogWrite(pin, value);
+    }
+  } 
+  else {
+    digitalWrite(pin, value);
+  }
+  pinStates[pin].value = value;
+}
+
+//  is due time a earlier than b? holds while the two are less
+//  than half the micros() range apart
+boolean dueBefore(unsigned long a, unsigned long b)
+{
+  return (long)(a - b) < 0;
+}
+
+void swapEvents(byte a, byte b)
+{
+  ScheduledEvent event = schedule[a];
+  schedule[a] = schedule[b];
+  schedule[b] = event;
+}
+
+void siftDown(byte i)
+{
+  for(;;){
+    byte earliest = i;
+    byte left = 2 * i + 1;
+    byte right = left + 1;
+    if(left < scheduleCount && dueBefore(schedule[left].due, schedule[earliest].due)){
+      earliest = left;
+    }
+    if(right < scheduleCount && dueBefore(schedule[right].due, schedule[earliest].due)){
+      earliest = right;
+    }
+    if(earliest == i){
+      return;
+    }
+    swapEvents(i, earliest);
+    i = earliest;
+  }
+}
+
+//  add an event to the heap, false when it is full
+boolean scheduleEvent(ScheduledEvent *event)
+{
+  if(scheduleCount >= SCHEDULESIZE){
+    return false;
+  }
+
+  byte i = scheduleCount++;
+  schedule[i] = *event;
+  while(i > 0 && dueBefore(schedule[i].due, schedule[(i - 1) / 2].due)){
+    swapEvents(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  return true;
+}
+
+//  drop every event pending for a pin
+void cancelEvents(byte pin)
+{
+  byte kept = 0;
+  for(byte i = 0; i < scheduleCount; i++){
+    if(schedule[i].pin != pin){
+      schedule[kept++] = schedule[i];
+    }
+  }
+  scheduleCount = kept;
+  for(int i = scheduleCount / 2 - 1; i >= 0; i--){
+    siftDown(i);
+  }
+}
+
+//  carry out every event that has come due; a ramp sets the duty
+//  its elapsed time calls for, so a late pass catches up rather
+//  than stretching the ramp, and goes back on the heap until done
+void runSchedule()
+{
+  unsigned long now = micros();
+
+  while(scheduleCount > 0 && !dueBefore(now, schedule[0].due)){
+    ScheduledEvent event = schedule[0];
+    schedule[0] = schedule[--scheduleCount];
+    siftDown(0);
+
+    if(event.kind == EVENT_LEVEL){
+      drivePin(event.pin, MODE_OUTPUT, event.to);
+      continue;
+    }
+
+    //  the pin's timer may have been taken since
+    if(timerBusy(event.pin)){
+      continue;
+    }
+    if(event.kind == EVENT_PWM){
+      drivePin(event.pin, MODE_PWM, event.to);
+      continue;
+    }
+
+    unsigned int steps = (event.to > event.from) ? event.to - event.from : event.from - event.to;
+    unsigned long interval = max(event.duration / steps, 1UL);
+    unsigned long elapsed = now - event.start;
+    if(elapsed >= event.duration){
+      drivePin(event.pin, MODE_PWM, event.to);
+      continue;
+    }
+
+    unsigned int done = elapsed / interval;
+    drivePin(event.pin, MODE_PWM, (event.to > event.from) ? event.from + done : event.from - done);
+    event.due = event.start + (done + 1) * interval;
+    scheduleEvent(&event);
+  }
+}
+
+//  set a pin from a HIGH, LOW or PWM value
+byte writePin(PinAddress *addr, char *value)
+{
+#if DEBUG
+  //  set the pin value
+  Serial.println("setting pin");
+#endif
+
+  if(checkWrite(addr, value) != PIN_OK){
+    return PIN_BADVALUE;
+  }
+
+  //  select the pin
+  int selectedPin = outputPin(addr);
+#if DEBUG
+  Serial.println(selectedPin);
+#endif
+
+  //  a write overrides anything still scheduled for the pin
+  cancelEvents(selectedPin);
+
+  //  determine digital or analog (PWM)
+  if(strcmp_P(value, PSTR("HIGH")) == 0 || strcmp_P(value, PSTR("LOW")) == 0){
+
+#if DEBUG
+    //  digital
+    Serial.println("digital");
+#endif
+
+    if(strcmp_P(value, PSTR("HIGH")) == 0){
+#if DEBUG
+      Serial.println("HIGH");
+#endif
+      drivePin(selectedPin, MODE_OUTPUT, HIGH);
+    }
+
+    if(strcmp_P(value, PSTR("LOW")) == 0){
+#if DEBUG
+      Serial.println("LOW");
+#endif
+      drivePin(selectedPin, MODE_OUTPUT, LOW);
+    }
+
+  } 
+  else {
+
+#if DEBUG
+    //  analog
+    Serial.println("analog");
+#endif
+    //  get numeric value
+    unsigned int selectedValue = atol(value);
+#if DEBUG
+    Serial.println(selectedValue);
+#endif
+    drivePin(selectedPin, MODE_PWM, selectedValue);
+
+  }
+  return PIN_OK;
+}
+
+//  read a pin into outValue, HIGH/LOW for digital pins or the raw
+//  reading for analog ones; a pin we drive reports what was written
+//  to it rather than being switched to an input
+void readPin(PinAddress *addr, char *outValue)
+{
+#if DEBUG
+  //  read the pin value
+  Serial.println("reading pin");
+  Serial.println(addr->pin);
+#endif
+
+  //  determine analog or digital
+  if(addr->analog){
+
+#if DEBUG
+    Serial.println("analog");
+#endif
+
+    sprintf(outValue,"%d",analogSample(addr->pin));
+
+  } 
+  else {
+
+#if DEBUG
+    Serial.println("digital");
+#endif
+
+    PinState *state = &pinStates[addr->pin];
+    int inValue;
+
+    if(state->mode == MODE_PWM){
+      //  digitalRead() would turn the PWM off
+      sprintf(outValue,"%u",state->value);
+      return;
+    } 
+    else if(state->mode == MODE_OUTPUT){
+      inValue = state->value;
+    } 
+    else {
+      setPinMode(addr->pin, MODE_INPUT);
+      inValue = digitalRead(addr->pin);
+    }
+
+    if(inValue == 0){
+      strcpy_P(outValue, PSTR("LOW"));
+      //sprintf(outValue,"%d",digitalRead(selectedPin));
+    }
+
+    if(inValue == 1){
+      strcpy_P(outValue, PSTR("HIGH"));
+    }
+
+  }
+
+#if DEBUG
+  Serial.println(outValue);
+#endif
+}
+
+//  grab every input register back-to-back with interrupts
+//  off so all pins are sampled within a few cycles
+void readPorts(byte *ports)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  ports[1] = PINA;
+  ports[2] = PINB;
+  ports[3] = PINC;
+  ports[4] = PIND;
+  ports[5] = PINE;
+  ports[6] = PINF;
+  ports[7] = PING;
+  ports[8] = PINH;
+  ports[10] = PINJ;
+  ports[11] = PINK;
+  ports[12] = PINL;
+#elif defined(__AVR_ATmega1284P__)
+  ports[1] = PINA;
+  ports[2] = PINB;
+  ports[3] = PINC;
+  ports[4] = PIND;
+#else
+  ports[2] = PINB;
+  ports[3] = PINC;
+  ports[4] = PIND;
+#endif
+  SREG = oldSREG;
+}
+
+//  level of a digital pin within a port snapshot
+boolean snapshotLevel(byte *ports, byte pin)
+{
+  return (ports[digitalPinToPort(pin)] & digitalPinToBitMask(pin)) != 0;
+}
+
+//  write a port snapshot as json: the levels of all digital
+//  pins as a hex bitmask (bit n is pin n) and pin by pin
+void printPorts(JsonWriter &json, byte *ports)
+{
+  char mask[3 + 2 * ((NUM_DIGITAL_PINS + 7) / 8)] = "0x";
+  char *digit = mask + 2;
+
+  for(int group = (NUM_DIGITAL_PINS - 1) / 8; group >= 0; group--){
+    byte bits = 0;
+    for(byte bit = 0; bit < 8; bit++){
+      byte pin = group * 8 + bit;
+      if(pin < NUM_DIGITAL_PINS && snapshotLevel(ports, pin)){
+        bits |= 1 << bit;
+      }
+    }
+    *digit++ = pgm_read_byte(&hexDigits[bits >> 4]);
+    *digit++ = pgm_read_byte(&hexDigits[bits & 0x0F]);
+  }
+  *digit = '\0';
+
+  json.beginObject();
+  json.key(F("MASK"));
+  json.value(mask);
+
+  for(byte pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+    json.key('D', pin);
+    json.value(snapshotLevel(ports, pin) ? F("HIGH") : F("LOW"));
+  }
+  json.endObject();
+}
+
+//  split a BATCH query into its NAME=VALUE writes and bare NAME
+//  reads, checking every one before any pin is touched
+byte splitBatch(char *query, byte *count)
+{
+  *count = 0;
+
+  while(query != NULL && *query != '\0'){
+    char *param = query;
+    PinAddress addr;
+
+    //  split off the next parameter
+    query = strchr(query, '&');
+    if(query != NULL){
+      *query++ = '\0';
+    }
+    (*count)++;
+
+    if(*param == '\0'){
+      continue;
+    }
+
+    char *value = strchr(param, '=');
+    if(value != NULL){
+      *value = '\0';
+    }
+
+    byte result = parsePin(param, &addr) ? PIN_OK : PIN_UNKNOWN;
+    if(result == PIN_OK && value != NULL){
+      result = checkWrite(&addr, value + 1);
+    }
+
+    if(value != NULL){
+      *value = '=';
+    }
+    if(result != PIN_OK){
+      return result;
+    }
+  }
+  return PIN_OK;
+}
+
+//  apply every write and sample every read of a query split
+//  by splitBatch(), in one pass
+void handleBatch(char *query, byte count, JsonWriter &json)
+{
+  char outValue[10];
+
+  for(; count > 0; count--){
+    char *pin = query;
+    PinAddress addr;
+
+    query += strlen(query) + 1;
+
+    char *value = strchr(pin, '=');
+    if(value != NULL){
+      *value++ = '\0';
+    }
+
+    if(!parsePin(pin, &addr)){
+      continue;
+    }
+
+    if(value != NULL){
+      writePin(&addr, value);
+      json.key(pin);
+      json.value(value);
+    } 
+    else {
+      strcpy_P(outValue, PSTR("MU"));
+      readPin(&addr, outValue);
+      json.key(pin);
+      json.value(outValue);
+    }
+  }
+}
+
+//  a route writes the whole response to a request, returning true
+//  when it has taken the connection over for good
+typedef boolean (*RouteHandler)(Connection *conn, ResponseBuffer &out);
+
+//  every digital pin from one snapshot of the port registers
+boolean routePorts(Connection *conn, ResponseBuffer &out)
+{
+  byte ports[PORTCOUNT];
+  readPorts(ports);
+
+  JsonWriter json(out);
+  beginBody(out, &conn->request);
+  printPorts(json, ports);
+  endBody(out, &conn->request);
+  return false;
+}
+
+//  answer a request naming a pin the board lacks (or keeps for
+//  itself) with 404, one with a value the pin can't take with 400
+//  and one the scheduler has no room for with 503
+boolean routePinError(Connection *conn, ResponseBuffer &out, byte result)
+{
+  const char *header = (result == PIN_UNKNOWN) ? header404 :
+    ((result == PIN_BUSY) ? header503 : header400);
+  sendHeaders(out, header, 0, conn->request.keepAlive);
+  return false;
+}
+
+//  many pins in one request, refused as a whole if any is bad
+boolean routeBatch(Connection *conn, ResponseBuffer &out)
+{
+  byte count;
+  byte result = splitBatch(conn->request.query, &count);
+  if(result != PIN_OK){
+    return routePinError(conn, out, result);
+  }
+
+  JsonWriter json(out);
+  beginBody(out, &conn->request);
+  json.beginObject();
+  handleBatch(conn->request.query, count, json);
+  json.endObject();
+  endBody(out, &conn->request);
+  return false;
+}
+
+//  apply OS=<1|4|16|64> and EMA=<0-8> parameters of an analog read
+//  to its channel, leaving settings that aren't named as they are
+byte parseFilter(PinAddress *addr, char *query)
+{
+  volatile AnalogChannel *channel;
+  byte oversample, emaShift;
+  boolean changed = false;
+  int number;
+
+  if(query == NULL || *query == '\0'){
+    return PIN_OK;
+  }
+  if(!addr->analog || addr->pin >= SCANCHANNELS){
+    return PIN_BADVALUE;
+  }
+
+  channel = &analogChannels[addr->pin];
+  oversample = channel->oversample;
+  emaShift = channel->emaShift;
+
+  while(query != NULL && *query != '\0'){
+    char *param = query;
+
+    query = strchr(query, '&');
+    if(query != NULL){
+      *query++ = '\0';
+    }
+
+    if(strncmp_P(param, PSTR("OS="), 3) == 0){
+      if(!parseNumber(param + 3, &number)){
+        return PIN_BADVALUE;
+      }
+      for(oversample = 0; oversample <= MAXOVERSAMPLE; oversample++){
+        if(number == (1 << (2 * oversample))){
+          break;
+        }
+      }
+      if(oversample > MAXOVERSAMPLE){
+        return PIN_BADVALUE;
+      }
+      changed = true;
+    } 
+    else if(strncmp_P(param, PSTR("EMA="), 4) == 0){
+      if(!parseNumber(param + 4, &number) || number > MAXEMA){
+        return PIN_BADVALUE;
+      }
+      emaShift = number;
+      changed = true;
+    }
+  }
+
+  if(changed && (oversample != channel->oversample || emaShift != channel->emaShift)){
+    configureChannel(addr->pin, oversample, emaShift);
+  }
+  return PIN_OK;
+}
+
+//  the buffered series of a scanned analog input, oldest first,
+//  with its minimum, maximum and mean
+boolean routeHistory(Connection *conn, ResponseBuffer &out, PinAddress *addr)
+{
+  AnalogChannel channel;
+
+  if(!addr->analog || addr->pin >= SCANCHANNELS){
+    return routePinError(conn, out, PIN_UNKNOWN);
+  }
+  copyChannel(addr->pin, &channel);
+
+  //  the mean is summed here rather than kept up to date by the
+  //  interrupt, which saves the ADC handler the work and each
+  //  channel four bytes
+  int low = 32767, high = 0;
+  unsigned long sum = 0;
+  byte first = (channel.count == HISTORYSIZE) ? channel.next : 0;
+  for(byte i = 0; i < channel.count; i++){
+    int sample = channel.samples[(first + i) & (HISTORYSIZE - 1)];
+    low = min(low, sample);
+    high = max(high, sample);
+    sum += sample;
+  }
+
+  JsonWriter json(out);
+  beginBody(out, &conn->request);
+  json.beginObject();
+  json.key('A', addr->pin);
+  json.beginObject();
+  json.key(F("INTERVAL"));
+  json.value(HISTORY_INTERVAL);
+  json.key(F("BITS"));
+  json.value(10 + channel.oversample);
+  if(channel.count > 0){
+    json.key(F("MIN"));
+    json.value(low);
+    json.key(F("MAX"));
+    json.value(high);
+    json.key(F("MEAN"));
+    json.value((int)(sum / channel.count));
+  }
+  json.key(F("SAMPLES"));
+  json.beginArray();
+  for(byte i = 0; i < channel.count; i++){
+    json.item(channel.samples[(first + i) & (HISTORYSIZE - 1)]);
+  }
+  json.endArray();
+  json.endObject();
+  json.endObject();
+  endBody(out, &conn->request);
+  return false;
+}
+
+//  write a counter's total and the mean frequency (Hz) and period
+//  (us) of the edges since the previous reading, or of the latest
+//  period when there were none; a counter that has been quiet for
+//  two periods reads 0
+void printCounter(JsonWriter &json, byte counter)
+{
+  volatile PulseCounter *c = &pulseCounters[counter];
+  unsigned long ticksPerSecond = (counter == FREQCOUNTER) ? F_CPU : 1000000L;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned long count = c->count;
+  unsigned long last = c->last;
+  unsigned long period = c->period;
+  unsigned long now = (counter == FREQCOUNTER) ? freqStamp(FREQ_TCNT) : micros();
+  SREG = oldSREG;
+
+  unsigned long periods = 0, span = 0;
+  if(c->reportedCount > 0 && count > c->reportedCount){
+    periods = count - c->reportedCount;
+    span = last - c->reportedLast;
+  }
+  else if(period > 0){
+    periods = 1;
+    span = period;
+  }
+  if(periods > 0 && now - last > 2 * period){
+    periods = 0;
+  }
+  c->reportedCount = count;
+  c->reportedLast = last;
+
+  json.key(F("COUNT"));
+  json.value((long)count);
+  json.key(F("FREQ"));
+  json.value(periods > 0 ? (double)periods * ticksPerSecond / span : 0.0, 2);
+  json.key(F("PERIOD"));
+  json.value(periods > 0 ? (long)(span / periods / (ticksPerSecond / 1000000L)) : 0L);
+}
+
+//  /Dn/COUNT counts edges on an external interrupt pin, /Dn/FREQ
+//  times them on the input capture pin; the first request (or one
+//  with EDGE=<RISE|FALL|ANY>) starts from zero, later ones read,
+//  and /Dn/COUNT/STOP or /Dn/FREQ/STOP lets the pin go
+boolean routeCounter(Connection *conn, ResponseBuffer &out, PinAddress *addr)
+{
+  Request *req = &conn->request;
+  boolean freq = (strcmp_P(req->segments[1], PSTR("FREQ")) == 0);
+  int counter = addr->analog ? -1 : pinCounter(addr->pin, freq);
+  byte edge = EDGE_RISE;
+  boolean restart = false;
+
+  if(counter < 0){
+    return routePinError(conn, out, PIN_UNKNOWN);
+  }
+
+  if(req->segmentCount > 2){
+    if(strcmp_P(req->segments[2], PSTR("STOP")) != 0){
+      return routePinError(conn, out, PIN_UNKNOWN);
+    }
+    stopCounter(counter);
+    sendHeaders(out, header200, 0, req->keepAlive);
+    return false;
+  }
+
+  if(req->query != NULL && strncmp_P(req->query, PSTR("EDGE="), 5) == 0){
+    static const char edges[][5] PROGMEM = { "NONE", "RISE", "FALL", "ANY" };
+    for(edge = EDGE_RISE; edge <= EDGE_ANY; edge++){
+      if(strcmp_P(req->query + 5, edges[edge]) == 0){
+        break;
+      }
+    }
+    restart = true;
+  }
+  if(restart || !pulseCounters[counter].active){
+    if(edge > EDGE_ANY || !startCounter(counter, addr->pin, edge)){
+      return routePinError(conn, out, PIN_BADVALUE);
+    }
+  }
+
+  JsonWriter json(out);
+  beginBody(out, req);
+  json.beginObject();
+  json.key('D', addr->pin);
+  json.beginObject();
+  printCounter(json, counter);
+  json.endObject();
+  json.endObject();
+  endBody(out, req);
+  return false;
+}
+
+//  write a pin for a while, then put back the level or duty it had
+//  (LOW if it wasn't an output)
+byte writeFor(PinAddress *addr, char *value, unsigned long duration)
+{
+  byte pin = outputPin(addr);
+  PinState before = pinStates[pin];
+  ScheduledEvent event;
+
+  if(checkWrite(addr, value) != PIN_OK){
+    return PIN_BADVALUE;
+  }
+  cancelEvents(pin);
+  if(scheduleCount >= SCHEDULESIZE){
+    return PIN_BUSY;
+  }
+  writePin(addr, value);
+
+  event.due = micros() + duration;
+  event.kind = (before.mode == MODE_PWM) ? EVENT_PWM : EVENT_LEVEL;
+  event.pin = pin;
+  event.to = (before.mode >= MODE_OUTPUT) ? before.value : LOW;
+  scheduleEvent(&event);
+  return PIN_OK;
+}
+
+//  /Dn/PULSE/<duration> flips a pin from its current level and back;
+//  short pulses are timed inline with interrupts off so they come
+//  out exact, longer ones are left to the scheduler
+boolean routePulse(Connection *conn, ResponseBuffer &out, PinAddress *addr)
+{
+  Request *req = &conn->request;
+  byte pin = outputPin(addr);
+  unsigned long length;
+
+  if(req->segmentCount != 3 || !parseDuration(req->segments[2], &length) || length == 0){
+    return routePinError(conn, out, PIN_BADVALUE);
+  }
+
+  cancelEvents(pin);
+  byte level = (pinStates[pin].mode == MODE_OUTPUT) ? pinStates[pin].value : LOW;
+
+  if(length <= PULSE_INLINE){
+    volatile uint8_t *port = portOutputRegister(digitalPinToPort(pin));
+    byte mask = digitalPinToBitMask(pin);
+
+    drivePin(pin, MODE_OUTPUT, level);
+    uint8_t oldSREG = SREG;
+    cli();
+    *port ^= mask;
+    delayMicroseconds(length);
+    *port ^= mask;
+    SREG = oldSREG;
+  } 
+  else {
+    ScheduledEvent event;
+
+    if(scheduleCount >= SCHEDULESIZE){
+      return routePinError(conn, out, PIN_BUSY);
+    }
+    drivePin(pin, MODE_OUTPUT, !level);
+    event.due = micros() + length;
+    event.kind = EVENT_LEVEL;
+    event.pin = pin;
+    event.to = level;
+    scheduleEvent(&event);
+  }
+
+  sendHeaders(out, header200, 0, req->keepAlive);
+  return false;
+}
+
+//  /Dn/RAMP/<from>/<to>/<duration> sweeps a PWM pin's duty one step
+//  at a time, evenly spread over the duration
+boolean routeRamp(Connection *conn, ResponseBuffer &out, PinAddress *addr)
+{
+  Request *req = &conn->request;
+  byte pin = outputPin(addr);
+  unsigned long duration;
+  long from, to;
+
+  if(req->segmentCount != 5 ||
+     !parseLong(req->segments[2], &from) || checkWrite(addr, req->segments[2]) != PIN_OK ||
+     !parseLong(req->segments[3], &to) || checkWrite(addr, req->segments[3]) != PIN_OK ||
+     !parseDuration(req->segments[4], &duration)){
+    return routePinError(conn, out, PIN_BADVALUE);
+  }
+
+  cancelEvents(pin);
+  if(from == to || duration == 0){
+    drivePin(pin, MODE_PWM, to);
+  } 
+  else {
+    ScheduledEvent event;
+
+    if(scheduleCount >= SCHEDULESIZE){
+      return routePinError(conn, out, PIN_BUSY);
+    }
+    drivePin(pin, MODE_PWM, from);
+    event.start = micros();
+    event.duration = duration;
+    event.due = event.start + max(duration / labs(to - from), 1UL);
+    event.kind = EVENT_RAMP;
+    event.pin = pin;
+    event.from = from;
+    event.to = to;
+    scheduleEvent(&event);
+  }
+
+  sendHeaders(out, header200, 0, req->keepAlive);
+  return false;
+}
+
+//  anything that isn't a named route is a pin, written when
+//  a value follows it and read otherwise
+boolean routePin(Connection *conn, ResponseBuffer &out)
+{
+  Request *req = &conn->request;
+  char *pin = req->segments[0];
+  PinAddress addr;
+
+  if(!parsePin(pin, &addr)){
+    return routePinError(conn, out, PIN_UNKNOWN);
+  }
+
+  if(req->segmentCount > 1 && strcmp_P(req->segments[1], PSTR("HISTORY")) == 0){
+    return routeHistory(conn, out, &addr);
+  }
+  if(req->segmentCount > 1 &&
+     (strcmp_P(req->segments[1], PSTR("COUNT")) == 0 || strcmp_P(req->segments[1], PSTR("FREQ")) == 0)){
+    return routeCounter(conn, out, &addr);
+  }
+
+  if(req->segmentCount > 1 && strcmp_P(req->segments[1], PSTR("PULSE")) == 0){
+    return routePulse(conn, out, &addr);
+  }
+  if(req->segmentCount > 1 && strcmp_P(req->segments[1], PSTR("RAMP")) == 0){
+    return routeRamp(conn, out, &addr);
+  }
+
+  //  this is where we actually *do something*!
+  if(req->segmentCount > 1){
+    unsigned long duration = 0;
+    if(req->query != NULL && strncmp_P(req->query, PSTR("FOR="), 4) == 0 &&
+       !parseDuration(req->query + 4, &duration)){
+      return routePinError(conn, out, PIN_BADVALUE);
+    }
+
+    byte result = (duration > 0) ? writeFor(&addr, req->segments[1], duration) :
+      writePin(&addr, req->segments[1]);
+    if(result != PIN_OK){
+      return routePinError(conn, out, result);
+    }
+
+    //  return status
+    sendHeaders(out, header200, 0, req->keepAlive);
+  } 
+  else {
+    char outValue[10] = "MU";
+
+    byte result = parseFilter(&addr, req->query);
+    if(result != PIN_OK){
+      return routePinError(conn, out, result);
+    }
+
+    readPin(&addr, outValue);
+
+    //  return value with wildcarded Cross-origin policy
+    JsonWriter json(out);
+    beginBody(out, req);
+    json.beginObject();
+    json.key(pin);
+    json.value(outValue);
+
+    //  oversampled readings are wider than 10 bits
+    if(addr.analog && addr.pin < SCANCHANNELS && analogChannels[addr.pin].oversample > 0){
+      json.key(F("BITS"));
+      json.value(10 + analogChannels[addr.pin].oversample);
+    }
+    json.endObject();
+    endBody(out, req);
+  }
+  return false;
+}
+
+//  the mode and last written value of every usable digital pin,
+//  straight from the pin state table
+boolean routeState(Connection *conn, ResponseBuffer &out)
+{
+  static const char modeNames[][7] PROGMEM = { "UNSET", "INPUT", "OUTPUT", "PWM" };
+
+  JsonWriter json(out);
+  beginBody(out, &conn->request);
+  json.beginObject();
+  for(byte pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+    PinState *state = &pinStates[pin];
+    if(pinFlags(pin) & PIN_RESERVED){
+      continue;
+    }
+
+    json.key('D', pin);
+    json.beginObject();
+    json.key(F("MODE"));
+    json.value((const __FlashStringHelper *)modeNames[state->mode]);
+    if(state->mode == MODE_OUTPUT){
+      json.key(F("VALUE"));
+      json.value(state->value ? F("HIGH") : F("LOW"));
+    } 
+    else if(state->mode == MODE_PWM){
+      json.key(F("VALUE"));
+      json.value((long)state->value);
+    }
+    json.endObject();
+  }
+  json.endObject();
+  endBody(out, &conn->request);
+  return false;
+}
+
+boolean routeNotFound(Connection *conn, ResponseBuffer &out)
+{
+#if DEBUG
+  Serial.println("erroring");
+#endif
+  sendHeaders(out, header404, 0, conn->request.keepAlive);
+  return false;
+}
+
+//  the 16-bit timer with a number, NULL if the board lacks it
+PwmTimer *findTimer(int number)
+{
+  for(byte t = 0; t < PWMTIMERS; t++){
+    if(pgm_read_byte(&pwmTimerInfo[t].number) == number){
+      return &pwmTimers[t];
+    }
+  }
+  return NULL;
+}
+
+//  is a timer doing input capture for /FREQ?
+boolean timerTaken(PwmTimer *timer)
+{
+  byte output = pgm_read_byte(&pwmTimerInfo[timer - pwmTimers].outputs[0]);
+  return FREQ_TIMER(output) && pulseCounters[FREQCOUNTER].active;
+}
+
+//  drive a timer's PWM pins again after its TOP has changed, keeping
+//  their duty cycles; ramps under way were in the old scale and stop
+void rescalePins(PwmTimer *timer, unsigned int oldTop)
+{
+  for(byte pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+    byte output;
+    if(pinStates[pin].mode != MODE_PWM || pinTimer(pin, &output) != timer){
+      continue;
+    }
+    cancelEvents(pin);
+    drivePin(pin, MODE_PWM, (unsigned long)pinStates[pin].value * pwmTop(pin) / oldTop);
+  }
+}
+
+//  run a timer in fast or phase correct PWM with ICRn as TOP, set
+//  from a frequency (the finest resolution that reaches it) or from
+//  a resolution in bits (at the full clock)
+byte configureTimer(PwmTimer *timer, long freq, byte bits, boolean phaseCorrect)
+{
+  PwmTimerInfo info;
+  unsigned long top = 0;
+  byte cs = 0;
+
+  if(bits > 0){
+    if(bits < 2 || bits > 16){
+      return PIN_BADVALUE;
+    }
+    top = (1UL << bits) - 1;
+  } 
+  else {
+    if(freq < 1){
+      return PIN_BADVALUE;
+    }
+    for(cs = 0; cs < 5; cs++){
+      unsigned long ticks = F_CPU / pgm_read_word(&timerPrescalers[cs]) / freq;
+      top = phaseCorrect ? ticks / 2 : ticks - 1;
+      if(top <= 0xFFFF){
+        break;
+      }
+    }
+    if(cs == 5 || top < 3){
+      return PIN_BADVALUE;
+    }
+  }
+  if(timerTaken(timer)){
+    return PIN_BUSY;
+  }
+
+  timerInfo(timer, &info);
+  unsigned int oldTop = timer->configured ? timer->top : 255;
+  if(!timer->configured){
+    timer->savedTCCRA = *info.tccra;
+    timer->savedTCCRB = *info.tccrb;
+  }
+
+  //  WGMn3:0 = 14 (fast) or 10 (phase correct), outputs off until
+  //  the pins are driven again
+  uint8_t oldSREG = SREG;
+  cli();
+  *info.tccrb = 0;
+  *info.tccra = _BV(WGM11);
+  *info.icr = top;
+  *info.tcnt = 0;
+  *info.tccrb = _BV(WGM13) | (phaseCorrect ? 0 : _BV(WGM12)) | (cs + 1);
+  SREG = oldSREG;
+
+  timer->configured = true;
+  timer->phaseCorrect = phaseCorrect;
+  timer->prescale = cs;
+  timer->top = top;
+  rescalePins(timer, oldTop);
+  return PIN_OK;
+}
+
+//  give a timer back to the core's 8-bit PWM
+void resetTimer(PwmTimer *timer)
+{
+  PwmTimerInfo info;
+
+  if(!timer->configured){
+    return;
+  }
+
+  timerInfo(timer, &info);
+  uint8_t oldSREG = SREG;
+  cli();
+  *info.tccrb = 0;
+  *info.tccra = timer->savedTCCRA & (_BV(WGM11) | _BV(WGM10));
+  *info.tcnt = 0;
+  *info.tccrb = timer->savedTCCRB;
+  SREG = oldSREG;
+
+  timer->configured = false;
+  rescalePins(timer, timer->top);
+}
+
+//  how a timer drives its PWM pins: mode, the frequency it runs at,
+//  TOP (the largest PWM value), whole bits of resolution and pins
+void printTimer(JsonWriter &json, PwmTimer *timer)
+{
+  unsigned long top = timer->configured ? timer->top : 255;
+  double freq;
+  byte bits = 0;
+
+  if(!timer->configured){
+    //  the core's phase correct PWM at a prescaler of 64
+    freq = (double)F_CPU / 64 / 510;
+  } 
+  else if(timer->phaseCorrect){
+    freq = (double)F_CPU / pgm_read_word(&timerPrescalers[timer->prescale]) / (2 * top);
+  } 
+  else {
+    freq = (double)F_CPU / pgm_read_word(&timerPrescalers[timer->prescale]) / (top + 1);
+  }
+  while(bits < 16 && (1UL << (bits + 1)) <= top + 1){
+    bits++;
+  }
+
+  json.key(F("TIMER"));
+  json.value(pgm_read_byte(&pwmTimerInfo[timer - pwmTimers].number));
+  json.key(F("MODE"));
+  json.value(!timer->configured ? F("DEFAULT") : (timer->phaseCorrect ? F("PHASE") : F("FAST")));
+  json.key(F("FREQ"));
+  json.value(freq, 2);
+  json.key(F("TOP"));
+  json.value((long)top);
+  json.key(F("BITS"));
+  json.value(bits);
+  json.key(F("PINS"));
+  json.beginArray();
+  for(byte pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+    byte output;
+    if(pinTimer(pin, &output) == timer && (pinFlags(pin) & (PIN_PWM | PIN_RESERVED)) == PIN_PWM){
+      json.item(pin);
+    }
+  }
+  json.endArray();
+}
+
+//  /PWM/<n> reports how 16-bit timer n runs its PWM pins; FREQ=<Hz>
+//  or BITS=<2-16>, with MODE=<FAST|PHASE>, sets it up and
+//  /PWM/<n>/RESET puts back the core's 8-bit PWM
+boolean routePwm(Connection *conn, ResponseBuffer &out)
+{
+  Request *req = &conn->request;
+  PwmTimer *timer = NULL;
+  int number;
+
+  if(req->segmentCount > 1 && parseNumber(req->segments[1], &number)){
+    timer = findTimer(number);
+  }
+  if(timer == NULL){
+    return routeNotFound(conn, out);
+  }
+
+  if(req->segmentCount > 2){
+    if(strcmp_P(req->segments[2], PSTR("RESET")) != 0){
+      return routeNotFound(conn, out);
+    }
+    if(timerTaken(timer)){
+      return routePinError(conn, out, PIN_BUSY);
+    }
+    resetTimer(timer);
+  } 
+  else if(req->query != NULL && *req->query != '\0'){
+    char *query = req->query;
+    long freq = 0;
+    int bits = 0;
+    boolean phaseCorrect = false;
+    boolean valid = true;
+
+    while(query != NULL && *query != '\0'){
+      char *param = query;
+
+      query = strchr(query, '&');
+      if(query != NULL){
+        *query++ = '\0';
+      }
+
+      if(strncmp_P(param, PSTR("FREQ="), 5) == 0){
+        valid = valid && parseLong(param + 5, &freq) && freq > 0;
+      } 
+      else if(strncmp_P(param, PSTR("BITS="), 5) == 0){
+        valid = valid && parseNumber(param + 5, &bits) && bits > 0 && bits <= 16;
+      } 
+      else if(strncmp_P(param, PSTR("MODE="), 5) == 0){
+        phaseCorrect = (strcmp_P(param + 5, PSTR("PHASE")) == 0);
+        valid = valid && (phaseCorrect || strcmp_P(param + 5, PSTR("FAST")) == 0);
+      }
+    }
+
+    //  one of FREQ and BITS, not both
+    if(!valid || (freq > 0) == (bits > 0)){
+      return routePinError(conn, out, PIN_BADVALUE);
+    }
+    byte result = configureTimer(timer, freq, bits, phaseCorrect);
+    if(result != PIN_OK){
+      return routePinError(conn, out, result);
+    }
+  }
+
+  JsonWriter json(out);
+  beginBody(out, req);
+  json.beginObject();
+  printTimer(json, timer);
+  json.endObject();
+  endBody(out, req);
+  return false;
+}
+
+//  arm a capture from PIN=<pin> (whose port is sampled and which
+//  carries the trigger), RATE=<Hz> and EDGE=<RISE|FALL|ANY|NONE>
+byte parseCapture(char *query)
+{
+  PinAddress addr;
+  boolean havePin = false;
+  long rate = 10000;
+  byte edge = EDGE_NONE;
+
+  while(query != NULL && *query != '\0'){
+    char *param = query;
+
+    query = strchr(query, '&');
+    if(query != NULL){
+      *query++ = '\0';
+    }
+
+    if(strncmp_P(param, PSTR("PIN="), 4) == 0){
+      if(!parsePin(param + 4, &addr)){
+        return PIN_UNKNOWN;
+      }
+      havePin = true;
+    }
+    else if(strncmp_P(param, PSTR("RATE="), 5) == 0){
+      if(!parseLong(param + 5, &rate)){
+        return PIN_BADVALUE;
+      }
+    }
+    else if(strncmp_P(param, PSTR("EDGE="), 5) == 0){
+      static const char edges[][5] PROGMEM = { "NONE", "RISE", "FALL", "ANY" };
+      for(edge = EDGE_NONE; edge <= EDGE_ANY; edge++){
+        if(strcmp_P(param + 5, edges[edge]) == 0){
+          break;
+        }
+      }
+      if(edge > EDGE_ANY){
+        return PIN_BADVALUE;
+      }
+    }
+  }
+
+  if(!havePin || !armCapture(outputPin(&addr), rate, edge)){
+    return PIN_BADVALUE;
+  }
+  return PIN_OK;
+}
+
+//  the captured runs, oldest first, as value/length pairs, and the
+//  digital pin behind each bit of the values (-1 where there is none)
+void printCaptureRuns(JsonWriter &json)
+{
+  json.key(F("PINS"));
+  json.beginArray();
+  for(byte bit = 0; bit < 8; bit++){
+    int found = -1;
+    for(byte pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+      if(digitalPinToPort(pin) == capture.port && digitalPinToBitMask(pin) == (1 << bit)){
+        found = pin;
+        break;
+      }
+    }
+    json.item(found);
+  }
+  json.endArray();
+
+  unsigned int first = (capture.count == CAPTURESIZE) ? capture.head + 1 : 0;
+  json.key(F("RUNS"));
+  json.beginArray();
+  for(unsigned int i = 0; i < capture.count; i++){
+    volatile CaptureRun *run = &capture.runs[(first + i) % CAPTURESIZE];
+    json.item(run->value);
+    json.item((long)run->length);
+  }
+  json.endArray();
+}
+
+//  /CAPTURE reports how the capture is doing, /CAPTURE/ARM starts
+//  one, /CAPTURE/STOP ends it and /CAPTURE/DATA ends it and sends
+//  the runs
+boolean routeCapture(Connection *conn, ResponseBuffer &out)
+{
+  static const char stateNames[][8] PROGMEM = { "IDLE", "ARMED", "RUNNING", "DONE" };
+  Request *req = &conn->request;
+  const char *action = (req->segmentCount > 1) ? req->segments[1] : "";
+
+  if(strcmp_P(action, PSTR("ARM")) == 0){
+    byte result = parseCapture(req->query);
+    if(result != PIN_OK){
+      return routePinError(conn, out, result);
+    }
+  }
+  else if(strcmp_P(action, PSTR("STOP")) == 0 || strcmp_P(action, PSTR("DATA")) == 0){
+    endCapture(CAPTURE_DONE);
+  }
+  else if(*action != '\0'){
+    return routeNotFound(conn, out);
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  byte state = capture.state;
+  unsigned int count = capture.count;
+  SREG = oldSREG;
+
+  JsonWriter json(out);
+  beginBody(out, req);
+  json.beginObject();
+  json.key(F("STATE"));
+  json.value((const __FlashStringHelper *)stateNames[state]);
+  json.key(F("RATE"));
+  json.value(capture.rate);
+  json.key(F("COUNT"));
+  json.value((long)count);
+  if(strcmp_P(action, PSTR("DATA")) == 0){
+    printCaptureRuns(json);
+  }
+  json.endObject();
+  endBody(out, req);
+  return false;
+}
+
+//  add the pins named in an /EVENTS query (and an optional DB=n
+//  deadband) to a stream's watch list
+void parseWatchList(EventStream *stream, char *query)
+{
+  stream->deadband = EVENTS_DEADBAND;
+  stream->watchCount = 0;
+
+  while(query != NULL && *query != '\0'){
+    char *name = query;
+
+    query = strchr(query, '&');
+    if(query != NULL){
+      *query++ = '\0';
+    }
+
+    if(strncmp_P(name, PSTR("DB="), 3) == 0){
+      stream->deadband = atoi(name + 3);
+      continue;
+    }
+
+    PinAddress addr;
+    if(stream->watchCount >= MAXWATCH || !parsePin(name, &addr)){
+      continue;
+    }
+
+    Watch *watch = &stream->watches[stream->watchCount++];
+    watch->analog = addr.analog;
+    watch->pin = addr.pin;
+
+    //  nothing reported yet, the first sample always goes out
+    watch->value = -1;
+  }
+}
+
+//  stop serving a connection; the socket is shut down from
+//  serviceConnection() once the response has left the W5100
+void closeConnection(Connection *conn)
+{
+  conn->state = CONN_DRAINING;
+  conn->lastActivity = millis();
+}
+
+//  forget a socket that has been shut down
+void releaseConnection(Connection *conn)
+{
+#if defined(ARDUINO) && ARDUINO >= 100
+  conn->client = EthernetClient(MAX_SOCK_NUM);
+#else
+  conn->client = Client(MAX_SOCK_NUM);
+#endif
+  conn->state = CONN_FREE;
+}
+
+//  has the W5100 sent everything written to this socket?
+boolean transmitDone(byte sock)
+{
+#if defined(SPI_ETHERNET_SETTINGS)
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+#endif
+  boolean done = (W5100.readSnTX_RD(sock) == W5100.readSnTX_WR(sock));
+#if defined(SPI_ETHERNET_SETTINGS)
+  SPI.endTransaction();
+#endif
+  return done;
+}
+
+//  turn a connection into an event stream for the pins named in
+//  its request; answers 400 and returns false when none are valid
+boolean openEventStream(Connection *conn, ResponseBuffer &out)
+{
+  EventStream events;
+
+  //  parse first, the watch list overwrites the request
+  parseWatchList(&events, conn->request.query);
+  if(events.watchCount == 0){
+    sendHeaders(out, header400, 0, conn->request.keepAlive);
+    return false;
+  }
+
+  printProgmem(out, headerEvents);
+
+  events.lastSample = millis() - EVENTS_INTERVAL;
+  events.lastSent = millis();
+  conn->events = events;
+  return true;
+}
+
+//  routes are picked by a small hash of the first path segment;
+//  ROUTEHASH gives the same hash for a literal at compile time, so
+//  two routes that clash are a duplicate case and fail to build
+#define ROUTEHASH(name) ((name[0] + 3 * (sizeof(name) - 1)) & 0x0F)
+#define ROUTE(name, handler) \
+  case ROUTEHASH(name): \
+    return (strcmp_P(segment, PSTR(name)) == 0) ? handler : routePin;
+
+//  the handler for a first path segment, found with one jump and
+//  one compare however many routes there are
+RouteHandler findRoute(const char *segment)
+{
+  switch((segment[0] + 3 * strlen(segment)) & 0x0F){
+    ROUTE("PORT", routePorts)
+    ROUTE("D*", routePorts)
+    ROUTE("BATCH", routeBatch)
+    ROUTE("EVENTS", openEventStream)
+    ROUTE("STATE", routeState)
+    ROUTE("CAPTURE", routeCapture)
+    ROUTE("PWM", routePwm)
+  }
+  return routePin;
+}
+
+//  answer a parsed request; true when the connection now
+//  belongs to the route that answered it
+boolean dispatchRequest(Connection *conn, ResponseBuffer &out)
+{
+  Request *req = &conn->request;
+
+#if DEBUG
+  Serial.print("method = "); Serial.println(req->method);
+  for(byte i = 0; i < req->segmentCount; i++){
+    Serial.print("segment = "); Serial.println(req->segments[i]);
+  }
+#endif
+
+  if(req->error || req->segmentCount < 1){
+    return routeNotFound(conn, out);
+  }
+  return findRoute(req->segments[0])(conn, out);
+}
+
+//  sample the watched pins of a stream and send one event holding
+//  whatever changed since it was last reported; the port snapshot
+//  is taken once per loop() and shared by every stream
+void serviceEventStream(Connection *conn, byte *ports, boolean *sampled)
+{
+  EventStream *stream = &conn->events;
+  unsigned long now = millis();
+  char outValue[10];
+
+  if(!conn->client.connected()){
+    closeConnection(conn);
+    return;
+  }
+
+  if(now - stream->lastSample < EVENTS_INTERVAL){
+    return;
+  }
+  stream->lastSample = now;
+
+  //  a client that has stopped reading, like a suspended browser tab,
+  //  gets nothing more until it has taken the last event; the changes
+  //  meanwhile go out together then. One that takes nothing for a
+  //  heartbeat's time is closed.
+  if(transmitRoom(conn->client.getSocketNumber()) < W5100.SSIZE){
+    if(now - stream->lastSent > EVENTS_HEARTBEAT){
+      closeConnection(conn);
+    }
+    return;
+  }
+
+  if(!*sampled){
+    readPorts(ports);
+    *sampled = true;
+  }
+
+  //  each event goes out in one write
+  ResponseBuffer out(conn->client.getSocketNumber());
+  JsonWriter json(out);
+
+  boolean changed = false;
+  for(byte w = 0; w < stream->watchCount; w++){
+    Watch *watch = &stream->watches[w];
+    int value;
+
+    if(watch->analog){
+      value = analogSample(watch->pin);
+      if(watch->value >= 0 && abs(value - watch->value) <= stream->deadband){
+        continue;
+      }
+      sprintf(outValue, "%d", value);
+    } 
+    else {
+      value = snapshotLevel(ports, watch->pin);
+      if(value == watch->value){
+        continue;
+      }
+      strcpy_P(outValue, value ? PSTR("HIGH") : PSTR("LOW"));
+    }
+    watch->value = value;
+
+    if(!changed){
+      out.print(F("data: "));
+      json.beginObject();
+      changed = true;
+    }
+    json.key(watch->analog ? 'A' : 'D', watch->pin);
+    json.value(outValue);
+  }
+
+  if(changed){
+    json.endObject();
+    out.print(F("\n\n"));
+    stream->lastSent = now;
+  } 
+  else if(now - stream->lastSent > EVENTS_HEARTBEAT){
+    out.print(F(":\n\n"));
+    stream->lastSent = now;
+  }
+}
+
+//  give a client that has sent data a connection of its own; when
+//  all are busy the longest idle keep-alive connection gives way
+void acceptConnection()
+{
+  //  listen for incoming clients; the client handed back is the
+  //  first with data waiting, which may be one served already with
+  //  pipelined requests queued, so the server's sockets after it are
+  //  gone through too
+#if defined(ARDUINO) && ARDUINO >= 100
+  EthernetClient first = server.available();
+#else
+  Client first = server.available();
+#endif
+  if(!first){
+    return;
+  }
+
+  byte sock;
+  for(sock = first.getSocketNumber(); sock < MAX_SOCK_NUM; sock++){
+    if(EthernetClass::_server_port[sock] != SERVERPORT){
+      continue;
+    }
+
+#if defined(ARDUINO) && ARDUINO >= 100
+    EthernetClient candidate(sock);
+#else
+    Client candidate(sock);
+#endif
+    byte status = candidate.status();
+    if((status != SnSR::ESTABLISHED && status != SnSR::CLOSE_WAIT) || !candidate.available()){
+      continue;
+    }
+
+    //  already being served
+    byte i;
+    for(i = 0; i < MAXCONNECTIONS; i++){
+      if(connections[i].state != CONN_FREE && connections[i].client == candidate){
+        break;
+      }
+    }
+    if(i == MAXCONNECTIONS){
+      break;
+    }
+  }
+  if(sock == MAX_SOCK_NUM){
+    return;
+  }
+
+#if defined(ARDUINO) && ARDUINO >= 100
+  EthernetClient incoming(sock);
+#else
+  Client incoming(sock);
+#endif
+
+  Connection *slot = NULL;
+  for(byte i = 0; i < MAXCONNECTIONS; i++){
+    if(connections[i].state == CONN_FREE){
+      slot = &connections[i];
+      break;
+    }
+  }
+
+  if(slot == NULL){
+    for(byte i = 0; i < MAXCONNECTIONS; i++){
+      Connection *conn = &connections[i];
+      if(conn->state == CONN_READING && conn->request.index == 0 &&
+         conn->client.available() == 0 &&
+         (slot == NULL || conn->lastActivity < slot->lastActivity)){
+        slot = conn;
+      }
+    }
+  }
+
+  //  nothing free or idle, the client waits for a later pass
+  if(slot == NULL){
+    return;
+  }
+
+  //  an evicted connection is shut down first, the new client
+  //  is picked up once its socket has been reaped
+  if(slot->state != CONN_FREE){
+    closeConnection(slot);
+    return;
+  }
+
+  slot->client = incoming;
+  slot->state = CONN_READING;
+  slot->lastActivity = millis();
+
+  //  reset the request parser
+  resetRequest(&slot->request);
+}
+
+//  advance one connection by a single step so no client can hold up
+//  the others or Bonjour for more than a few bytes of work
+void serviceConnection(Connection *conn, byte *ports, boolean *sampled)
+{
+  switch(conn->state){
+  case CONN_READING:
+    if(!conn->client.connected()){
+      closeConnection(conn);
+      break;
+    }
+
+    //  consume the request line and headers a few bytes at a time,
+    //  pipelined requests wait on the socket for the next pass
+    for(byte budget = READ_BUDGET; budget > 0 && conn->client.available(); budget--){
+      conn->lastActivity = millis();
+      if(parseRequest(&conn->request, conn->client.read()) == PARSE_DONE){
+        conn->state = CONN_DISPATCH;
+        break;
+      }
+    }
+
+    if(conn->state == CONN_READING && millis() - conn->lastActivity >
+       ((conn->request.index == 0) ? KEEPALIVE_TIMEOUT : REQUEST_TIMEOUT)){
+      closeConnection(conn);
+    }
+    break;
+
+  case CONN_DISPATCH: {
+    //  reading and answering wait while the client hasn't taken the
+    //  last response, so one that stops reading holds up no one else
+    byte sock = conn->client.getSocketNumber();
+    if(transmitRoom(sock) < W5100.SSIZE){
+      if(millis() - conn->lastActivity > SEND_TIMEOUT){
+        close(sock);
+        releaseConnection(conn);
+      }
+      break;
+    }
+
+    //  the whole response is sent in one burst when out goes out
+    //  of scope
+    ResponseBuffer out(sock);
+
+    //  an event stream takes the connection over for good
+    if(dispatchRequest(conn, out)){
+      conn->state = CONN_STREAMING;
+      break;
+    }
+
+    if(conn->request.keepAlive){
+      resetRequest(&conn->request);
+      conn->state = CONN_READING;
+    } 
+    else {
+      closeConnection(conn);
+    }
+    break;
+  }
+
+  case CONN_STREAMING:
+    serviceEventStream(conn, ports, sampled);
+    break;
+
+  case CONN_DRAINING: {
+    //  the server reaps a socket whose peer has closed and left
+    //  nothing to read; once it is listening or closed again it is
+    //  no longer ours to shut down
+    byte status = conn->client.status();
+    if(status != SnSR::ESTABLISHED && status != SnSR::CLOSE_WAIT){
+      releaseConnection(conn);
+    }
+    //  the response is done once the W5100 has sent all of it,
+    //  then send our FIN and move on without waiting for the peer
+    else if(transmitDone(conn->client.getSocketNumber())){
+      disconnect(conn->client.getSocketNumber());
+      conn->state = CONN_CLOSING;
+      conn->lastActivity = millis();
+    } 
+    else if(millis() - conn->lastActivity > CLOSE_TIMEOUT){
+      close(conn->client.getSocketNumber());
+      releaseConnection(conn);
+    }
+    break;
+  }
+
+  case CONN_CLOSING:
+    //  reap the socket once the peer has closed its side. Any state
+    //  but those after our FIN means the server is listening on it
+    //  again, or has already handed it to a new client.
+    switch(conn->client.status()){
+    case SnSR::FIN_WAIT:
+    case SnSR::CLOSING:
+    case SnSR::TIME_WAIT:
+    case SnSR::LAST_ACK:
+      if(millis() - conn->lastActivity > CLOSE_TIMEOUT){
+        close(conn->client.getSocketNumber());
+        releaseConnection(conn);
+      }
+      break;
+
+    default:
+      releaseConnection(conn);
+    }
+    break;
+  }
+}
+
+void loop()
+{
+#if DEBUG
+  unsigned long loopStart = micros();
+#endif
+
+  //  the schedule is checked between every other piece of work,
+  //  which bounds how late an event runs
+  runSchedule();
+
+  // needed to continue Bonjour/Zeroconf name registration
+  EthernetBonjour.run();
+
+  runSchedule();
+  acceptConnection();
+
+  byte ports[PORTCOUNT];
+  boolean sampled = false;
+  for(byte i = 0; i < MAXCONNECTIONS; i++){
+    runSchedule();
+    serviceConnection(&connections[i], ports, &sampled);
+  }
+
+#if DEBUG
+  unsigned long loopMicros = micros() - loopStart;
+  if(loopMicros > worstLoopMicros){
+    worstLoopMicros = loopMicros;
+    Serial.print("worst loop (us): "); Serial.println(worstLoopMicros);
+  }
+#endif
+}
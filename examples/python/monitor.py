@@ -21,12 +21,24 @@ gauge_update_threshold = 10 # how often (in seconds) to send an update to RESTDu
 last_sample = 0
 gauge_update_counter = 0
 value_avg_accumulator = 0
+
+# one persistent (keep-alive) connection is reused for every request
+conn = httplib.HTTPConnection(restduino_address)
+
+def restduino_get(url):
+	global conn
+	try:
+		conn.request('GET', url)
+		return conn.getresponse().read()
+	except (httplib.HTTPException, IOError):
+		# the board closed an idle connection, reconnect and retry once
+		conn.close()
+		conn = httplib.HTTPConnection(restduino_address)
+		conn.request('GET', url)
+		return conn.getresponse().read()
 		
 # turn on green led
-conn = httplib.HTTPConnection(restduino_address)
-gauge_url = '/14/HIGH'
-conn.request('GET', gauge_url)
-conn.close()
+restduino_get('/14/HIGH')
 
 while True:
 
@@ -60,26 +72,17 @@ while True:
 			print('%f octets, %f megabits, %d scale' % (this_value, this_value_megabits, value_avg))
 
 			# update restduino
-			conn = httplib.HTTPConnection(restduino_address)
 			gauge_url = '/5/%d' % value_avg 
-			conn.request('GET', gauge_url)
-			conn.close()
+			restduino_get(gauge_url)
 
 			# set led indicators
-			# need to wait between requests or we may overwhelm RESTduino
-			sleep(1)
-
 			# set yellow led 
  			if value_avg > warn_threshold:
 				gauge_url = '/15/HIGH'
 			else:
 				gauge_url = '/15/LOW'
 
-			conn = httplib.HTTPConnection(restduino_address)
-			conn.request('GET', gauge_url)
-			conn.close()
-
-			sleep(1)
+			restduino_get(gauge_url)
 
 			# set red led
 			if value_avg > danger_threshold:
@@ -87,9 +90,7 @@ while True:
 			else:
 				gauge_url = '/16/LOW'
 
-			conn = httplib.HTTPConnection(restduino_address)
-			conn.request('GET', gauge_url)
-			conn.close()
+			restduino_get(gauge_url)
 		
 		except:
 			print('error displaying reading, waiting for next round')
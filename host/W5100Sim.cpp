@@ -0,0 +1,748 @@
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "W5100Sim.h"
+
+W5100Sim W5100Chip;
+
+//  common and socket register addresses, socket n's registers
+//  at SOCKET_BASE + n * SOCKET_SIZE
+#define MR 0x0000
+#define SIPR 0x000F
+#define RTR 0x0017
+#define RCR 0x0019
+#define RMSR 0x001A
+#define TMSR 0x001B
+#define SOCKET_BASE 0x0400
+#define SOCKET_SIZE 0x0100
+
+#define Sn_MR 0x00
+#define Sn_CR 0x01
+#define Sn_IR 0x02
+#define Sn_SR 0x03
+#define Sn_PORT 0x04
+#define Sn_DHAR 0x06
+#define Sn_DIPR 0x0C
+#define Sn_DPORT 0x10
+#define Sn_TX_FSR 0x20
+#define Sn_TX_RD 0x22
+#define Sn_TX_WR 0x24
+#define Sn_RX_RSR 0x26
+#define Sn_RX_RD 0x28
+
+//  2K TX and RX buffers per socket
+#define TX_BASE 0x4000
+#define RX_BASE 0x6000
+#define BUFFER_SIZE 0x0800
+#define BUFFER_MASK 0x07FF
+
+#define MR_TCP 0x01
+#define MR_UDP 0x02
+#define MR_MULTI 0x80
+
+#define CR_OPEN 0x01
+#define CR_LISTEN 0x02
+#define CR_CONNECT 0x04
+#define CR_DISCON 0x08
+#define CR_CLOSE 0x10
+#define CR_SEND 0x20
+#define CR_SEND_MAC 0x21
+#define CR_RECV 0x40
+
+#define IR_CON 0x01
+#define IR_DISCON 0x02
+#define IR_RECV 0x04
+#define IR_TIMEOUT 0x08
+#define IR_SEND_OK 0x10
+
+#define SR_CLOSED 0x00
+#define SR_INIT 0x13
+#define SR_LISTEN 0x14
+#define SR_SYNSENT 0x15
+#define SR_ESTABLISHED 0x17
+#define SR_FIN_WAIT 0x18
+#define SR_CLOSE_WAIT 0x1C
+#define SR_UDP 0x22
+
+W5100Sim::W5100Sim()
+{
+  for(int s = 0; s < SOCKETS; s++){
+    sockets[s].fd = -1;
+  }
+  for(int i = 0; i < PORTMAPS; i++){
+    portMaps[i].port = 0;
+    portMaps[i].hostPort = 0;
+    portMaps[i].listener = -1;
+  }
+  phase = 0;
+  frameCount = 0;
+  badFrameCount = 0;
+  arpFails = false;
+  reset();
+}
+
+//  each frame is opcode, address high, address low and data; the
+//  chip answers 0, 1 and 2 to the first three bytes and either 3 or
+//  the register read to the last
+uint8_t W5100Sim::transfer(uint8_t data)
+{
+  if(phase < 3){
+    frame[phase] = data;
+    return phase++;
+  }
+  phase = 0;
+
+  uint16_t addr = (frame[1] << 8) | frame[2];
+  switch(frame[0]){
+  case 0xF0:
+    frameCount++;
+    write(addr, data);
+    return 3;
+
+  case 0x0F:
+    frameCount++;
+    return read(addr);
+
+  default:
+    badFrameCount++;
+    return 0;
+  }
+}
+
+void W5100Sim::deselect()
+{
+  if(phase != 0){
+    badFrameCount++;
+  }
+  phase = 0;
+}
+
+void W5100Sim::mapPort(uint16_t port, uint16_t hostPort)
+{
+  PortMap *map = portMap(port);
+  if(map == NULL){
+    return;
+  }
+  if(map->listener >= 0){
+    ::close(map->listener);
+    map->listener = -1;
+  }
+  map->hostPort = hostPort;
+}
+
+uint16_t W5100Sim::hostPort(uint16_t port)
+{
+  PortMap *map = portMap(port);
+  return (map != NULL) ? map->hostPort : port;
+}
+
+W5100Sim::PortMap *W5100Sim::portMap(uint16_t port)
+{
+  for(int i = 0; i < PORTMAPS; i++){
+    if(portMaps[i].port == port){
+      return &portMaps[i];
+    }
+  }
+  for(int i = 0; i < PORTMAPS; i++){
+    if(portMaps[i].port == 0){
+      portMaps[i].port = port;
+      portMaps[i].hostPort = port;
+      portMaps[i].listener = -1;
+      return &portMaps[i];
+    }
+  }
+  return NULL;
+}
+
+uint8_t &W5100Sim::reg(int s, uint16_t offset)
+{
+  return mem[SOCKET_BASE + s * SOCKET_SIZE + offset];
+}
+
+uint16_t W5100Sim::reg16(int s, uint16_t offset)
+{
+  return (reg(s, offset) << 8) | reg(s, offset + 1);
+}
+
+void W5100Sim::setReg16(int s, uint16_t offset, uint16_t value)
+{
+  reg(s, offset) = value >> 8;
+  reg(s, offset + 1) = value & 0xFF;
+}
+
+void W5100Sim::reset()
+{
+  for(int s = 0; s < SOCKETS; s++){
+    closeHost(s);
+  }
+  memset(mem, 0, sizeof(mem));
+
+  mem[RTR] = 0x07;
+  mem[RTR + 1] = 0xD0;
+  mem[RCR] = 0x08;
+  mem[RMSR] = 0x55;
+  mem[TMSR] = 0x55;
+  for(int s = 0; s < SOCKETS; s++){
+    setReg16(s, Sn_TX_FSR, BUFFER_SIZE);
+  }
+}
+
+//  the registers that change by themselves are brought up to date
+//  with the host socket when read; for the 16-bit ones that is on
+//  reading their high byte, the library reads them until two reads
+//  agree like on the chip
+uint8_t W5100Sim::read(uint16_t addr)
+{
+  if(addr >= sizeof(mem)){
+    return 0;
+  }
+
+  if(addr >= SOCKET_BASE && addr < SOCKET_BASE + SOCKETS * SOCKET_SIZE){
+    int s = (addr - SOCKET_BASE) / SOCKET_SIZE;
+    switch(addr % SOCKET_SIZE){
+    case Sn_IR:
+    case Sn_SR:
+    case Sn_TX_FSR:
+    case Sn_TX_RD:
+    case Sn_RX_RSR:
+      poll(s);
+      break;
+    }
+  }
+
+  return mem[addr];
+}
+
+void W5100Sim::write(uint16_t addr, uint8_t data)
+{
+  if(addr >= sizeof(mem)){
+    return;
+  }
+
+  if(addr == MR){
+    if(data & 0x80){
+      reset();
+    }
+    else {
+      mem[MR] = data;
+    }
+    return;
+  }
+
+  if(addr >= SOCKET_BASE && addr < SOCKET_BASE + SOCKETS * SOCKET_SIZE){
+    int s = (addr - SOCKET_BASE) / SOCKET_SIZE;
+    switch(addr % SOCKET_SIZE){
+    case Sn_CR:
+      command(s, data);
+      return;
+
+    //  interrupt bits are cleared by writing ones
+    case Sn_IR:
+      mem[addr] &= ~data;
+      return;
+
+    //  read only
+    case Sn_SR:
+    case Sn_TX_FSR:
+    case Sn_TX_FSR + 1:
+    case Sn_TX_RD:
+    case Sn_TX_RD + 1:
+    case Sn_RX_RSR:
+    case Sn_RX_RSR + 1:
+      return;
+    }
+  }
+
+  mem[addr] = data;
+}
+
+void W5100Sim::command(int s, uint8_t cmd)
+{
+  Socket *k = &sockets[s];
+  uint8_t &sr = reg(s, Sn_SR);
+
+  switch(cmd){
+  case CR_OPEN:
+    openSocket(s);
+    break;
+
+  case CR_LISTEN:
+    if(sr == SR_INIT){
+      sr = (listener(reg16(s, Sn_PORT)) >= 0) ? SR_LISTEN : SR_CLOSED;
+    }
+    break;
+
+  case CR_CONNECT:
+    if(sr == SR_INIT){
+      struct sockaddr_in to;
+      memset(&to, 0, sizeof(to));
+      to.sin_family = AF_INET;
+      memcpy(&to.sin_addr.s_addr, &reg(s, Sn_DIPR), 4);
+      to.sin_port = htons(reg16(s, Sn_DPORT));
+
+      k->fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      if(k->fd < 0 ||
+         (::connect(k->fd, (struct sockaddr *)&to, sizeof(to)) < 0 && errno != EINPROGRESS)){
+        closeHost(s);
+        sr = SR_CLOSED;
+        reg(s, Sn_IR) |= IR_TIMEOUT;
+      }
+      else {
+        sr = SR_SYNSENT;
+      }
+    }
+    break;
+
+  //  the FIN follows whatever is still being sent
+  case CR_DISCON:
+    if(sr == SR_ESTABLISHED || sr == SR_CLOSE_WAIT){
+      k->finPending = true;
+      poll(s);
+    }
+    else {
+      closeHost(s);
+      sr = SR_CLOSED;
+    }
+    break;
+
+  case CR_CLOSE:
+    closeHost(s);
+    sr = SR_CLOSED;
+    break;
+
+  case CR_SEND:
+  case CR_SEND_MAC:
+    if(sr == SR_UDP){
+      sendUDP(s);
+    }
+    else if(sr == SR_ESTABLISHED || sr == SR_CLOSE_WAIT){
+      k->txEnd = reg16(s, Sn_TX_WR);
+      k->sending = true;
+      poll(s);
+    }
+    break;
+
+  case CR_RECV:
+    k->rxRd = reg16(s, Sn_RX_RD);
+    setReg16(s, Sn_RX_RSR, k->rxWr - k->rxRd);
+    break;
+  }
+
+  //  every command completes at once
+  reg(s, Sn_CR) = 0;
+}
+
+void W5100Sim::openSocket(int s)
+{
+  Socket *k = &sockets[s];
+  uint8_t mode = reg(s, Sn_MR);
+  uint8_t &sr = reg(s, Sn_SR);
+
+  closeHost(s);
+  k->rxWr = k->rxRd = 0;
+  k->txRd = k->txEnd = 0;
+  k->looped = 0;
+  setReg16(s, Sn_TX_RD, 0);
+  setReg16(s, Sn_TX_WR, 0);
+  setReg16(s, Sn_RX_RD, 0);
+  setReg16(s, Sn_RX_RSR, 0);
+  setReg16(s, Sn_TX_FSR, BUFFER_SIZE);
+  reg(s, Sn_IR) = 0;
+  sr = SR_CLOSED;
+
+  if((mode & 0x0F) == MR_TCP){
+    sr = SR_INIT;
+    return;
+  }
+  if((mode & 0x0F) != MR_UDP){
+    return;
+  }
+
+  int one = 1;
+  int ttl = 255;
+  struct sockaddr_in addr;
+  socklen_t addrLength = sizeof(addr);
+  PortMap *map = portMap(reg16(s, Sn_PORT));
+
+  k->fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if(k->fd < 0){
+    return;
+  }
+
+  //  share the port with a responder already running on the host.
+  //  Unicast to a shared port reaches only the socket bound last, so
+  //  a plain socket binds the chip's own address where it can, and
+  //  leaves unicast to other addresses to whoever bound the port
+  //  before it.
+  setsockopt(k->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((map != NULL) ? map->hostPort : reg16(s, Sn_PORT));
+  memcpy(&addr.sin_addr.s_addr, &mem[SIPR], 4);
+  bool bound = !(mode & MR_MULTI) &&
+    bind(k->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if(!bound && bind(k->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    perror("W5100Sim: bind");
+    closeHost(s);
+    return;
+  }
+  if(map != NULL && map->hostPort == 0 &&
+     getsockname(k->fd, (struct sockaddr *)&addr, &addrLength) == 0){
+    map->hostPort = ntohs(addr.sin_port);
+  }
+
+  //  a multicast socket joins the group in Sn_DIPR when opened
+  if(mode & MR_MULTI){
+    struct ip_mreq mreq;
+    memcpy(k->group, &reg(s, Sn_DIPR), 4);
+    memcpy(&mreq.imr_multiaddr.s_addr, k->group, 4);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    setsockopt(k->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    setsockopt(k->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+    setsockopt(k->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  }
+
+  sr = SR_UDP;
+}
+
+void W5100Sim::closeHost(int s)
+{
+  Socket *k = &sockets[s];
+
+  if(k->fd >= 0){
+    ::close(k->fd);
+  }
+  k->fd = -1;
+  k->sending = false;
+  k->finPending = false;
+}
+
+//  the host socket every chip socket listening on port shares
+int W5100Sim::listener(uint16_t port)
+{
+  PortMap *map = portMap(port);
+  struct sockaddr_in addr;
+  socklen_t addrLength = sizeof(addr);
+  int one = 1;
+
+  if(map == NULL){
+    return -1;
+  }
+  if(map->listener >= 0){
+    return map->listener;
+  }
+
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if(fd < 0){
+    return -1;
+  }
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(map->hostPort);
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(fd, 8) < 0){
+    perror("W5100Sim: listen");
+    ::close(fd);
+    return -1;
+  }
+  if(getsockname(fd, (struct sockaddr *)&addr, &addrLength) == 0){
+    map->hostPort = ntohs(addr.sin_port);
+  }
+
+  map->listener = fd;
+  return fd;
+}
+
+void W5100Sim::poll(int s)
+{
+  switch(reg(s, Sn_SR)){
+  case SR_UDP:
+    pollUDP(s);
+    break;
+
+  case SR_LISTEN:
+  case SR_SYNSENT:
+  case SR_ESTABLISHED:
+  case SR_FIN_WAIT:
+  case SR_CLOSE_WAIT:
+    pollTCP(s);
+    break;
+  }
+}
+
+void W5100Sim::pollTCP(int s)
+{
+  Socket *k = &sockets[s];
+  uint8_t &sr = reg(s, Sn_SR);
+  int one = 1;
+  int bufferSize = BUFFER_SIZE;
+
+  if(sr == SR_LISTEN){
+    PortMap *map = portMap(reg16(s, Sn_PORT));
+    struct sockaddr_in peer;
+    socklen_t peerLength = sizeof(peer);
+
+    if(map == NULL || map->listener < 0){
+      return;
+    }
+    int fd = accept4(map->listener, (struct sockaddr *)&peer, &peerLength, SOCK_NONBLOCK);
+    if(fd < 0){
+      return;
+    }
+
+    //  the chip sends each SEND straight away, without Nagle, and
+    //  holds no more than its own buffer for a peer that stops
+    //  reading, so the host's send buffer is kept as small as it goes
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+    k->fd = fd;
+    memcpy(&reg(s, Sn_DIPR), &peer.sin_addr.s_addr, 4);
+    setReg16(s, Sn_DPORT, ntohs(peer.sin_port));
+    sr = SR_ESTABLISHED;
+    reg(s, Sn_IR) |= IR_CON;
+  }
+
+  if(sr == SR_SYNSENT){
+    struct pollfd pfd = { k->fd, POLLOUT, 0 };
+    int error = 0;
+    socklen_t errorLength = sizeof(error);
+
+    if(::poll(&pfd, 1, 0) <= 0){
+      return;
+    }
+    getsockopt(k->fd, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+    if(error != 0){
+      closeHost(s);
+      sr = SR_CLOSED;
+      reg(s, Sn_IR) |= IR_TIMEOUT;
+      return;
+    }
+    setsockopt(k->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(k->fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+    sr = SR_ESTABLISHED;
+    reg(s, Sn_IR) |= IR_CON;
+  }
+
+  if(k->fd < 0){
+    return;
+  }
+
+  //  send what the host takes of the data between TX_RD and the
+  //  TX_WR of the last SEND
+  while(k->sending && k->txRd != k->txEnd){
+    uint16_t offset = k->txRd & BUFFER_MASK;
+    uint16_t length = k->txEnd - k->txRd;
+    if(length > BUFFER_SIZE - offset){
+      length = BUFFER_SIZE - offset;
+    }
+
+    ssize_t sent = ::send(k->fd, &mem[TX_BASE + s * BUFFER_SIZE + offset], length,
+      MSG_DONTWAIT | MSG_NOSIGNAL);
+    if(sent < 0){
+      if(errno == EAGAIN || errno == EWOULDBLOCK){
+        break;
+      }
+      closeHost(s);
+      sr = SR_CLOSED;
+      reg(s, Sn_IR) |= IR_DISCON;
+      return;
+    }
+    k->txRd += sent;
+    if(sent < length){
+      break;
+    }
+  }
+  setReg16(s, Sn_TX_RD, k->txRd);
+  if(k->sending && k->txRd == k->txEnd){
+    k->sending = false;
+    reg(s, Sn_IR) |= IR_SEND_OK;
+  }
+
+  if(k->finPending && !k->sending){
+    k->finPending = false;
+    shutdown(k->fd, SHUT_WR);
+    if(sr == SR_CLOSE_WAIT){
+      closeHost(s);
+      sr = SR_CLOSED;
+      return;
+    }
+    sr = SR_FIN_WAIT;
+  }
+
+  //  take in as much as fits in the RX buffer; a FIN from the peer
+  //  moves the socket on to CLOSE_WAIT, or to CLOSED after ours
+  while(sr != SR_CLOSE_WAIT){
+    uint16_t room = BUFFER_SIZE - (uint16_t)(k->rxWr - k->rxRd);
+    uint16_t offset = k->rxWr & BUFFER_MASK;
+    uint16_t length = (room < BUFFER_SIZE - offset) ? room : BUFFER_SIZE - offset;
+    if(length == 0){
+      break;
+    }
+
+    ssize_t got = ::recv(k->fd, &mem[RX_BASE + s * BUFFER_SIZE + offset], length, MSG_DONTWAIT);
+    if(got == 0){
+      reg(s, Sn_IR) |= IR_DISCON;
+      if(sr == SR_FIN_WAIT){
+        closeHost(s);
+        sr = SR_CLOSED;
+        return;
+      }
+      sr = SR_CLOSE_WAIT;
+      break;
+    }
+    if(got < 0){
+      if(errno == EAGAIN || errno == EWOULDBLOCK){
+        break;
+      }
+      closeHost(s);
+      sr = SR_CLOSED;
+      reg(s, Sn_IR) |= IR_DISCON;
+      return;
+    }
+    k->rxWr += got;
+    reg(s, Sn_IR) |= IR_RECV;
+    if(got < length){
+      break;
+    }
+  }
+
+  setReg16(s, Sn_RX_RSR, k->rxWr - k->rxRd);
+  setReg16(s, Sn_TX_FSR, BUFFER_SIZE - (uint16_t)(reg16(s, Sn_TX_WR) - k->txRd));
+}
+
+//  datagrams go into the RX buffer behind the 8 byte header the chip
+//  puts in front of each: sender address, port and length. One that
+//  doesn't fit waits on the host socket. The chip never hears its own
+//  multicasts, so those the host loops back are dropped.
+void W5100Sim::pollUDP(int s)
+{
+  Socket *k = &sockets[s];
+  uint8_t packet[BUFFER_SIZE];
+  uint8_t header[8];
+  struct sockaddr_in from;
+  socklen_t fromLength;
+
+  for(;;){
+    ssize_t length = ::recv(k->fd, packet, sizeof(packet), MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+    uint16_t room = BUFFER_SIZE - (uint16_t)(k->rxWr - k->rxRd);
+    if(length < 0 || length + 8 > room){
+      break;
+    }
+
+    fromLength = sizeof(from);
+    length = ::recvfrom(k->fd, packet, sizeof(packet), MSG_DONTWAIT,
+      (struct sockaddr *)&from, &fromLength);
+    if(length < 0){
+      break;
+    }
+    if(ntohs(from.sin_port) == reg16(s, Sn_PORT) && looped(s, packet, length)){
+      continue;
+    }
+
+    memcpy(header, &from.sin_addr.s_addr, 4);
+    header[4] = ntohs(from.sin_port) >> 8;
+    header[5] = ntohs(from.sin_port) & 0xFF;
+    header[6] = length >> 8;
+    header[7] = length & 0xFF;
+    receive(s, header, 8);
+    receive(s, packet, length);
+    reg(s, Sn_IR) |= IR_RECV;
+  }
+
+  setReg16(s, Sn_RX_RSR, k->rxWr - k->rxRd);
+}
+
+uint32_t W5100Sim::hash(const uint8_t *data, uint16_t length)
+{
+  uint32_t h = 2166136261UL;
+  for(uint16_t i = 0; i < length; i++){
+    h = (h ^ data[i]) * 16777619UL;
+  }
+  return h;
+}
+
+//  is this one of our own datagrams back from the group? it is
+//  forgotten then, the host loops each back once
+bool W5100Sim::looped(int s, const uint8_t *data, uint16_t length)
+{
+  Socket *k = &sockets[s];
+  uint32_t h = hash(data, length);
+
+  for(int i = 0; i < k->looped; i++){
+    if(k->loopedLength[i] == length && k->loopedHash[i] == h){
+      k->looped--;
+      memmove(k->loopedHash + i, k->loopedHash + i + 1, (k->looped - i) * sizeof(k->loopedHash[0]));
+      memmove(k->loopedLength + i, k->loopedLength + i + 1,
+        (k->looped - i) * sizeof(k->loopedLength[0]));
+      return true;
+    }
+  }
+  return false;
+}
+
+void W5100Sim::receive(int s, const uint8_t *data, uint16_t length)
+{
+  Socket *k = &sockets[s];
+  for(uint16_t i = 0; i < length; i++){
+    mem[RX_BASE + s * BUFFER_SIZE + ((k->rxWr + i) & BUFFER_MASK)] = data[i];
+  }
+  k->rxWr += length;
+}
+
+//  the data between TX_RD and TX_WR as one datagram. A multicast
+//  socket addresses its frames to the group's MAC address it was
+//  opened with, so they go to the group whatever Sn_DIPR says now.
+void W5100Sim::sendUDP(int s)
+{
+  Socket *k = &sockets[s];
+  uint16_t end = reg16(s, Sn_TX_WR);
+  uint16_t length = end - k->txRd;
+  struct sockaddr_in to;
+
+  if(length > BUFFER_SIZE){
+    length = BUFFER_SIZE;
+  }
+  for(uint16_t i = 0; i < length; i++){
+    k->sent[i] = mem[TX_BASE + s * BUFFER_SIZE + ((k->txRd + i) & BUFFER_MASK)];
+  }
+  k->txRd = end;
+  setReg16(s, Sn_TX_RD, end);
+  setReg16(s, Sn_TX_FSR, BUFFER_SIZE);
+
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_port = htons(reg16(s, Sn_DPORT));
+  if(reg(s, Sn_MR) & MR_MULTI){
+    memcpy(&to.sin_addr.s_addr, k->group, 4);
+    if(k->looped == LOOPED){
+      k->looped--;
+      memmove(k->loopedHash, k->loopedHash + 1, k->looped * sizeof(k->loopedHash[0]));
+      memmove(k->loopedLength, k->loopedLength + 1, k->looped * sizeof(k->loopedLength[0]));
+    }
+    k->loopedHash[k->looped] = hash(k->sent, length);
+    k->loopedLength[k->looped] = length;
+    k->looped++;
+  }
+  else if(arpFails){
+    reg(s, Sn_IR) |= IR_TIMEOUT;
+    return;
+  }
+  else {
+    memcpy(&to.sin_addr.s_addr, &reg(s, Sn_DIPR), 4);
+  }
+
+  ::sendto(k->fd, k->sent, length, 0, (struct sockaddr *)&to, sizeof(to));
+  reg(s, Sn_IR) |= IR_SEND_OK;
+}
@@ -0,0 +1,104 @@
+//  a W5100 on the host's network stack. The chip is driven through its
+//  SPI frames, 0xF0 (write) or 0x0F (read), address high, address low
+//  and one data byte, and keeps its registers and 2K socket buffers in
+//  a memory map laid out as on the chip. Each socket is backed by a
+//  host socket: TCP sockets by a listening or connected socket on the
+//  loopback or any other interface, UDP sockets by a datagram socket,
+//  so the sketch serves curl and answers mDNS queries from the host.
+
+#ifndef W5100Sim_h
+#define W5100Sim_h
+
+#include <stdint.h>
+
+class W5100Sim {
+public:
+  W5100Sim();
+
+  //  one byte clocked in while the chip is selected, and its reply
+  uint8_t transfer(uint8_t data);
+
+  //  the select went high; a partial frame is dropped
+  void deselect();
+
+  //  serve the chip's TCP or UDP port on another host port, 0 for
+  //  one picked by the host; hostPort() tells which once it is open
+  void mapPort(uint16_t port, uint16_t hostPort);
+  uint16_t hostPort(uint16_t port);
+
+  //  complete frames taken, and those that were not W5100 frames;
+  //  each frame is four bytes on the bus
+  uint32_t frames() const { return frameCount; }
+  uint32_t badFrames() const { return badFrameCount; }
+  void resetCounters() { frameCount = 0; badFrameCount = 0; }
+
+  //  a byte of the memory map as the chip holds it, for tests
+  uint8_t memory(uint16_t addr) const { return mem[addr & 0x7FFF]; }
+
+  //  with fails set, no host answers the chip's ARP requests: a UDP
+  //  SEND to a unicast address ends in TIMEOUT and nothing is sent
+  void failArp(bool fails) { arpFails = fails; }
+
+private:
+  static const int SOCKETS = 4;
+  static const int PORTMAPS = 8;
+  static const int LOOPED = 8;
+
+  struct Socket {
+    int fd;
+    uint16_t rxWr;
+    uint16_t rxRd;
+    uint16_t txRd;
+    uint16_t txEnd;
+    bool sending;
+    bool finPending;
+    uint8_t group[4];
+    uint8_t sent[2048];
+    //  the datagrams sent to the group lately, which the host loops
+    //  back to this socket and the chip never sees
+    uint32_t loopedHash[LOOPED];
+    uint16_t loopedLength[LOOPED];
+    int looped;
+  };
+
+  struct PortMap {
+    uint16_t port;
+    uint16_t hostPort;
+    int listener;
+  };
+
+  uint8_t read(uint16_t addr);
+  void write(uint16_t addr, uint8_t data);
+  void reset();
+
+  uint16_t reg16(int s, uint16_t offset);
+  void setReg16(int s, uint16_t offset, uint16_t value);
+  uint8_t &reg(int s, uint16_t offset);
+
+  void command(int s, uint8_t cmd);
+  void openSocket(int s);
+  void closeHost(int s);
+  void poll(int s);
+  void pollTCP(int s);
+  void pollUDP(int s);
+  void sendUDP(int s);
+  bool looped(int s, const uint8_t *data, uint16_t length);
+  static uint32_t hash(const uint8_t *data, uint16_t length);
+  void receive(int s, const uint8_t *data, uint16_t len);
+  int listener(uint16_t port);
+  PortMap *portMap(uint16_t port);
+
+  uint8_t mem[0x8000];
+  Socket sockets[SOCKETS];
+  PortMap portMaps[PORTMAPS];
+
+  uint8_t frame[3];
+  uint8_t phase;
+  uint32_t frameCount;
+  uint32_t badFrameCount;
+  bool arpFails;
+};
+
+extern W5100Sim W5100Chip;
+
+#endif
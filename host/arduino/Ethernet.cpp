@@ -0,0 +1,98 @@
+#include "Ethernet.h"
+
+IPAddress hostDHCPAddress(127, 0, 0, 1);
+
+uint8_t EthernetClass::_state[MAX_SOCK_NUM] = { 0, };
+uint16_t EthernetClass::_server_port[MAX_SOCK_NUM] = { 0, };
+
+int EthernetClass::begin(uint8_t *mac_address, unsigned long timeout, unsigned long responseTimeout)
+{
+  W5100.init();
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.setMACAddress(mac_address);
+  W5100.setIPAddress(hostDHCPAddress.raw_address());
+  SPI.endTransaction();
+
+  IPAddress gateway = hostDHCPAddress;
+  gateway[3] = 1;
+  IPAddress subnet(255, 255, 255, 0);
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.setGatewayIp(gateway.raw_address());
+  W5100.setSubnetMask(subnet.raw_address());
+  SPI.endTransaction();
+
+  _dnsServerAddress = gateway;
+  return 1;
+}
+
+void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip)
+{
+  //  the DNS server and gateway are assumed at .1
+  IPAddress dns_server = local_ip;
+  dns_server[3] = 1;
+  begin(mac_address, local_ip, dns_server);
+}
+
+void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server)
+{
+  IPAddress gateway = local_ip;
+  gateway[3] = 1;
+  begin(mac_address, local_ip, dns_server, gateway);
+}
+
+void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway)
+{
+  IPAddress subnet(255, 255, 255, 0);
+  begin(mac_address, local_ip, dns_server, gateway, subnet);
+}
+
+void EthernetClass::begin(uint8_t *mac, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet)
+{
+  W5100.init();
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.setMACAddress(mac);
+  W5100.setIPAddress(local_ip.raw_address());
+  W5100.setGatewayIp(gateway.raw_address());
+  W5100.setSubnetMask(subnet.raw_address());
+  SPI.endTransaction();
+  _dnsServerAddress = dns_server;
+}
+
+int EthernetClass::maintain()
+{
+  return 0;
+}
+
+IPAddress EthernetClass::localIP()
+{
+  IPAddress ret;
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.getIPAddress(ret.raw_address());
+  SPI.endTransaction();
+  return ret;
+}
+
+IPAddress EthernetClass::subnetMask()
+{
+  IPAddress ret;
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.getSubnetMask(ret.raw_address());
+  SPI.endTransaction();
+  return ret;
+}
+
+IPAddress EthernetClass::gatewayIP()
+{
+  IPAddress ret;
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.getGatewayIp(ret.raw_address());
+  SPI.endTransaction();
+  return ret;
+}
+
+IPAddress EthernetClass::dnsServerIP()
+{
+  return _dnsServerAddress;
+}
+
+EthernetClass Ethernet;
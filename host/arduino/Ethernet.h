@@ -0,0 +1,43 @@
+//  the Arduino Ethernet library of the host build, on the W5100
+//  driver in utility/; begin() without an address stands in for a
+//  DHCP lease of hostDHCPAddress
+
+#ifndef ethernet_h
+#define ethernet_h
+
+#include <inttypes.h>
+#include "utility/w5100.h"
+#include "IPAddress.h"
+#include "EthernetClient.h"
+#include "EthernetServer.h"
+
+//  the address a DHCP server would lease to the board
+extern IPAddress hostDHCPAddress;
+
+class EthernetClass {
+private:
+  IPAddress _dnsServerAddress;
+public:
+  static uint8_t _state[MAX_SOCK_NUM];
+  static uint16_t _server_port[MAX_SOCK_NUM];
+
+  //  returns 1 when an address was leased, 0 otherwise
+  int begin(uint8_t *mac_address, unsigned long timeout = 60000, unsigned long responseTimeout = 4000);
+  void begin(uint8_t *mac_address, IPAddress local_ip);
+  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server);
+  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway);
+  void begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet);
+  int maintain();
+
+  IPAddress localIP();
+  IPAddress subnetMask();
+  IPAddress gatewayIP();
+  IPAddress dnsServerIP();
+
+  friend class EthernetClient;
+  friend class EthernetServer;
+};
+
+extern EthernetClass Ethernet;
+
+#endif
@@ -0,0 +1,182 @@
+#include "utility/w5100.h"
+#include "utility/socket.h"
+#include "Ethernet.h"
+#include "EthernetClient.h"
+#include "EthernetServer.h"
+
+uint16_t EthernetClient::_srcport = 49152;
+
+EthernetClient::EthernetClient() : _sock(MAX_SOCK_NUM)
+{
+}
+
+EthernetClient::EthernetClient(uint8_t sock) : _sock(sock)
+{
+}
+
+//  no resolver in this build, only dotted addresses connect
+int EthernetClient::connect(const char *host, uint16_t port)
+{
+  unsigned int a, b, c, d;
+  if(sscanf(host, "%u.%u.%u.%u", &a, &b, &c, &d) != 4){
+    return 0;
+  }
+  return connect(IPAddress(a, b, c, d), port);
+}
+
+int EthernetClient::connect(IPAddress ip, uint16_t port)
+{
+  if(_sock != MAX_SOCK_NUM){
+    return 0;
+  }
+
+  for(int i = 0; i < MAX_SOCK_NUM; i++){
+    uint8_t s = socketStatus(i);
+    if(s == SnSR::CLOSED || s == SnSR::FIN_WAIT || s == SnSR::CLOSE_WAIT){
+      _sock = i;
+      break;
+    }
+  }
+
+  if(_sock == MAX_SOCK_NUM){
+    return 0;
+  }
+
+  _srcport++;
+  if(_srcport == 0){
+    _srcport = 49152;
+  }
+  socket(_sock, SnMR::TCP, _srcport, 0);
+
+  if(!::connect(_sock, rawIPAddress(ip), port)){
+    _sock = MAX_SOCK_NUM;
+    return 0;
+  }
+
+  while(status() != SnSR::ESTABLISHED){
+    delay(1);
+    if(status() == SnSR::CLOSED){
+      _sock = MAX_SOCK_NUM;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+size_t EthernetClient::write(uint8_t b)
+{
+  return write(&b, 1);
+}
+
+size_t EthernetClient::write(const uint8_t *buf, size_t size)
+{
+  if(_sock == MAX_SOCK_NUM){
+    setWriteError();
+    return 0;
+  }
+  if(!send(_sock, buf, size)){
+    setWriteError();
+    return 0;
+  }
+  return size;
+}
+
+int EthernetClient::available()
+{
+  if(_sock != MAX_SOCK_NUM){
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    int ret = W5100.getRXReceivedSize(_sock);
+    SPI.endTransaction();
+    return ret;
+  }
+  return 0;
+}
+
+int EthernetClient::read()
+{
+  uint8_t b;
+  if(recv(_sock, &b, 1) > 0){
+    return b;
+  }
+  return -1;
+}
+
+int EthernetClient::read(uint8_t *buf, size_t size)
+{
+  return recv(_sock, buf, size);
+}
+
+int EthernetClient::peek()
+{
+  uint8_t b;
+  if(!available()){
+    return -1;
+  }
+  ::peek(_sock, &b);
+  return b;
+}
+
+void EthernetClient::flush()
+{
+  while(available()){
+    read();
+  }
+}
+
+//  shut the connection down and wait up to a second for the peer
+//  to do the same before closing the socket regardless
+void EthernetClient::stop()
+{
+  if(_sock == MAX_SOCK_NUM){
+    return;
+  }
+
+  disconnect(_sock);
+  unsigned long start = millis();
+
+  while(status() != SnSR::CLOSED && millis() - start < 1000){
+    delay(1);
+  }
+
+  if(status() != SnSR::CLOSED){
+    close(_sock);
+  }
+
+  EthernetClass::_server_port[_sock] = 0;
+  _sock = MAX_SOCK_NUM;
+}
+
+uint8_t EthernetClient::connected()
+{
+  if(_sock == MAX_SOCK_NUM){
+    return 0;
+  }
+
+  uint8_t s = status();
+  return !(s == SnSR::LISTEN || s == SnSR::CLOSED || s == SnSR::FIN_WAIT ||
+    (s == SnSR::CLOSE_WAIT && !available()));
+}
+
+uint8_t EthernetClient::status()
+{
+  if(_sock == MAX_SOCK_NUM){
+    return SnSR::CLOSED;
+  }
+  return socketStatus(_sock);
+}
+
+EthernetClient::operator bool()
+{
+  return _sock != MAX_SOCK_NUM;
+}
+
+bool EthernetClient::operator==(const EthernetClient& rhs)
+{
+  return _sock == rhs._sock && _sock != MAX_SOCK_NUM && rhs._sock != MAX_SOCK_NUM;
+}
+
+uint8_t EthernetClient::getSocketNumber()
+{
+  return _sock;
+}
@@ -0,0 +1,91 @@
+#include "utility/w5100.h"
+#include "utility/socket.h"
+#include "Ethernet.h"
+#include "EthernetClient.h"
+#include "EthernetServer.h"
+
+EthernetServer::EthernetServer(uint16_t port)
+{
+  _port = port;
+}
+
+//  listen on the first closed socket
+void EthernetServer::begin()
+{
+  for(int sock = 0; sock < MAX_SOCK_NUM; sock++){
+    EthernetClient client(sock);
+    if(client.status() == SnSR::CLOSED){
+      socket(sock, SnMR::TCP, _port, 0);
+      listen(sock);
+      EthernetClass::_server_port[sock] = _port;
+      break;
+    }
+  }
+}
+
+//  keep a socket listening, and close those whose peer has gone
+//  and left nothing to read
+void EthernetServer::accept()
+{
+  int listening = 0;
+
+  for(int sock = 0; sock < MAX_SOCK_NUM; sock++){
+    EthernetClient client(sock);
+
+    if(EthernetClass::_server_port[sock] == _port){
+      if(client.status() == SnSR::LISTEN){
+        listening = 1;
+      } 
+      else if(client.status() == SnSR::CLOSE_WAIT && !client.available()){
+        client.stop();
+      }
+    }
+  }
+
+  if(!listening){
+    begin();
+  }
+}
+
+//  a connected client of this server with data waiting, if any
+EthernetClient EthernetServer::available()
+{
+  accept();
+
+  for(int sock = 0; sock < MAX_SOCK_NUM; sock++){
+    EthernetClient client(sock);
+    if(EthernetClass::_server_port[sock] == _port){
+      uint8_t s = client.status();
+      if(s == SnSR::ESTABLISHED || s == SnSR::CLOSE_WAIT){
+        if(client.available()){
+          return client;
+        }
+      }
+    }
+  }
+
+  return EthernetClient(MAX_SOCK_NUM);
+}
+
+size_t EthernetServer::write(uint8_t b)
+{
+  return write(&b, 1);
+}
+
+//  the same bytes to every connected client
+size_t EthernetServer::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+
+  accept();
+
+  for(int sock = 0; sock < MAX_SOCK_NUM; sock++){
+    EthernetClient client(sock);
+    if(EthernetClass::_server_port[sock] == _port &&
+       client.status() == SnSR::ESTABLISHED){
+      n += client.write(buffer, size);
+    }
+  }
+
+  return n;
+}
@@ -0,0 +1,13 @@
+#include "Arduino.h"
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return (putchar(c) == EOF) ? 0 : 1;
+}
+
+void HardwareSerial::flush()
+{
+  fflush(stdout);
+}
@@ -0,0 +1,29 @@
+//  what the host build adds to the board: the world outside its pins,
+//  and the calls that let a test or main() step the simulation
+
+#ifndef HostBoard_h
+#define HostBoard_h
+
+#include <stdint.h>
+
+//  drive a pin from outside, or leave it floating; an input reads
+//  the driven level, or its pull-up when floating
+void hostDrivePin(uint8_t pin, uint8_t level);
+void hostReleasePin(uint8_t pin);
+
+//  the voltage on analog input channel as a 10 bit reading
+void hostSetAnalog(uint8_t channel, int value);
+
+//  run the interrupt handlers whose events are due, provided
+//  interrupts are enabled; the core calls this between loop() passes
+//  and whenever the time is read
+void hostInterrupts();
+
+//  the pin registers as they read now
+void hostUpdatePins();
+
+//  move the clock on, e.g. past EthernetBonjour's wait for the
+//  shield to come up after reset
+void hostAdvanceTime(unsigned long ms);
+
+#endif
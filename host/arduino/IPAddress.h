@@ -0,0 +1,43 @@
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include "Printable.h"
+#include <stdint.h>
+
+//  an IPv4 address, stored in network order
+class IPAddress : public Printable {
+private:
+  union {
+    uint8_t bytes[4];
+    uint32_t dword;
+  } _address;
+
+  uint8_t *raw_address() { return _address.bytes; }
+
+public:
+  IPAddress();
+  IPAddress(uint8_t first_octet, uint8_t second_octet, uint8_t third_octet, uint8_t fourth_octet);
+  IPAddress(uint32_t address);
+  IPAddress(const uint8_t *address);
+
+  operator uint32_t() const { return _address.dword; }
+  bool operator==(const IPAddress& addr) const { return _address.dword == addr._address.dword; }
+  bool operator==(const uint8_t *addr) const;
+
+  uint8_t operator[](int index) const { return _address.bytes[index]; }
+  uint8_t& operator[](int index) { return _address.bytes[index]; }
+
+  IPAddress& operator=(const uint8_t *address);
+  IPAddress& operator=(uint32_t address);
+
+  virtual size_t printTo(Print& p) const;
+
+  friend class Client;
+  friend class EthernetClass;
+  friend class EthernetClient;
+  friend class EthernetServer;
+};
+
+const IPAddress INADDR_NONE(0, 0, 0, 0);
+
+#endif
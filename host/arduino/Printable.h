@@ -0,0 +1,14 @@
+#ifndef Printable_h
+#define Printable_h
+
+#include <stdlib.h>
+
+class Print;
+
+//  an object that knows how to print itself
+class Printable {
+public:
+  virtual size_t printTo(Print& p) const = 0;
+};
+
+#endif
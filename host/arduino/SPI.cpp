@@ -0,0 +1,67 @@
+#include "SPI.h"
+#include "W5100Sim.h"
+
+SPIClass SPI;
+
+static uint32_t spiBytes;
+
+void SPIClass::begin()
+{
+  //  SS as an output, high, keeps the AVR the bus master
+  DDRB |= _BV(2) | _BV(3) | _BV(5);
+  PORTB |= _BV(2);
+  SPCR = 0x50;
+}
+
+void SPIClass::end()
+{
+  SPCR &= ~0x40;
+}
+
+//  a transaction ends with SS high, so the W5100 starts the next
+//  one on a new frame whatever was left of the last
+void SPIClass::beginTransaction(SPISettings settings)
+{
+  W5100Chip.deselect();
+}
+
+void SPIClass::endTransaction()
+{
+  W5100Chip.deselect();
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+  spiBytes++;
+
+  //  the W5100 only listens while its select, PB2, is driven low
+  if((DDRB & _BV(2)) && !(PORTB & _BV(2))){
+    return W5100Chip.transfer(data);
+  }
+  return 0xFF;
+}
+
+uint16_t SPIClass::transfer16(uint16_t data)
+{
+  uint16_t high = transfer(data >> 8);
+  return (high << 8) | transfer(data & 0xFF);
+}
+
+void SPIClass::transfer(void *buf, size_t count)
+{
+  uint8_t *p = (uint8_t *)buf;
+  while(count--){
+    *p = transfer(*p);
+    p++;
+  }
+}
+
+uint32_t SPIClass::transferred()
+{
+  return spiBytes;
+}
+
+void SPIClass::resetTransferred()
+{
+  spiBytes = 0;
+}
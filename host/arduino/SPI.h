@@ -0,0 +1,57 @@
+//  the SPI bus of the host build; the only device on it is the
+//  W5100 of the Ethernet shield, selected by pin 10 (PB2)
+
+#ifndef _SPI_H_INCLUDED
+#define _SPI_H_INCLUDED
+
+#include "Arduino.h"
+
+#define SPI_HAS_TRANSACTION 1
+
+#define SPI_CLOCK_DIV4 0x00
+#define SPI_CLOCK_DIV16 0x01
+#define SPI_CLOCK_DIV64 0x02
+#define SPI_CLOCK_DIV128 0x03
+#define SPI_CLOCK_DIV2 0x04
+#define SPI_CLOCK_DIV8 0x05
+#define SPI_CLOCK_DIV32 0x06
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+public:
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+    : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+  SPISettings() : clock(4000000), bitOrder(MSBFIRST), dataMode(SPI_MODE0) {}
+private:
+  uint32_t clock;
+  uint8_t bitOrder;
+  uint8_t dataMode;
+  friend class SPIClass;
+};
+
+class SPIClass {
+public:
+  static void begin();
+  static void end();
+  static void beginTransaction(SPISettings settings);
+  static void endTransaction();
+  static uint8_t transfer(uint8_t data);
+  static uint16_t transfer16(uint16_t data);
+  static void transfer(void *buf, size_t count);
+  static void setBitOrder(uint8_t bitOrder) {}
+  static void setDataMode(uint8_t dataMode) {}
+  static void setClockDivider(uint8_t clockDiv) {}
+  static void usingInterrupt(uint8_t interruptNumber) {}
+
+  //  bytes clocked since the last reset, selected or not
+  static uint32_t transferred();
+  static void resetTransferred();
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef Stream_h
+#define Stream_h
+
+#include "Print.h"
+
+//  a source of bytes that can also be printed to
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+};
+
+#endif
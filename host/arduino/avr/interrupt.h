@@ -0,0 +1,21 @@
+//  interrupts of the host build: the global enable is the I bit of
+//  the simulated SREG, so cli(), sei() and restoring a saved SREG work
+//  as on the chip. Pending handlers run from hostInterrupts(), which
+//  the core calls between loop() passes and whenever the time is read,
+//  and only while the bit is set.
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#include "io.h"
+
+#define cli() (SREG &= (uint8_t)~_BV(SREG_I))
+#define sei() (SREG |= _BV(SREG_I))
+
+#ifdef __cplusplus
+#define ISR(vector, ...) extern "C" void vector(void)
+#else
+#define ISR(vector, ...) void vector(void)
+#endif
+
+#endif
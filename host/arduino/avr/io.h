@@ -0,0 +1,177 @@
+//  the ATmega328P I/O registers of the host build: each name refers to
+//  a byte of hostIO[] at the register's data space address, so code
+//  taking a register's address, reading it back or testing whether it
+//  is defined behaves as on the chip. Only the peripherals the sketch
+//  and the core stand-in use are given names.
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+#define __AVR_ATmega328P__
+
+#define RAMSTART 0x100
+#define RAMEND 0x8FF
+#define E2END 0x3FF
+#define FLASHEND 0x7FFF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern volatile uint8_t hostIO[0x100];
+#ifdef __cplusplus
+}
+#endif
+
+#define _SFR_MEM8(addr) (*(volatile uint8_t *)&hostIO[addr])
+#define _SFR_MEM16(addr) (*(volatile uint16_t *)&hostIO[addr])
+#define _BV(bit) (1 << (bit))
+
+#define PINB _SFR_MEM8(0x23)
+#define DDRB _SFR_MEM8(0x24)
+#define PORTB _SFR_MEM8(0x25)
+#define PINC _SFR_MEM8(0x26)
+#define DDRC _SFR_MEM8(0x27)
+#define PORTC _SFR_MEM8(0x28)
+#define PIND _SFR_MEM8(0x29)
+#define DDRD _SFR_MEM8(0x2A)
+#define PORTD _SFR_MEM8(0x2B)
+
+#define TIFR0 _SFR_MEM8(0x35)
+#define TIFR1 _SFR_MEM8(0x36)
+#define TIFR2 _SFR_MEM8(0x37)
+#define EIFR _SFR_MEM8(0x3C)
+#define EIMSK _SFR_MEM8(0x3D)
+
+#define TCCR0A _SFR_MEM8(0x44)
+#define TCCR0B _SFR_MEM8(0x45)
+#define TCNT0 _SFR_MEM8(0x46)
+#define OCR0A _SFR_MEM8(0x47)
+#define OCR0B _SFR_MEM8(0x48)
+
+#define SPCR _SFR_MEM8(0x4C)
+#define SPSR _SFR_MEM8(0x4D)
+#define SPDR _SFR_MEM8(0x4E)
+
+#define SREG _SFR_MEM8(0x5F)
+
+#define EICRA _SFR_MEM8(0x69)
+#define TIMSK0 _SFR_MEM8(0x6E)
+#define TIMSK1 _SFR_MEM8(0x6F)
+#define TIMSK2 _SFR_MEM8(0x70)
+
+#define ADC _SFR_MEM16(0x78)
+#define ADCW _SFR_MEM16(0x78)
+#define ADCL _SFR_MEM8(0x78)
+#define ADCH _SFR_MEM8(0x79)
+#define ADCSRA _SFR_MEM8(0x7A)
+#define ADCSRB _SFR_MEM8(0x7B)
+#define ADMUX _SFR_MEM8(0x7C)
+#define DIDR0 _SFR_MEM8(0x7E)
+
+#define TCCR1A _SFR_MEM8(0x80)
+#define TCCR1B _SFR_MEM8(0x81)
+#define TCCR1C _SFR_MEM8(0x82)
+#define TCNT1 _SFR_MEM16(0x84)
+#define ICR1 _SFR_MEM16(0x86)
+#define OCR1A _SFR_MEM16(0x88)
+#define OCR1B _SFR_MEM16(0x8A)
+
+#define TCCR2A _SFR_MEM8(0xB0)
+#define TCCR2B _SFR_MEM8(0xB1)
+#define TCNT2 _SFR_MEM8(0xB2)
+#define OCR2A _SFR_MEM8(0xB3)
+#define OCR2B _SFR_MEM8(0xB4)
+#define ASSR _SFR_MEM8(0xB6)
+
+//  SREG
+#define SREG_I 7
+
+//  EIMSK, EIFR
+#define INT1 1
+#define INT0 0
+#define INTF1 1
+#define INTF0 0
+
+//  TIMSK0..2, TIFR0..2
+#define ICIE1 5
+#define OCIE2B 2
+#define OCIE2A 1
+#define TOIE2 0
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1 0
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0 0
+#define ICF1 5
+#define OCF2B 2
+#define OCF2A 1
+#define TOV2 0
+#define OCF1B 2
+#define OCF1A 1
+#define TOV1 0
+#define TOV0 0
+
+//  TCCR0A/B, TCCR2A/B
+#define COM0A1 7
+#define COM0B1 5
+#define WGM01 1
+#define WGM00 0
+#define CS02 2
+#define CS01 1
+#define CS00 0
+#define COM2A1 7
+#define COM2B1 5
+#define WGM22 3
+#define WGM21 1
+#define WGM20 0
+#define CS22 2
+#define CS21 1
+#define CS20 0
+
+//  TCCR1A/B
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define WGM11 1
+#define WGM10 0
+#define ICNC1 7
+#define ICES1 6
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+
+//  ADCSRA, ADMUX
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+
+//  interrupt vectors, numbered as on the chip
+#define INT0_vect __vector_1
+#define INT1_vect __vector_2
+#define TIMER2_COMPA_vect __vector_7
+#define TIMER2_COMPB_vect __vector_8
+#define TIMER2_OVF_vect __vector_9
+#define TIMER1_CAPT_vect __vector_10
+#define TIMER1_COMPA_vect __vector_11
+#define TIMER1_COMPB_vect __vector_12
+#define TIMER1_OVF_vect __vector_13
+#define TIMER0_COMPA_vect __vector_14
+#define TIMER0_COMPB_vect __vector_15
+#define TIMER0_OVF_vect __vector_16
+#define ADC_vect __vector_21
+
+#endif
@@ -0,0 +1,215 @@
+#include "socket.h"
+
+static uint16_t local_port;
+
+uint8_t socket(SOCKET s, uint8_t protocol, uint16_t port, uint8_t flag)
+{
+  if((protocol == SnMR::TCP) || (protocol == SnMR::UDP) ||
+     (protocol == SnMR::IPRAW) || (protocol == SnMR::MACRAW) ||
+     (protocol == SnMR::PPPOE)){
+    close(s);
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    W5100.writeSnMR(s, protocol | flag);
+    if(port != 0){
+      W5100.writeSnPORT(s, port);
+    } 
+    else {
+      local_port++;
+      W5100.writeSnPORT(s, local_port);
+    }
+    W5100.execCmdSn(s, Sock_OPEN);
+    SPI.endTransaction();
+    return 1;
+  }
+  return 0;
+}
+
+uint8_t socketStatus(SOCKET s)
+{
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  uint8_t status = W5100.readSnSR(s);
+  SPI.endTransaction();
+  return status;
+}
+
+void close(SOCKET s)
+{
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.execCmdSn(s, Sock_CLOSE);
+  W5100.writeSnIR(s, 0xFF);
+  SPI.endTransaction();
+}
+
+uint8_t listen(SOCKET s)
+{
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  if(W5100.readSnSR(s) != SnSR::INIT){
+    SPI.endTransaction();
+    return 0;
+  }
+  W5100.execCmdSn(s, Sock_LISTEN);
+  SPI.endTransaction();
+  return 1;
+}
+
+uint8_t connect(SOCKET s, uint8_t *addr, uint16_t port)
+{
+  if(((addr[0] == 0xFF) && (addr[1] == 0xFF) && (addr[2] == 0xFF) && (addr[3] == 0xFF)) ||
+     ((addr[0] == 0x00) && (addr[1] == 0x00) && (addr[2] == 0x00) && (addr[3] == 0x00)) ||
+     (port == 0x00)){
+    return 0;
+  }
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.writeSnDIPR(s, addr);
+  W5100.writeSnDPORT(s, port);
+  W5100.execCmdSn(s, Sock_CONNECT);
+  SPI.endTransaction();
+  return 1;
+}
+
+void disconnect(SOCKET s)
+{
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.execCmdSn(s, Sock_DISCON);
+  SPI.endTransaction();
+}
+
+//  waits for room in the TX buffer and then for the chip to have
+//  sent the data; returns the number of bytes sent, 0 when the
+//  connection went away
+uint16_t send(SOCKET s, const uint8_t *buf, uint16_t len)
+{
+  uint8_t status = 0;
+  uint16_t ret = 0;
+  uint16_t freesize = 0;
+
+  ret = (len > W5100.SSIZE) ? W5100.SSIZE : len;
+
+  do {
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    freesize = W5100.getTXFreeSize(s);
+    status = W5100.readSnSR(s);
+    SPI.endTransaction();
+    if((status != SnSR::ESTABLISHED) && (status != SnSR::CLOSE_WAIT)){
+      ret = 0;
+      break;
+    }
+    yield();
+  } while(freesize < ret);
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.send_data_processing(s, (uint8_t *)buf, ret);
+  W5100.execCmdSn(s, Sock_SEND);
+
+  while((W5100.readSnIR(s) & SnIR::SEND_OK) != SnIR::SEND_OK){
+    if(W5100.readSnSR(s) == SnSR::CLOSED){
+      SPI.endTransaction();
+      close(s);
+      return 0;
+    }
+    SPI.endTransaction();
+    yield();
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  }
+  W5100.writeSnIR(s, SnIR::SEND_OK);
+  SPI.endTransaction();
+  return ret;
+}
+
+//  returns the number of bytes read, 0 on a closed connection and
+//  -1 when nothing has arrived yet
+int16_t recv(SOCKET s, uint8_t *buf, int16_t len)
+{
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  int16_t ret = W5100.getRXReceivedSize(s);
+  if(ret == 0){
+    uint8_t status = W5100.readSnSR(s);
+    if(status == SnSR::LISTEN || status == SnSR::CLOSED ||
+       status == SnSR::CLOSE_WAIT){
+      ret = 0;
+    } 
+    else {
+      ret = -1;
+    }
+  } 
+  else if(ret > len){
+    ret = len;
+  }
+
+  if(ret > 0){
+    W5100.recv_data_processing(s, buf, ret);
+    W5100.execCmdSn(s, Sock_RECV);
+  }
+  SPI.endTransaction();
+  return ret;
+}
+
+uint16_t peek(SOCKET s, uint8_t *buf)
+{
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.recv_data_processing(s, buf, 1, 1);
+  SPI.endTransaction();
+  return 1;
+}
+
+uint16_t sendto(SOCKET s, const uint8_t *buf, uint16_t len, uint8_t *addr, uint16_t port)
+{
+  uint16_t ret = (len > W5100.SSIZE) ? W5100.SSIZE : len;
+
+  if(((addr[0] == 0x00) && (addr[1] == 0x00) && (addr[2] == 0x00) && (addr[3] == 0x00)) ||
+     (port == 0x00) || (ret == 0)){
+    return 0;
+  }
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  W5100.writeSnDIPR(s, addr);
+  W5100.writeSnDPORT(s, port);
+  W5100.send_data_processing(s, (uint8_t *)buf, ret);
+  W5100.execCmdSn(s, Sock_SEND);
+
+  while((W5100.readSnIR(s) & SnIR::SEND_OK) != SnIR::SEND_OK){
+    if(W5100.readSnIR(s) & SnIR::TIMEOUT){
+      W5100.writeSnIR(s, (SnIR::SEND_OK | SnIR::TIMEOUT));
+      SPI.endTransaction();
+      return 0;
+    }
+    SPI.endTransaction();
+    yield();
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  }
+  W5100.writeSnIR(s, SnIR::SEND_OK);
+  SPI.endTransaction();
+  return ret;
+}
+
+//  one datagram from a UDP socket: its sender and up to len bytes
+//  of it; returns the length of the datagram
+uint16_t recvfrom(SOCKET s, uint8_t *buf, uint16_t len, uint8_t *addr, uint16_t *port)
+{
+  uint8_t head[8];
+  uint16_t data_len = 0;
+  uint16_t ptr = 0;
+
+  if(len == 0){
+    return 0;
+  }
+
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  ptr = W5100.readSnRX_RD(s);
+  W5100.read_data(s, (uint8_t *)(uintptr_t)ptr, head, 0x08);
+  ptr += 8;
+  addr[0] = head[0];
+  addr[1] = head[1];
+  addr[2] = head[2];
+  addr[3] = head[3];
+  *port = (head[4] << 8) | head[5];
+  data_len = (head[6] << 8) | head[7];
+
+  W5100.read_data(s, (uint8_t *)(uintptr_t)ptr, buf, (data_len < len) ? data_len : len);
+  ptr += data_len;
+  W5100.writeSnRX_RD(s, ptr);
+  W5100.execCmdSn(s, Sock_RECV);
+  SPI.endTransaction();
+  return data_len;
+}
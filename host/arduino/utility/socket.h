@@ -0,0 +1,23 @@
+//  the socket API of the Arduino Ethernet library over the W5100
+//  driver, with the SPI transactions the IDE 1.6 library takes
+
+#ifndef _SOCKET_H_
+#define _SOCKET_H_
+
+#include "w5100.h"
+
+//  open socket s in mode protocol on port, 0 for the next free
+//  local port; returns 1 on success
+extern uint8_t socket(SOCKET s, uint8_t protocol, uint16_t port, uint8_t flag);
+extern uint8_t socketStatus(SOCKET s);
+extern void close(SOCKET s);
+extern uint8_t connect(SOCKET s, uint8_t *addr, uint16_t port);
+extern void disconnect(SOCKET s);
+extern uint8_t listen(SOCKET s);
+extern uint16_t send(SOCKET s, const uint8_t *buf, uint16_t len);
+extern int16_t recv(SOCKET s, uint8_t *buf, int16_t len);
+extern uint16_t peek(SOCKET s, uint8_t *buf);
+extern uint16_t sendto(SOCKET s, const uint8_t *buf, uint16_t len, uint8_t *addr, uint16_t port);
+extern uint16_t recvfrom(SOCKET s, uint8_t *buf, uint16_t len, uint8_t *addr, uint16_t *port);
+
+#endif
@@ -0,0 +1,262 @@
+//  the W5100 driver of the Arduino Ethernet library as the host build
+//  has it: the same registers and accessors, each access one 4 byte
+//  SPI frame to the chip, so it talks to the simulated W5100 exactly
+//  as the real library talks to the real one
+
+#ifndef W5100_H_INCLUDED
+#define W5100_H_INCLUDED
+
+#include <SPI.h>
+
+#define MAX_SOCK_NUM 4
+
+#define SPI_ETHERNET_SETTINGS SPISettings(4000000, MSBFIRST, SPI_MODE0)
+
+typedef uint8_t SOCKET;
+
+class MR {
+public:
+  static const uint8_t RST = 0x80;
+  static const uint8_t PPPOE = 0x08;
+  static const uint8_t LB = 0x04;
+  static const uint8_t AI = 0x02;
+  static const uint8_t IND = 0x01;
+};
+
+class SnMR {
+public:
+  static const uint8_t CLOSE = 0x00;
+  static const uint8_t TCP = 0x01;
+  static const uint8_t UDP = 0x02;
+  static const uint8_t IPRAW = 0x03;
+  static const uint8_t MACRAW = 0x04;
+  static const uint8_t PPPOE = 0x05;
+  static const uint8_t ND = 0x20;
+  static const uint8_t MULTI = 0x80;
+};
+
+enum SockCMD {
+  Sock_OPEN = 0x01,
+  Sock_LISTEN = 0x02,
+  Sock_CONNECT = 0x04,
+  Sock_DISCON = 0x08,
+  Sock_CLOSE = 0x10,
+  Sock_SEND = 0x20,
+  Sock_SEND_MAC = 0x21,
+  Sock_SEND_KEEP = 0x22,
+  Sock_RECV = 0x40
+};
+
+class SnIR {
+public:
+  static const uint8_t SEND_OK = 0x10;
+  static const uint8_t TIMEOUT = 0x08;
+  static const uint8_t RECV = 0x04;
+  static const uint8_t DISCON = 0x02;
+  static const uint8_t CON = 0x01;
+};
+
+class SnSR {
+public:
+  static const uint8_t CLOSED = 0x00;
+  static const uint8_t INIT = 0x13;
+  static const uint8_t LISTEN = 0x14;
+  static const uint8_t SYNSENT = 0x15;
+  static const uint8_t SYNRECV = 0x16;
+  static const uint8_t ESTABLISHED = 0x17;
+  static const uint8_t FIN_WAIT = 0x18;
+  static const uint8_t CLOSING = 0x1A;
+  static const uint8_t TIME_WAIT = 0x1B;
+  static const uint8_t CLOSE_WAIT = 0x1C;
+  static const uint8_t LAST_ACK = 0x1D;
+  static const uint8_t UDP = 0x22;
+  static const uint8_t IPRAW = 0x32;
+  static const uint8_t MACRAW = 0x42;
+  static const uint8_t PPPOE = 0x5F;
+};
+
+class W5100Class {
+
+public:
+  void init();
+
+  //  copy len bytes from the RX buffer of socket s at offset src
+  //  (wrapped to the buffer) to dst
+  void read_data(SOCKET s, volatile uint8_t *src, volatile uint8_t *dst, uint16_t len);
+
+  //  copy data into the TX buffer at the write pointer and advance it
+  void send_data_processing(SOCKET s, const uint8_t *data, uint16_t len);
+  void send_data_processing_offset(SOCKET s, uint16_t data_offset, const uint8_t *data, uint16_t len);
+
+  //  copy received data out of the RX buffer, and unless peek is set
+  //  move the read pointer past it
+  void recv_data_processing(SOCKET s, uint8_t *data, uint16_t len, uint8_t peek = 0);
+
+  inline void setGatewayIp(uint8_t *_addr) { writeGAR(_addr); }
+  inline void getGatewayIp(uint8_t *_addr) { readGAR(_addr); }
+  inline void setSubnetMask(uint8_t *_addr) { writeSUBR(_addr); }
+  inline void getSubnetMask(uint8_t *_addr) { readSUBR(_addr); }
+  inline void setMACAddress(uint8_t *_addr) { writeSHAR(_addr); }
+  inline void getMACAddress(uint8_t *_addr) { readSHAR(_addr); }
+  inline void setIPAddress(uint8_t *_addr) { writeSIPR(_addr); }
+  inline void getIPAddress(uint8_t *_addr) { readSIPR(_addr); }
+  inline void setRetransmissionTime(uint16_t _timeout) { writeRTR(_timeout); }
+  inline void setRetransmissionCount(uint8_t _retry) { writeRCR(_retry); }
+
+  void execCmdSn(SOCKET s, SockCMD _cmd);
+
+  uint16_t getTXFreeSize(SOCKET s);
+  uint16_t getRXReceivedSize(SOCKET s);
+
+  //  W5100 registers
+private:
+  static uint8_t write(uint16_t _addr, uint8_t _data);
+  static uint16_t write(uint16_t addr, const uint8_t *buf, uint16_t len);
+  static uint8_t read(uint16_t addr);
+  static uint16_t read(uint16_t addr, uint8_t *buf, uint16_t len);
+
+#define __GP_REGISTER8(name, address) \
+  static inline void write##name(uint8_t _data) { \
+    write(address, _data); \
+  } \
+  static inline uint8_t read##name() { \
+    return read(address); \
+  }
+#define __GP_REGISTER16(name, address) \
+  static void write##name(uint16_t _data) { \
+    write(address, _data >> 8); \
+    write(address + 1, _data & 0xFF); \
+  } \
+  static uint16_t read##name() { \
+    uint16_t res = read(address); \
+    res = (res << 8) + read(address + 1); \
+    return res; \
+  }
+#define __GP_REGISTER_N(name, address, size) \
+  static uint16_t write##name(uint8_t *_buff) { \
+    return write(address, _buff, size); \
+  } \
+  static uint16_t read##name(uint8_t *_buff) { \
+    return read(address, _buff, size); \
+  }
+
+public:
+  __GP_REGISTER8 (MR, 0x0000);
+  __GP_REGISTER_N(GAR, 0x0001, 4);
+  __GP_REGISTER_N(SUBR, 0x0005, 4);
+  __GP_REGISTER_N(SHAR, 0x0009, 6);
+  __GP_REGISTER_N(SIPR, 0x000F, 4);
+  __GP_REGISTER8 (IR, 0x0015);
+  __GP_REGISTER8 (IMR, 0x0016);
+  __GP_REGISTER16(RTR, 0x0017);
+  __GP_REGISTER8 (RCR, 0x0019);
+  __GP_REGISTER8 (RMSR, 0x001A);
+  __GP_REGISTER8 (TMSR, 0x001B);
+
+#undef __GP_REGISTER8
+#undef __GP_REGISTER16
+#undef __GP_REGISTER_N
+
+  //  W5100 socket registers
+private:
+  static inline uint8_t readSn(SOCKET _s, uint16_t _addr);
+  static inline uint8_t writeSn(SOCKET _s, uint16_t _addr, uint8_t _data);
+  static inline uint16_t readSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t len);
+  static inline uint16_t writeSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t len);
+
+  static const uint16_t CH_BASE = 0x0400;
+  static const uint16_t CH_SIZE = 0x0100;
+
+#define __SOCKET_REGISTER8(name, address) \
+  static inline void write##name(SOCKET _s, uint8_t _data) { \
+    writeSn(_s, address, _data); \
+  } \
+  static inline uint8_t read##name(SOCKET _s) { \
+    return readSn(_s, address); \
+  }
+#define __SOCKET_REGISTER16(name, address) \
+  static void write##name(SOCKET _s, uint16_t _data) { \
+    writeSn(_s, address, _data >> 8); \
+    writeSn(_s, address + 1, _data & 0xFF); \
+  } \
+  static uint16_t read##name(SOCKET _s) { \
+    uint16_t res = readSn(_s, address); \
+    res = (res << 8) + readSn(_s, address + 1); \
+    return res; \
+  }
+#define __SOCKET_REGISTER_N(name, address, size) \
+  static uint16_t write##name(SOCKET _s, uint8_t *_buff) { \
+    return writeSn(_s, address, _buff, size); \
+  } \
+  static uint16_t read##name(SOCKET _s, uint8_t *_buff) { \
+    return readSn(_s, address, _buff, size); \
+  }
+
+public:
+  __SOCKET_REGISTER8(SnMR, 0x0000)
+  __SOCKET_REGISTER8(SnCR, 0x0001)
+  __SOCKET_REGISTER8(SnIR, 0x0002)
+  __SOCKET_REGISTER8(SnSR, 0x0003)
+  __SOCKET_REGISTER16(SnPORT, 0x0004)
+  __SOCKET_REGISTER_N(SnDHAR, 0x0006, 6)
+  __SOCKET_REGISTER_N(SnDIPR, 0x000C, 4)
+  __SOCKET_REGISTER16(SnDPORT, 0x0010)
+  __SOCKET_REGISTER16(SnMSSR, 0x0012)
+  __SOCKET_REGISTER8(SnPROTO, 0x0014)
+  __SOCKET_REGISTER8(SnTOS, 0x0015)
+  __SOCKET_REGISTER8(SnTTL, 0x0016)
+  __SOCKET_REGISTER16(SnTX_FSR, 0x0020)
+  __SOCKET_REGISTER16(SnTX_RD, 0x0022)
+  __SOCKET_REGISTER16(SnTX_WR, 0x0024)
+  __SOCKET_REGISTER16(SnRX_RSR, 0x0026)
+  __SOCKET_REGISTER16(SnRX_RD, 0x0028)
+  __SOCKET_REGISTER16(SnRX_WR, 0x002A)
+
+#undef __SOCKET_REGISTER8
+#undef __SOCKET_REGISTER16
+#undef __SOCKET_REGISTER_N
+
+private:
+  static const uint8_t RST = 7;
+  static const uint16_t TXBUF_BASE = 0x4000;
+  static const uint16_t RXBUF_BASE = 0x6000;
+
+public:
+  static const int SOCKETS = 4;
+  static const uint16_t SMASK = 0x07FF;
+  static const uint16_t RMASK = 0x07FF;
+  static const uint16_t SSIZE = 2048;
+  static const uint16_t RSIZE = 2048;
+
+private:
+  uint16_t SBASE[SOCKETS];
+  uint16_t RBASE[SOCKETS];
+
+  inline static void initSS() { DDRB |= _BV(2); }
+  inline static void setSS() { PORTB &= ~_BV(2); }
+  inline static void resetSS() { PORTB |= _BV(2); }
+};
+
+extern W5100Class W5100;
+
+uint8_t W5100Class::readSn(SOCKET _s, uint16_t _addr)
+{
+  return read(CH_BASE + _s * CH_SIZE + _addr);
+}
+
+uint8_t W5100Class::writeSn(SOCKET _s, uint16_t _addr, uint8_t _data)
+{
+  return write(CH_BASE + _s * CH_SIZE + _addr, _data);
+}
+
+uint16_t W5100Class::readSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t _len)
+{
+  return read(CH_BASE + _s * CH_SIZE + _addr, _buf, _len);
+}
+
+uint16_t W5100Class::writeSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t _len)
+{
+  return write(CH_BASE + _s * CH_SIZE + _addr, _buf, _len);
+}
+
+#endif
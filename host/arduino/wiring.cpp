@@ -0,0 +1,335 @@
+//  time and interrupts of the host build. The clock is the host's
+//  monotonic clock; the peripherals that raise interrupts (the ADC,
+//  Timer1's overflow and input capture, Timer2's compare match A and
+//  the external interrupts) are advanced to the current time whenever
+//  hostInterrupts() runs, and every event that fell due since is
+//  handled in order.
+
+#include <time.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "HostBoard.h"
+
+volatile uint8_t hostIO[0x100];
+
+//  handlers the sketch may or may not define
+extern "C" {
+void INT0_vect(void) __attribute__((weak));
+void INT1_vect(void) __attribute__((weak));
+void TIMER1_CAPT_vect(void) __attribute__((weak));
+void TIMER1_OVF_vect(void) __attribute__((weak));
+void TIMER2_COMPA_vect(void) __attribute__((weak));
+void ADC_vect(void) __attribute__((weak));
+}
+
+//  one conversion is 13 ADC clocks at the prescaler of 128
+#define ADC_CONVERSION_NS (13LL * 128 * 1000000000LL / F_CPU)
+
+//  events handled by one hostInterrupts() at most; a backlog longer
+//  than that (the host was busy elsewhere) is dropped, as a real
+//  board would have overrun it too
+#define MAX_EVENTS 10000
+
+static struct timespec startTime;
+static int64_t skipped = 0;
+
+static int64_t adcStart = -1;
+static int64_t timer1Start = -1;
+static int64_t timer1Ticks = 0;
+static uint8_t timer1Flags = 0;
+static int64_t timer2Last = -1;
+
+static void (*intFunc[2])(void);
+
+//  nanoseconds since init()
+static int64_t hostNanos()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)(now.tv_sec - startTime.tv_sec) * 1000000000LL +
+    (now.tv_nsec - startTime.tv_nsec) + skipped;
+}
+
+//  timers and the ADC catch up with the skipped time as far as
+//  they would after the host had been busy for that long
+void hostAdvanceTime(unsigned long ms)
+{
+  skipped += (int64_t)ms * 1000000;
+  hostInterrupts();
+}
+
+//  enter a handler as the chip does, with interrupts off until
+//  it returns
+static void runVector(void (*vector)(void))
+{
+  SREG &= ~_BV(SREG_I);
+  if(vector != NULL){
+    vector();
+  }
+  SREG |= _BV(SREG_I);
+}
+
+int hostADCReading();
+
+static void advanceADC(int64_t now)
+{
+  int events = 0;
+
+  if(!(ADCSRA & _BV(ADEN)) || !(ADCSRA & _BV(ADSC))){
+    adcStart = -1;
+    return;
+  }
+  if(adcStart < 0){
+    adcStart = now;
+  }
+
+  //  each finished conversion whose handler starts the next one
+  //  carries on from where the last one ended
+  while((ADCSRA & _BV(ADSC)) && now - adcStart >= ADC_CONVERSION_NS){
+    ADC = hostADCReading();
+    ADCSRA = (ADCSRA & ~_BV(ADSC)) | _BV(ADIF);
+    adcStart += ADC_CONVERSION_NS;
+    if(ADCSRA & _BV(ADIE)){
+      ADCSRA &= ~_BV(ADIF);
+      runVector(ADC_vect);
+    }
+    if(++events == MAX_EVENTS){
+      adcStart = now;
+      break;
+    }
+  }
+  if(!(ADCSRA & _BV(ADSC))){
+    adcStart = -1;
+  }
+}
+
+//  Timer1 counting from the time it was started, so the ticks don't
+//  drift; only normal mode is simulated. The sketch clears TIFR1's
+//  flags by writing ones to them, which memory can't do, so the flags
+//  are kept here and TIFR1 shows them
+static void advanceTimer1(int64_t now)
+{
+  static const int prescalers[] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+  int prescaler = prescalers[TCCR1B & 0x07];
+
+  if(prescaler == 0 || (TCCR1A & 0x03) != 0 || (TCCR1B & (_BV(WGM13) | _BV(WGM12))) != 0){
+    timer1Start = -1;
+    timer1Flags = 0;
+    return;
+  }
+  if(timer1Start < 0){
+    timer1Start = now;
+    timer1Ticks = 0;
+  }
+
+  int64_t ticks = (now - timer1Start) * (F_CPU / 1000000) / 1000 / prescaler;
+  int64_t count = TCNT1 + (ticks - timer1Ticks);
+  timer1Ticks = ticks;
+  while(count > 0xFFFF){
+    count -= 0x10000;
+    if((TIMSK1 & _BV(TOIE1)) && (SREG & _BV(SREG_I))){
+      TCNT1 = 0;
+      TIFR1 = timer1Flags;
+      runVector(TIMER1_OVF_vect);
+    }
+    else {
+      timer1Flags |= _BV(TOV1);
+    }
+  }
+  TCNT1 = count;
+  TIFR1 = timer1Flags;
+}
+
+//  an edge on the input capture pin, as ICES1 selects, latches
+//  Timer1 in ICR1
+void hostCaptureEdge(boolean rising)
+{
+  if(timer1Start < 0 || rising != ((TCCR1B & _BV(ICES1)) != 0)){
+    return;
+  }
+  advanceTimer1(hostNanos());
+  ICR1 = TCNT1;
+  timer1Flags |= _BV(ICF1);
+  TIFR1 = timer1Flags;
+}
+
+static void advanceTimer2(int64_t now)
+{
+  static const int prescalers[] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+  int prescaler = prescalers[TCCR2B & 0x07];
+  int events = 0;
+
+  //  only CTC mode with the compare match interrupt is simulated
+  if(!(TIMSK2 & _BV(OCIE2A)) || prescaler == 0 ||
+     (TCCR2A & 0x03) != _BV(WGM21)){
+    timer2Last = -1;
+    return;
+  }
+  if(timer2Last < 0){
+    timer2Last = now;
+  }
+
+  for(;;){
+    int64_t period = (int64_t)(OCR2A + 1) * prescaler * 1000000000LL / F_CPU;
+    if(now - timer2Last < period || !(TIMSK2 & _BV(OCIE2A))){
+      break;
+    }
+    timer2Last += period;
+    hostUpdatePins();
+    runVector(TIMER2_COMPA_vect);
+    if(++events == MAX_EVENTS){
+      timer2Last = now;
+      break;
+    }
+  }
+}
+
+void hostInterrupts()
+{
+  if(!(SREG & _BV(SREG_I))){
+    return;
+  }
+
+  int64_t now = hostNanos();
+  advanceADC(now);
+
+  //  an overflow that came while interrupts were off goes first
+  if((timer1Flags & TIMSK1) & _BV(TOV1)){
+    timer1Flags &= ~_BV(TOV1);
+    TIFR1 = timer1Flags;
+    runVector(TIMER1_OVF_vect);
+  }
+  advanceTimer1(now);
+  advanceTimer2(now);
+
+  //  the sketch's own handler, or the core's that calls the
+  //  function given to attachInterrupt()
+  if((EIFR & EIMSK) & _BV(INTF0)){
+    EIFR &= ~_BV(INTF0);
+    runVector((INT0_vect != NULL) ? INT0_vect : intFunc[0]);
+  }
+  if((EIFR & EIMSK) & _BV(INTF1)){
+    EIFR &= ~_BV(INTF1);
+    runVector((INT1_vect != NULL) ? INT1_vect : intFunc[1]);
+  }
+  if((timer1Flags & TIMSK1) & _BV(ICF1)){
+    timer1Flags &= ~_BV(ICF1);
+    TIFR1 = timer1Flags;
+    runVector(TIMER1_CAPT_vect);
+  }
+}
+
+void init()
+{
+  clock_gettime(CLOCK_MONOTONIC, &startTime);
+  skipped = 0;
+  memset((void *)hostIO, 0, sizeof(hostIO));
+
+  sei();
+
+  //  the core's timer and ADC setup: Timer0 keeps time, Timers 1
+  //  and 2 run 8-bit phase correct PWM and the ADC runs at 125 kHz
+  TCCR0A = _BV(WGM01) | _BV(WGM00);
+  TCCR0B = _BV(CS01) | _BV(CS00);
+  TIMSK0 = _BV(TOIE0);
+  TCCR1B = _BV(CS11) | _BV(CS10);
+  TCCR1A = _BV(WGM10);
+  TCCR2B = _BV(CS22);
+  TCCR2A = _BV(WGM20);
+  ADCSRA = _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) | _BV(ADEN);
+
+  hostUpdatePins();
+}
+
+//  a busy wait lets interrupts in, as it would on the chip
+void yield()
+{
+  hostInterrupts();
+}
+
+unsigned long micros()
+{
+  hostInterrupts();
+  return (unsigned long)(hostNanos() / 1000);
+}
+
+unsigned long millis()
+{
+  hostInterrupts();
+  return (unsigned long)(hostNanos() / 1000000);
+}
+
+void delay(unsigned long ms)
+{
+  int64_t end = hostNanos() + (int64_t)ms * 1000000;
+  while(hostNanos() < end){
+    hostInterrupts();
+    usleep(100);
+  }
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  int64_t end = hostNanos() + (int64_t)us * 1000;
+  while(hostNanos() < end){
+    hostInterrupts();
+  }
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+{
+  if(interruptNum >= 2){
+    return;
+  }
+  intFunc[interruptNum] = userFunc;
+  EICRA = (EICRA & ~(0x03 << (2 * interruptNum))) | (mode << (2 * interruptNum));
+  EIMSK |= _BV(interruptNum);
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+  if(interruptNum >= 2){
+    return;
+  }
+  EIMSK &= ~_BV(interruptNum);
+  intFunc[interruptNum] = NULL;
+}
+
+long random(long howbig)
+{
+  if(howbig == 0){
+    return 0;
+  }
+  return random() % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+  if(howsmall >= howbig){
+    return howsmall;
+  }
+  return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+  if(seed != 0){
+    srandom(seed);
+  }
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+uint16_t makeWord(uint16_t w)
+{
+  return w;
+}
+
+uint16_t makeWord(byte h, byte l)
+{
+  return (h << 8) | l;
+}
@@ -0,0 +1,91 @@
+//  the ADC and PWM outputs of the host build; the inputs read
+//  whatever hostSetAnalog() last put on them
+
+#include "Arduino.h"
+#include "HostBoard.h"
+
+static uint8_t analog_reference = DEFAULT;
+static int analogInputs[8];
+
+void hostSetAnalog(uint8_t channel, int value)
+{
+  if(channel < 8){
+    analogInputs[channel] = constrain(value, 0, 1023);
+  }
+}
+
+//  the result of a conversion of the channel ADMUX selects, the
+//  1.1V bandgap or ground for the two internal ones
+int hostADCReading()
+{
+  uint8_t channel = ADMUX & 0x0F;
+
+  if(channel < 8){
+    return analogInputs[channel];
+  }
+  if(channel == 0x0E){
+    return 1100L * 1024 / 5000;
+  }
+  return 0;
+}
+
+void analogReference(uint8_t mode)
+{
+  analog_reference = mode;
+}
+
+//  the conversion completes the moment it is started
+int analogRead(uint8_t pin)
+{
+  if(pin >= 14){
+    pin -= 14;
+  }
+
+  ADMUX = (analog_reference << 6) | (pin & 0x07);
+  ADCSRA |= _BV(ADSC);
+  ADC = hostADCReading();
+  ADCSRA &= ~_BV(ADSC);
+  return ADC;
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+  pinMode(pin, OUTPUT);
+  if(val == 0){
+    digitalWrite(pin, LOW);
+    return;
+  }
+  if(val == 255){
+    digitalWrite(pin, HIGH);
+    return;
+  }
+
+  switch(digitalPinToTimer(pin)){
+  case TIMER0A:
+    TCCR0A |= _BV(COM0A1);
+    OCR0A = val;
+    break;
+  case TIMER0B:
+    TCCR0A |= _BV(COM0B1);
+    OCR0B = val;
+    break;
+  case TIMER1A:
+    TCCR1A |= _BV(COM1A1);
+    OCR1A = val;
+    break;
+  case TIMER1B:
+    TCCR1A |= _BV(COM1B1);
+    OCR1B = val;
+    break;
+  case TIMER2A:
+    TCCR2A |= _BV(COM2A1);
+    OCR2A = val;
+    break;
+  case TIMER2B:
+    TCCR2A |= _BV(COM2B1);
+    OCR2B = val;
+    break;
+  default:
+    digitalWrite(pin, (val < 128) ? LOW : HIGH);
+  }
+}
@@ -0,0 +1,211 @@
+//  digital pins of the host build. A pin's level is worked out from
+//  its registers and from what drives it from outside: an output
+//  reads what it writes, an input what it is driven to, or its
+//  pull-up when floating. The PIN registers are brought up to date
+//  by every call into the core that reads or changes a pin.
+
+#include "Arduino.h"
+#include "HostBoard.h"
+
+#define _ NOT_ON_TIMER
+
+const uint8_t digital_pin_to_port_PGM[] = {
+  PD, PD, PD, PD, PD, PD, PD, PD,
+  PB, PB, PB, PB, PB, PB,
+  PC, PC, PC, PC, PC, PC,
+};
+
+const uint8_t digital_pin_to_bit_mask_PGM[] = {
+  _BV(0), _BV(1), _BV(2), _BV(3), _BV(4), _BV(5), _BV(6), _BV(7),
+  _BV(0), _BV(1), _BV(2), _BV(3), _BV(4), _BV(5),
+  _BV(0), _BV(1), _BV(2), _BV(3), _BV(4), _BV(5),
+};
+
+const uint8_t digital_pin_to_timer_PGM[] = {
+  _, _, _, TIMER2B, _, TIMER0B, TIMER0A, _,
+  _, TIMER1A, TIMER1B, TIMER2A, _, _,
+  _, _, _, _, _, _,
+};
+
+#undef _
+
+volatile uint8_t * const port_to_mode_PGM[] = {
+  NULL, NULL, &DDRB, &DDRC, &DDRD,
+};
+
+volatile uint8_t * const port_to_output_PGM[] = {
+  NULL, NULL, &PORTB, &PORTC, &PORTD,
+};
+
+volatile uint8_t * const port_to_input_PGM[] = {
+  NULL, NULL, &PINB, &PINC, &PIND,
+};
+
+//  level each pin is driven to from outside, -1 when floating
+static int8_t driven[NUM_DIGITAL_PINS] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+void hostUpdatePins()
+{
+  uint8_t inputs[PD + 1] = { 0 };
+
+  for(uint8_t pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+    uint8_t port = digitalPinToPort(pin);
+    uint8_t mask = digitalPinToBitMask(pin);
+    boolean high;
+
+    if(*portModeRegister(port) & mask){
+      high = (*portOutputRegister(port) & mask) != 0;
+    } 
+    else if(driven[pin] >= 0){
+      high = driven[pin];
+    } 
+    else {
+      high = (*portOutputRegister(port) & mask) != 0;
+    }
+    if(high){
+      inputs[port] |= mask;
+    }
+  }
+
+  PINB = inputs[PB];
+  PINC = inputs[PC];
+  PIND = inputs[PD];
+}
+
+//  flag an edge on an external interrupt pin as the sense
+//  control bits of EICRA ask for
+static void senseEdge(uint8_t pin, boolean before, boolean after)
+{
+  int interruptNum = digitalPinToInterrupt(pin);
+  if(interruptNum == NOT_AN_INTERRUPT || before == after){
+    return;
+  }
+
+  uint8_t sense = (EICRA >> (2 * interruptNum)) & 0x03;
+  if(sense == CHANGE || (sense == FALLING && !after) ||
+     (sense == RISING && after)){
+    EIFR |= _BV(interruptNum);
+  }
+}
+
+void hostCaptureEdge(boolean rising);
+
+static boolean pinLevel(uint8_t pin)
+{
+  return (*portInputRegister(digitalPinToPort(pin)) & digitalPinToBitMask(pin)) != 0;
+}
+
+static void drive(uint8_t pin, int8_t level)
+{
+  if(pin >= NUM_DIGITAL_PINS){
+    return;
+  }
+
+  hostUpdatePins();
+  boolean before = pinLevel(pin);
+  driven[pin] = level;
+  hostUpdatePins();
+  senseEdge(pin, before, pinLevel(pin));
+
+  //  Timer1's input capture pin, ICP1
+  if(pin == 8 && before != pinLevel(pin)){
+    hostCaptureEdge(pinLevel(pin));
+  }
+  hostInterrupts();
+}
+
+void hostDrivePin(uint8_t pin, uint8_t level)
+{
+  drive(pin, level ? 1 : 0);
+}
+
+void hostReleasePin(uint8_t pin)
+{
+  drive(pin, -1);
+}
+
+static void turnOffPWM(uint8_t timer)
+{
+  switch(timer){
+  case TIMER0A: TCCR0A &= ~_BV(COM0A1); break;
+  case TIMER0B: TCCR0A &= ~_BV(COM0B1); break;
+  case TIMER1A: TCCR1A &= ~_BV(COM1A1); break;
+  case TIMER1B: TCCR1A &= ~_BV(COM1B1); break;
+  case TIMER2A: TCCR2A &= ~_BV(COM2A1); break;
+  case TIMER2B: TCCR2A &= ~_BV(COM2B1); break;
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if(pin >= NUM_DIGITAL_PINS){
+    return;
+  }
+
+  uint8_t port = digitalPinToPort(pin);
+  uint8_t mask = digitalPinToBitMask(pin);
+  volatile uint8_t *reg = portModeRegister(port);
+  volatile uint8_t *out = portOutputRegister(port);
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if(mode == INPUT){
+    *reg &= ~mask;
+    *out &= ~mask;
+  } 
+  else if(mode == INPUT_PULLUP){
+    *reg &= ~mask;
+    *out |= mask;
+  } 
+  else {
+    *reg |= mask;
+  }
+  SREG = oldSREG;
+
+  hostUpdatePins();
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if(pin >= NUM_DIGITAL_PINS){
+    return;
+  }
+
+  uint8_t timer = digitalPinToTimer(pin);
+  uint8_t mask = digitalPinToBitMask(pin);
+  volatile uint8_t *out = portOutputRegister(digitalPinToPort(pin));
+
+  if(timer != NOT_ON_TIMER){
+    turnOffPWM(timer);
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if(val == LOW){
+    *out &= ~mask;
+  } 
+  else {
+    *out |= mask;
+  }
+  SREG = oldSREG;
+
+  hostUpdatePins();
+}
+
+int digitalRead(uint8_t pin)
+{
+  if(pin >= NUM_DIGITAL_PINS){
+    return LOW;
+  }
+
+  uint8_t timer = digitalPinToTimer(pin);
+  if(timer != NOT_ON_TIMER){
+    turnOffPWM(timer);
+  }
+
+  hostUpdatePins();
+  return pinLevel(pin) ? HIGH : LOW;
+}
@@ -0,0 +1,135 @@
+//  what EthernetBonjour spends on the queries of a busy LAN with 0 to
+//  8 services registered: each question is matched by length and hash
+//  against every name, so the cost should not grow with the services
+//  unless they are asked for. The packets are modelled on what Apple
+//  and Chromecast devices multicast; only the last two are for us.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <EthernetBonjour.h>
+#include <HostBoard.h>
+#include <utility/EthernetCompat.h>
+
+#include "W5100Sim.h"
+#include "../test/mdns_harness.h"
+
+#define RUNS 50
+#define PACKETS 8
+
+static const int serviceCounts[] = { 0, 1, 4, 8 };
+
+static double frames[PACKETS][4];
+static double usecs[PACKETS][4];
+
+static void measure(int packet, int column, const MDNSPacket &query)
+{
+  int64_t nanos = 0;
+  uint32_t total = 0;
+
+  for(int i = 0; i < RUNS; i++){
+    //  past the once a second limit on multicasting a record, with
+    //  the announcements due by then out of the way
+    hostAdvanceTime(1100);
+    EthernetBonjour.run();
+    if(!mdnsHarnessSend(query)){
+      return;
+    }
+
+    unsigned long start = micros();
+    EthernetBonjour.run();
+    nanos += (micros() - start) * 1000LL;
+    total += W5100Chip.frames();
+
+    //  send delayed answers now, so they don't land in the next run
+    hostAdvanceTime(200);
+    mdnsHarnessDrain(0);
+  }
+
+  frames[packet][column] = total / (double)RUNS;
+  usecs[packet][column] = nanos / 1000.0 / RUNS;
+}
+
+int main()
+{
+  static const char *apple[] = {
+    "_airplay._tcp.local", "_raop._tcp.local", "_companion-link._tcp.local",
+    "_homekit._tcp.local"
+  };
+  MDNSPacket queries[PACKETS];
+  const char *names[PACKETS];
+  int n = 0;
+
+  queries[n].compress = true;
+  for(int i = 0; i < 4; i++){
+    queries[n].question(apple[i], MDNS_TYPE_PTR, true);
+  }
+  names[n++] = "Apple browse, 4 QU PTRs";
+
+  queries[n].question("_googlecast._tcp.local", MDNS_TYPE_PTR);
+  names[n++] = "Chromecast browse";
+
+  queries[n].compress = true;
+  queries[n].question("_sleep-proxy._udp.local", MDNS_TYPE_PTR);
+  queries[n].question("_device-info._tcp.local", MDNS_TYPE_PTR);
+  names[n++] = "sleep proxy and device info";
+
+  queries[n].compress = true;
+  queries[n].question("Living-Room.local", MDNS_TYPE_A);
+  queries[n].question("Living-Room.local", MDNS_TYPE_AAAA);
+  names[n++] = "another host's A and AAAA";
+
+  queries[n].compress = true;
+  queries[n].question("_spotify-connect._tcp.local", MDNS_TYPE_PTR);
+  queries[n].question("_http._tcp.local", MDNS_TYPE_PTR);
+  names[n++] = "Spotify and HTTP browse";
+
+  queries[n].question("RESTduino._svc0._tcp.local", MDNS_TYPE_SRV);
+  names[n++] = "SRV of an instance";
+
+  queries[n].question("_services._dns-sd._udp.local", MDNS_TYPE_PTR);
+  names[n++] = "service type enumeration";
+
+  queries[n].question("restduino.local", MDNS_TYPE_A);
+  names[n++] = "our A record";
+
+  mdnsHarnessBegin("restduino");
+
+  for(int column = 0; column < 4; column++){
+    EthernetBonjour.removeAllServiceRecords();
+    for(int i = 0; i < serviceCounts[column]; i++){
+      char service[32];
+      snprintf(service, sizeof(service), "RESTduino._svc%d", i);
+      EthernetBonjour.addServiceRecord(service, 8000 + i, MDNSServiceTCP);
+    }
+    mdnsHarnessDrain(50);
+
+    for(int packet = 0; packet < n; packet++){
+      measure(packet, column, queries[packet]);
+    }
+  }
+
+  printf("%-32s %26s   %26s\n", "", "frames, by services", "us, by services");
+  printf("%-32s", "");
+  for(int pass = 0; pass < 2; pass++){
+    for(int column = 0; column < 4; column++){
+      printf(" %6d", serviceCounts[column]);
+    }
+    printf("   ");
+  }
+  printf("\n");
+  for(int packet = 0; packet < n; packet++){
+    printf("%-32s", names[packet]);
+    for(int column = 0; column < 4; column++){
+      printf(" %6.0f", frames[packet][column]);
+    }
+    printf("   ");
+    for(int column = 0; column < 4; column++){
+      printf(" %6.1f", usecs[packet][column]);
+    }
+    printf("\n");
+  }
+
+  return 0;
+}
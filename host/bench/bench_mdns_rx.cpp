@@ -0,0 +1,124 @@
+//  W5100 frames EthernetBonjour spends on each kind of packet it
+//  receives, from the RX size check to the last reply byte. Built once
+//  with the library's default MDNS_RX_BUFFER_SIZE for the Uno (0, read
+//  piece by piece) and once with -DMDNS_RX_BUFFER_SIZE=256 to compare.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetBonjour.h>
+#include <HostBoard.h>
+#include <utility/EthernetCompat.h>
+
+#include "W5100Sim.h"
+#include "../test/mdns_harness.h"
+
+#define RUNS 20
+
+static const uint8_t printerAddress[] = { 192, 168, 1, 20 };
+static const uint8_t txt[] = "\x0btxtvers=1\x0dpdl=image/urf\x10rp=printers/main\x0bqtotal=1";
+
+static void measure(const char *what, const MDNSPacket &packet)
+{
+  uint8_t reply[1500];
+  uint32_t frames = 0;
+  uint32_t counted = 0;
+  int64_t nanos = 0;
+
+  for(int i = 0; i < RUNS; i++){
+    //  past the once a second limit on multicasting a record
+    hostAdvanceTime(1100);
+    if(!mdnsHarnessSend(packet)){
+      printf("%-40s not received\n", what);
+      return;
+    }
+
+    unsigned long start = micros();
+    EthernetBonjour.run();
+    nanos += (micros() - start) * 1000LL;
+    frames += W5100Chip.frames();
+    counted += ethernet_compat_spi_transactions();
+
+    while(mdnsHarnessReceive(reply, sizeof(reply), 5) >= 0)
+      ;
+  }
+
+  printf("%-40s %4u bytes %6.1f frames%s %6.1f us\n", what, packet.length,
+    frames / (double)RUNS, (frames == counted) ? "" : " (miscounted)",
+    nanos / 1000.0 / RUNS);
+}
+
+int main()
+{
+  static const char *browsed[] = {
+    "_http._tcp.local", "_ipp._tcp.local", "_printer._tcp.local", "_smb._tcp.local"
+  };
+
+  mdnsHarnessBegin("restduino");
+#if defined(MDNS_RX_BUFFER_SIZE)
+  printf("MDNS_RX_BUFFER_SIZE %d\n", MDNS_RX_BUFFER_SIZE);
+#else
+  printf("MDNS_RX_BUFFER_SIZE default (0 on the Uno)\n");
+#endif
+
+  MDNSPacket other;
+  other.question("printer.local", MDNS_TYPE_A);
+  measure("A query for another host", other);
+
+  MDNSPacket ours;
+  ours.question("restduino.local", MDNS_TYPE_A);
+  measure("A query for us, answered", ours);
+
+  MDNSPacket known;
+  known.compress = true;
+  known.question("restduino.local", MDNS_TYPE_A);
+  IPAddress ip = Ethernet.localIP();
+  uint8_t address[4] = { ip[0], ip[1], ip[2], ip[3] };
+  known.answer("restduino.local", MDNS_TYPE_A, 120, address, 4);
+  measure("A query for us, known answer", known);
+
+  MDNSPacket browse;
+  browse.compress = true;
+  for(int i = 0; i < 4; i++){
+    browse.question(browsed[i], MDNS_TYPE_PTR);
+  }
+  measure("4 question PTR browse", browse);
+
+  MDNSPacket browseKnown = browse;
+  for(int i = 0; i < 4; i++){
+    char instance[64];
+    snprintf(instance, sizeof(instance), "Printer.%s", browsed[i]);
+    browseKnown.answerName(browsed[i], MDNS_TYPE_PTR, 4500, instance);
+  }
+  measure("browse with 4 known answers", browseKnown);
+
+  MDNSPacket txtKnown;
+  txtKnown.compress = true;
+  txtKnown.question("_ipp._tcp.local", MDNS_TYPE_PTR);
+  for(int i = 0; i < 3; i++){
+    char instance[64];
+    snprintf(instance, sizeof(instance), "Printer %d._ipp._tcp.local", i);
+    txtKnown.answer(instance, MDNS_TYPE_TXT, 4500, txt, sizeof(txt) - 1);
+  }
+  measure("query with 3 TXT known answers", txtKnown);
+
+  MDNSPacket response(0, 0x8400);
+  response.compress = true;
+  response.answerName("_ipp._tcp.local", MDNS_TYPE_PTR, 4500, "Printer._ipp._tcp.local");
+  response.answer("Printer._ipp._tcp.local", MDNS_TYPE_TXT, 4500, txt, sizeof(txt) - 1);
+  response.answer("printer.local", MDNS_TYPE_A, 120, printerAddress, 4);
+  measure("another host's response", response);
+
+  MDNSPacket many;
+  many.compress = false;
+  for(int i = 0; i < 20; i++){
+    char name[32];
+    snprintf(name, sizeof(name), "host-number-%02d.local", i);
+    many.question(name, MDNS_TYPE_A);
+  }
+  measure("20 questions, uncompressed", many);
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+//  what the sketch's request parser costs per request: the bytes a
+//  client sends and the host time (and TSC cycles, on x86) to take
+//  them a byte at a time, for the kinds of client RESTduino sees. The
+//  parser works in a fixed buffer, the AVR cost scales with the bytes.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../sketch.cpp"
+
+#define RUNS 200000
+
+static const char *requests[][2] = {
+  { "curl",
+    "GET /13/HIGH HTTP/1.1\r\nHost: 10.0.1.100\r\nUser-Agent: curl/7.88.1\r\n"
+    "Accept: */*\r\n\r\n" },
+  { "monitor.py",
+    "GET /A0 HTTP/1.1\r\nAccept-Encoding: identity\r\nHost: 10.0.1.100\r\n"
+    "User-Agent: Python-urllib/3.11\r\nConnection: close\r\n\r\n" },
+  { "BATCH of 4",
+    "GET /BATCH?2=HIGH&3=LOW&5=128&A0 HTTP/1.1\r\nHost: 10.0.1.100\r\n\r\n" },
+  { "browser",
+    "GET /13/LOW HTTP/1.1\r\nHost: 10.0.1.100\r\nConnection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like "
+    "Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Referer: http://10.0.1.100/\r\nAccept-Encoding: gzip, deflate\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n\r\n" },
+};
+
+static uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static int64_t nanos()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int main()
+{
+  static Request req;
+
+  printf("%-12s %6s %10s %10s %12s\n", "request", "bytes", "ns", "ns/byte", "TSC cycles");
+  for(unsigned r = 0; r < sizeof(requests) / sizeof(requests[0]); r++){
+    const char *text = requests[r][1];
+    int length = strlen(text);
+    volatile byte state = 0;
+
+    int64_t start = nanos();
+    uint64_t startCycles = cycles();
+    for(int i = 0; i < RUNS; i++){
+      resetRequest(&req);
+      for(int n = 0; n < length; n++){
+        state = parseRequest(&req, text[n]);
+      }
+    }
+    uint64_t spentCycles = cycles() - startCycles;
+    double ns = (nanos() - start) / (double)RUNS;
+
+    if(state != PARSE_DONE || req.error){
+      printf("%-12s did not parse\n", requests[r][0]);
+      return 1;
+    }
+    printf("%-12s %6d %10.0f %10.2f %12.0f\n", requests[r][0], length, ns, ns / length,
+      spentCycles / (double)RUNS);
+  }
+
+  return 0;
+}
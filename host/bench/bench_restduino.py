@@ -0,0 +1,88 @@
+#  requests per second the sketch serves on the host build, over one
+#  kept-alive connection, pipelined on one, and with a connection per
+#  request as every request had before keep-alive, and how long it
+#  takes to answer an mDNS query for its name
+#
+#    python3 bench/bench_restduino.py [requests] [queries]
+
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import harness
+
+
+def keep_alive(board, requests):
+    connection = board.connect()
+    start = time.time()
+    for _ in range(requests):
+        status, _, _ = connection.get('/8')
+        assert status == 200
+    elapsed = time.time() - start
+    connection.close()
+    return requests / elapsed
+
+
+#  depth requests sent in one go before any response is read
+def pipelined(board, requests, depth=8):
+    connection = board.connect()
+    start = time.time()
+    for _ in range(requests // depth):
+        for _ in range(depth):
+            connection.send('/8')
+        for _ in range(depth):
+            status, _, _ = connection.response()
+            assert status == 200
+    elapsed = time.time() - start
+    connection.close()
+    return (requests // depth) * depth / elapsed
+
+
+def per_connection(board, requests):
+    start = time.time()
+    for _ in range(requests):
+        connection = board.connect()
+        status, _, _ = connection.get('/8', close=True)
+        assert status == 200
+        connection.close()
+    return requests / (time.time() - start)
+
+
+#  a record is multicast at most once a second, so the queries are
+#  spaced out by more than that
+def mdns_latency(queries):
+    querier = harness.MDNSQuerier()
+    latencies = []
+    try:
+        for _ in range(queries):
+            time.sleep(1.1)
+            reply = querier.ask(harness.mdns_query('restduino.local'))
+            if reply is not None:
+                latencies.append(reply[0] * 1000)
+    finally:
+        querier.close()
+    return latencies
+
+
+def main():
+    requests = int(sys.argv[1]) if len(sys.argv) > 1 else 2000
+    queries = int(sys.argv[2]) if len(sys.argv) > 2 else 5
+
+    with harness.Restduino() as board:
+        print('keep-alive:      %7.0f requests/s' % keep_alive(board, requests))
+        print('pipelined by 8:  %7.0f requests/s' % pipelined(board, requests))
+        print('per connection:  %7.0f requests/s' % per_connection(board, requests // 10))
+
+        if queries == 0:
+            return
+        latencies = mdns_latency(queries)
+        if latencies:
+            print('mDNS A query:    %7.2f ms p50, %.2f ms max, %d/%d answered' % (
+                harness.percentile(latencies, 50), max(latencies), len(latencies), queries))
+        else:
+            print('mDNS A query:    no answers')
+
+
+if __name__ == '__main__':
+    main()
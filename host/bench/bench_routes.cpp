@@ -0,0 +1,80 @@
+//  what finding a request's route costs: the sketch's findRoute(), one
+//  hashed jump and one compare, against a chain of compares over the
+//  same routes in the same order, as dispatch used to be. The chain
+//  costs more the further down a route is, and a pin, which matches
+//  none, pays for all of them; findRoute() costs the same for each.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../sketch.cpp"
+
+#define RUNS 2000000
+
+static const struct {
+  const char *name;
+  RouteHandler handler;
+} chain[] = {
+  { "PORT", routePorts },
+  { "D*", routePorts },
+  { "BATCH", routeBatch },
+  { "EVENTS", openEventStream },
+  { "STATE", routeState },
+  { "CAPTURE", routeCapture },
+  { "PWM", routePwm },
+};
+
+#define ROUTES (sizeof(chain) / sizeof(chain[0]))
+
+static RouteHandler chainRoute(const char *segment)
+{
+  for(unsigned i = 0; i < ROUTES; i++){
+    if(strcmp(segment, chain[i].name) == 0){
+      return chain[i].handler;
+    }
+  }
+  return routePin;
+}
+
+static int64_t nanos()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static volatile RouteHandler sink;
+
+static double timeLookup(RouteHandler (*lookup)(const char *), const char *segment)
+{
+  char copy[16];
+
+  strcpy(copy, segment);
+  int64_t start = nanos();
+  for(int i = 0; i < RUNS; i++){
+    //  the segment changes under the compiler, so every run looks it up
+    __asm__ __volatile__("" : : "r"(copy) : "memory");
+    sink = lookup(copy);
+  }
+  return (nanos() - start) / (double)RUNS;
+}
+
+int main()
+{
+  static const char *segments[] = {
+    "PORT", "D*", "BATCH", "EVENTS", "STATE", "CAPTURE", "PWM", "13", "A0"
+  };
+
+  printf("%-10s %8s %14s %12s\n", "segment", "compares", "findRoute ns", "chain ns");
+  for(unsigned i = 0; i < sizeof(segments) / sizeof(segments[0]); i++){
+    if(findRoute(segments[i]) != chainRoute(segments[i])){
+      printf("%s: findRoute and the chain disagree\n", segments[i]);
+      return 1;
+    }
+    printf("%-10s %8u %14.2f %12.2f\n", segments[i], (i < ROUTES) ? i + 1 : (unsigned)ROUTES,
+      timeLookup(findRoute, segments[i]), timeLookup(chainRoute, segments[i]));
+  }
+
+  return 0;
+}
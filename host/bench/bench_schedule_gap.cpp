@@ -0,0 +1,132 @@
+//  how late a timed action can run: the schedule is checked between
+//  pieces of network work, so an action is late by at most the
+//  longest stretch of work between two checks. The bench counts the
+//  W5100 frames of those stretches while clients ask for the sketch's
+//  longest responses; each frame is 4 bytes over SPI, 8 us at the
+//  W5100's 4 MHz clock, so frames are the figure that carries over to
+//  the board. The stretches are found through micros(), which these
+//  requests only read when runSchedule() starts.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+//  the core's IPAddress has a constant of this name
+#undef INADDR_NONE
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "W5100Sim.h"
+#include "../test/sketch_harness.h"
+
+#define REQUESTS 200
+
+static uint32_t worstGap;
+
+static unsigned long benchMicros()
+{
+  if(W5100Chip.frames() > worstGap){
+    worstGap = W5100Chip.frames();
+  }
+  W5100Chip.resetCounters();
+  return micros();
+}
+
+#define micros() benchMicros()
+
+#include "../sketch.cpp"
+
+static const char *browserHeaders =
+  "Host: 10.0.1.100\r\nConnection: close\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like "
+  "Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Encoding: gzip, deflate\r\nAccept-Language: en-US,en;q=0.9\r\n\r\n";
+
+static const char *paths[] = {
+  "/8",
+  "/STATE",
+  "/PORT",
+  "/BATCH?D2&D3&D5&D6&D7&D8&D9&A0&A1&A2&A3&A4&A5",
+  "/A0/HISTORY",
+  "/PWM/1",
+  "/CAPTURE/DATA",
+};
+
+//  a request from a browser on its own connection, with loop() run
+//  until the sketch has answered and closed it; the response's length
+static int request(const char *path)
+{
+  char data[8192];
+  int length = 0;
+
+  int s = sketchConnect();
+  if(s < 0){
+    exit(1);
+  }
+  snprintf(data, sizeof(data), "GET %s HTTP/1.1\r\n%s", path, browserHeaders);
+  send(s, data, strlen(data), 0);
+
+  for(int pass = 0; pass < 100000; pass++){
+    loop();
+    int n = recv(s, data, sizeof(data), MSG_DONTWAIT);
+    if(n == 0){
+      break;
+    }
+    if(n > 0){
+      length += n;
+    }
+  }
+  close(s);
+  return length;
+}
+
+//  a full capture buffer of runs as long as they come, the longest
+//  /CAPTURE/DATA there can be
+static void fillCapture()
+{
+  capture.port = digitalPinToPort(2);
+  for(unsigned int i = 0; i < CAPTURESIZE; i++){
+    capture.runs[i].value = 0xAA ^ i;
+    capture.runs[i].length = 65535;
+  }
+  capture.head = 0;
+  capture.count = CAPTURESIZE;
+  capture.state = CAPTURE_DONE;
+}
+
+int main()
+{
+  sketchBegin();
+  hostAdvanceTime(1000);
+
+  //  every pin given a mode and a value, so /STATE lists them all
+  for(byte pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+    char path[16];
+    snprintf(path, sizeof(path), "/%d/%s", pin, (pin == 9) ? "128" : "HIGH");
+    request(path);
+  }
+
+  printf("%-48s %8s %12s\n", "", "bytes", "worst frames");
+  worstGap = 0;
+  for(int pass = 0; pass < 2000; pass++){
+    loop();
+    hostAdvanceTime(5);
+  }
+  printf("%-48s %8d %12u\n", "idle", 0, worstGap);
+  for(unsigned p = 0; p < sizeof(paths) / sizeof(paths[0]); p++){
+    int bytes = 0;
+
+    worstGap = 0;
+    for(int i = 0; i < REQUESTS; i++){
+      fillCapture();
+      bytes = request(paths[p]);
+    }
+    printf("%-48s %8d %12u\n", paths[p], bytes, worstGap);
+  }
+
+  return 0;
+}
@@ -0,0 +1,105 @@
+//  the time a request takes from connecting until the client has read
+//  the response and closed, one connection after another, as p50 and
+//  p99: host microseconds, passes through loop() and W5100 frames. The
+//  client reads and closes in a thread of its own, as a client on the
+//  LAN would while the sketch waits on it, and gets the CPU between
+//  passes on a host with only one.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+//  the core's IPAddress has a constant of this name
+#undef INADDR_NONE
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "W5100Sim.h"
+#include "../test/sketch_harness.h"
+
+#define REQUESTS 2000
+
+static const char *request = "GET /8 HTTP/1.1\r\nHost: restduino\r\nConnection: close\r\n\r\n";
+
+static uint32_t usecs[REQUESTS];
+static uint32_t passes[REQUESTS];
+static uint32_t frames[REQUESTS];
+
+static volatile bool done;
+
+static void *client(void *arg)
+{
+  char data[1024];
+  int s = *(int *)arg;
+
+  while(recv(s, data, sizeof(data), 0) > 0)
+    ;
+  close(s);
+  done = true;
+  return NULL;
+}
+
+static int64_t nanos()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int compare(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void print(const char *name, uint32_t *values)
+{
+  qsort(values, REQUESTS, sizeof(values[0]), compare);
+  printf("%-14s %8u %8u %8u\n", name, values[REQUESTS / 2], values[REQUESTS * 99 / 100],
+    values[REQUESTS - 1]);
+}
+
+int main()
+{
+  sketchBegin();
+
+  for(int i = 0; i < REQUESTS; i++){
+    W5100Chip.resetCounters();
+    int64_t start = nanos();
+    uint32_t n = 0;
+
+    int s = sketchConnect();
+    if(s < 0){
+      return 1;
+    }
+    send(s, request, strlen(request), 0);
+
+    pthread_t thread;
+    done = false;
+    pthread_create(&thread, NULL, client, &s);
+    while(!done){
+      hostInterrupts();
+      loop();
+      n++;
+      sched_yield();
+    }
+    pthread_join(thread, NULL);
+
+    usecs[i] = (nanos() - start) / 1000;
+    passes[i] = n;
+    frames[i] = W5100Chip.frames();
+  }
+
+  printf("%-14s %8s %8s %8s\n", "", "p50", "p99", "max");
+  print("host us", usecs);
+  print("loop() passes", passes);
+  print("W5100 frames", frames);
+
+  return 0;
+}
@@ -0,0 +1,179 @@
+//  how long one pass through the sketch's loop() takes while clients
+//  keep it busy: stalled and trickling clients, and kept-alive clients
+//  on every connection. Bonjour runs once a pass, so the longest pass
+//  is the longest it waits. W5100 frames per pass are what the time
+//  comes to on the board, where each is four bytes over SPI; the host
+//  microseconds include the simulated chip's socket calls, and their
+//  slowest passes are the host's scheduler more than the sketch.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+//  the core's IPAddress has a constant of this name
+#undef INADDR_NONE
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "W5100Sim.h"
+#include "../test/sketch_harness.h"
+
+#define PASSES 20000
+#define CLIENTS 3
+
+static const char *shortRequest = "GET /8 HTTP/1.1\r\nHost: restduino\r\n\r\n";
+static const char *browserRequest =
+  "GET /8 HTTP/1.1\r\nHost: 10.0.1.100\r\nConnection: keep-alive\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like "
+  "Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Encoding: gzip, deflate\r\nAccept-Language: en-US,en;q=0.9\r\n\r\n";
+
+//  a client sends its request pace bytes a pass (all of it when 0),
+//  stops after stall bytes when stall isn't 0, and sends it again
+//  once the chunked response has ended; like a browser it connects
+//  again when the sketch closes its idle connection for another
+typedef struct {
+  int fd;
+  const char *request;
+  int pace;
+  int stall;
+  int sent;
+  char tail[5];
+  long responses;
+} Client;
+
+typedef struct {
+  const char *name;
+  int clients;
+  Client setup[CLIENTS];
+} Scenario;
+
+static const Scenario scenarios[] = {
+  { "idle", 0, {} },
+  { "one stalled request", 1, { { -1, shortRequest, 0, 20 } } },
+  { "one trickling browser", 1, { { -1, browserRequest, 1, 0 } } },
+  { "two kept-alive clients", 2,
+    { { -1, shortRequest, 0, 0 }, { -1, shortRequest, 0, 0 } } },
+  { "two browsers", 2,
+    { { -1, browserRequest, 0, 0 }, { -1, browserRequest, 0, 0 } } },
+  { "two clients, one stalled", 3,
+    { { -1, shortRequest, 0, 0 }, { -1, shortRequest, 0, 0 },
+      { -1, shortRequest, 0, 10 } } },
+};
+
+static uint32_t passNanos[PASSES];
+
+static int64_t nanos()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int compare(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void serveClient(Client *client)
+{
+  int length = strlen(client->request);
+  char data[2048];
+
+  if(client->sent < length && (client->stall == 0 || client->sent < client->stall)){
+    int n = length - client->sent;
+    if(client->pace > 0 && n > client->pace){
+      n = client->pace;
+    }
+    if(client->stall > 0 && client->sent + n > client->stall){
+      n = client->stall - client->sent;
+    }
+    n = send(client->fd, client->request + client->sent, n, MSG_DONTWAIT);
+    if(n > 0){
+      client->sent += n;
+    }
+  }
+
+  int n = recv(client->fd, data, sizeof(data), MSG_DONTWAIT);
+  if(n == 0){
+    close(client->fd);
+    client->fd = sketchConnect();
+    client->sent = 0;
+    return;
+  }
+  if(n < 0){
+    return;
+  }
+  //  the last five bytes seen, to find "0\r\n\r\n" across reads
+  for(int i = 0; i < n; i++){
+    memmove(client->tail, client->tail + 1, 4);
+    client->tail[4] = data[i];
+    if(memcmp(client->tail, "0\r\n\r\n", 5) == 0){
+      client->responses++;
+      client->sent = 0;
+    }
+  }
+}
+
+int main()
+{
+  sketchBegin();
+
+  printf("%-28s %9s %8s %8s %8s %10s %10s\n", "", "responses", "p50 us", "p99 us",
+    "p99.9 us", "frames/pass", "max frames");
+  for(unsigned s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++){
+    Client clients[CLIENTS];
+    uint64_t totalFrames = 0;
+    uint32_t maxFrames = 0;
+    long responses = 0;
+
+    memcpy(clients, scenarios[s].setup, sizeof(clients));
+    for(int c = 0; c < scenarios[s].clients; c++){
+      clients[c].fd = sketchConnect();
+      if(clients[c].fd < 0){
+        return 1;
+      }
+    }
+
+    for(int pass = 0; pass < PASSES; pass++){
+      for(int c = 0; c < scenarios[s].clients; c++){
+        serveClient(&clients[c]);
+      }
+
+      hostInterrupts();
+      W5100Chip.resetCounters();
+      int64_t start = nanos();
+      loop();
+      passNanos[pass] = nanos() - start;
+
+      totalFrames += W5100Chip.frames();
+      if(W5100Chip.frames() > maxFrames){
+        maxFrames = W5100Chip.frames();
+      }
+    }
+
+    for(int c = 0; c < scenarios[s].clients; c++){
+      responses += clients[c].responses;
+      close(clients[c].fd);
+    }
+    //  let the sketch reap the sockets before the next scenario
+    for(int pass = 0; pass < 200; pass++){
+      hostAdvanceTime(10);
+      loop();
+    }
+
+    qsort(passNanos, PASSES, sizeof(passNanos[0]), compare);
+    printf("%-28s %9ld %8.1f %8.1f %8.1f %10.1f %10u\n", scenarios[s].name, responses,
+      passNanos[PASSES / 2] / 1000.0, passNanos[PASSES * 99 / 100] / 1000.0,
+      passNanos[PASSES * 999 / 1000] / 1000.0, totalFrames / (double)PASSES, maxFrames);
+  }
+
+  return 0;
+}
@@ -0,0 +1,219 @@
+#  helpers the host tests and benchmarks share: running ./restduino on
+#  a free port, HTTP over one connection, and mDNS queries as a
+#  querier on the LAN would send them, all over plain sockets
+
+import os
+import random
+import select
+import socket
+import struct
+import subprocess
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+MDNS_GROUP = '224.0.0.251'
+MDNS_PORT = 5353
+
+
+class Restduino(object):
+    """./restduino on a port the host picks, for a with block"""
+
+    def __init__(self, binary=None):
+        self.binary = binary or os.path.join(HERE, 'restduino')
+        self.process = None
+        self.port = None
+
+    def __enter__(self):
+        self.process = subprocess.Popen([self.binary, '-p', '0'],
+                                        stdout=subprocess.DEVNULL,
+                                        stderr=subprocess.PIPE)
+        line = self.process.stderr.readline().decode()
+        if not line.startswith('restduino: http on port '):
+            self.process.kill()
+            raise RuntimeError('restduino did not start: %r' % line)
+        self.port = int(line.split()[-1])
+        return self
+
+    def __exit__(self, *exc):
+        self.process.kill()
+        self.process.wait()
+
+    def connect(self):
+        return Connection(self.port)
+
+    def get(self, path):
+        connection = self.connect()
+        try:
+            return connection.get(path)
+        finally:
+            connection.close()
+
+
+class Connection(object):
+    """an HTTP/1.1 connection that is kept open between requests"""
+
+    def __init__(self, port, host='127.0.0.1'):
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buffer = b''
+
+    def close(self):
+        self.sock.close()
+
+    def send(self, path, method='GET', close=False):
+        request = '%s %s HTTP/1.1\r\nHost: restduino\r\n' % (method, path)
+        if close:
+            request += 'Connection: close\r\n'
+        self.sock.sendall((request + '\r\n').encode())
+
+    def _fill(self):
+        data = self.sock.recv(65536)
+        if not data:
+            raise EOFError('connection closed')
+        self.buffer += data
+
+    def _line(self):
+        while b'\r\n' not in self.buffer:
+            self._fill()
+        line, self.buffer = self.buffer.split(b'\r\n', 1)
+        return line.decode()
+
+    def response(self):
+        """(status, headers, body) of the next response"""
+        status = int(self._line().split()[1])
+        headers = {}
+        while True:
+            line = self._line()
+            if not line:
+                break
+            name, value = line.split(':', 1)
+            headers[name.strip().lower()] = value.strip()
+
+        if headers.get('transfer-encoding') == 'chunked':
+            body = b''
+            while True:
+                size = int(self._line().split(';')[0], 16)
+                while len(self.buffer) < size + 2:
+                    self._fill()
+                body += self.buffer[:size]
+                self.buffer = self.buffer[size + 2:]
+                if size == 0:
+                    break
+        elif 'content-length' in headers:
+            size = int(headers['content-length'])
+            while len(self.buffer) < size:
+                self._fill()
+            body, self.buffer = self.buffer[:size], self.buffer[size:]
+        else:
+            try:
+                while True:
+                    self._fill()
+            except EOFError:
+                pass
+            body, self.buffer = self.buffer, b''
+
+        return status, headers, body.decode()
+
+    def get(self, path, close=False):
+        self.send(path, close=close)
+        return self.response()
+
+
+def mdns_query(name, qtype=1, unicast=False, xid=0):
+    """a query for one record, name like 'restduino.local'"""
+    packet = struct.pack('>HHHHHH', xid, 0, 1, 0, 0, 0)
+    for label in name.split('.'):
+        packet += struct.pack('B', len(label)) + label.encode()
+    packet += b'\x00' + struct.pack('>HH', qtype, 0x8001 if unicast else 0x0001)
+    return packet
+
+
+def mdns_name(packet, offset):
+    """the name at offset, following compression pointers, and the
+    offset just past it"""
+    labels = []
+    end = None
+    while True:
+        length = packet[offset]
+        if length & 0xC0 == 0xC0:
+            if end is None:
+                end = offset + 2
+            offset = ((length & 0x3F) << 8) | packet[offset + 1]
+            continue
+        offset += 1
+        if length == 0:
+            break
+        labels.append(packet[offset:offset + length].decode())
+        offset += length
+    return '.'.join(labels), (end if end is not None else offset)
+
+
+def mdns_records(packet):
+    """(xid, flags, [(name, type, class, ttl, rdata)]) of a response;
+    the records of all three answer sections"""
+    xid, flags, qd, an, ns, ar = struct.unpack('>HHHHHH', packet[:12])
+    offset = 12
+    for _ in range(qd):
+        _, offset = mdns_name(packet, offset)
+        offset += 4
+    records = []
+    for _ in range(an + ns + ar):
+        name, offset = mdns_name(packet, offset)
+        rtype, rclass, ttl, length = struct.unpack('>HHIH', packet[offset:offset + 10])
+        offset += 10
+        records.append((name, rtype, rclass, ttl, packet[offset:offset + length]))
+        offset += length
+    return xid, flags, records
+
+
+class MDNSQuerier(object):
+    """a socket that hears the mDNS group: bound to port 5353 like a
+    full querier, or to a port of its own for one-shot (legacy
+    unicast) queries"""
+
+    def __init__(self, port=MDNS_PORT):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+        self.sock.bind(('', port))
+        self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP,
+                             socket.inet_aton(MDNS_GROUP) + socket.inet_aton('0.0.0.0'))
+        self.sent = set()
+
+    def close(self):
+        self.sock.close()
+
+    def send(self, packet, to=(MDNS_GROUP, MDNS_PORT)):
+        self.sent.add(packet)
+        self.sock.sendto(packet, to)
+
+    def receive(self, timeout):
+        """the next response that isn't a query of ours, or None"""
+        deadline = time.time() + timeout
+        while True:
+            left = deadline - time.time()
+            if left <= 0 or not select.select([self.sock], [], [], left)[0]:
+                return None
+            packet, sender = self.sock.recvfrom(9000)
+            if packet in self.sent or not (packet[2] & 0x80):
+                continue
+            return packet, sender
+
+    def ask(self, packet, timeout=1.0):
+        """(seconds until the response, response, sender) or None"""
+        start = time.time()
+        self.send(packet)
+        reply = self.receive(timeout)
+        if reply is None:
+            return None
+        return (time.time() - start,) + reply
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100.0))]
+
+
+def random_xid():
+    return random.randint(1, 0xFFFF)
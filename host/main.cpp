@@ -0,0 +1,62 @@
+//  runs the sketch on the host: the Ethernet shield is a simulated
+//  W5100 on the host's sockets, so
+//
+//    ./restduino -p 8080
+//    curl http://localhost:8080/13/HIGH
+//
+//  talks to the sketch, and it answers mDNS queries for
+//  restduino.local on 224.0.0.251:5353 like it would on the LAN.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <HostBoard.h>
+
+#include "W5100Sim.h"
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-p port] [-a address]\n"
+    "  -p port     host port serving the sketch's port 80 (8080)\n"
+    "  -a address  address DHCP hands the sketch (127.0.0.1)\n", name);
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  int port = 8080;
+  int opt;
+  unsigned a, b, c, d;
+
+  while((opt = getopt(argc, argv, "p:a:")) != -1){
+    switch(opt){
+    case 'p':
+      port = atoi(optarg);
+      break;
+
+    case 'a':
+      if(sscanf(optarg, "%u.%u.%u.%u", &a, &b, &c, &d) != 4){
+        usage(argv[0]);
+      }
+      hostDHCPAddress = IPAddress(a, b, c, d);
+      break;
+
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  W5100Chip.mapPort(80, port);
+
+  init();
+  setup();
+  fprintf(stderr, "restduino: http on port %u\n", W5100Chip.hostPort(80));
+
+  for(;;){
+    hostInterrupts();
+    loop();
+  }
+}
@@ -0,0 +1,10 @@
+//  RESTduino.ino as the Arduino IDE builds it: after Arduino.h, with
+//  the prototypes it generates for functions used before they are
+//  defined
+
+#include <Arduino.h>
+
+void startScanner();
+void runSchedule();
+
+#include "../RESTduino.ino"
@@ -0,0 +1,38 @@
+//  the checks of the C++ host tests: each failure is reported with
+//  its line, and checkResult() gives main() its exit status
+
+#ifndef check_h
+#define check_h
+
+#include <stdio.h>
+
+static int checkFailures = 0;
+static int checkCount = 0;
+
+#define CHECK(condition) \
+  do { \
+    checkCount++; \
+    if(!(condition)){ \
+      checkFailures++; \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    } \
+  } while(0)
+
+#define CHECK_EQUAL(expected, actual) \
+  do { \
+    long _e = (long)(expected); \
+    long _a = (long)(actual); \
+    checkCount++; \
+    if(_e != _a){ \
+      checkFailures++; \
+      fprintf(stderr, "%s:%d: %s is %ld, expected %ld\n", __FILE__, __LINE__, #actual, _a, _e); \
+    } \
+  } while(0)
+
+static int checkResult(const char *name)
+{
+  printf("%s: %d checks, %d failed\n", name, checkCount, checkFailures);
+  return checkFailures ? 1 : 0;
+}
+
+#endif
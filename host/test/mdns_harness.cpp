@@ -0,0 +1,353 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+//  the core's IPAddress has a constant of this name
+#undef INADDR_NONE
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetBonjour.h>
+#include <HostBoard.h>
+#include <utility/EthernetCompat.h>
+
+#include "W5100Sim.h"
+#include "mdns_harness.h"
+
+static byte mac[] = { 0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED };
+
+static int querier = -1;
+static int mdnsSocket = -1;
+
+MDNSPacket::MDNSPacket(uint16_t xid, uint16_t flags)
+{
+  memset(data, 0, 12);
+  data[0] = xid >> 8;
+  data[1] = xid & 0xFF;
+  data[2] = flags >> 8;
+  data[3] = flags & 0xFF;
+  length = 12;
+  names = 0;
+  compress = false;
+}
+
+void MDNSPacket::count(int section)
+{
+  uint16_t n = (data[4 + 2 * section] << 8) | data[5 + 2 * section];
+  n++;
+  data[4 + 2 * section] = n >> 8;
+  data[5 + 2 * section] = n & 0xFF;
+}
+
+//  with compression, the longest ending of the name written before
+//  is replaced by a pointer to it
+void MDNSPacket::name(const char *name)
+{
+  while(*name){
+    if(compress){
+      for(int i = 0; i < names; i++){
+        char written[256];
+        int offset = nameOffsets[i];
+        if(mdnsName(data, length, &offset, written) && strcasecmp(written, name) == 0){
+          data[length++] = 0xC0 | (nameOffsets[i] >> 8);
+          data[length++] = nameOffsets[i] & 0xFF;
+          return;
+        }
+      }
+      if(names < NAMES){
+        nameOffsets[names++] = length;
+      }
+    }
+
+    const char *dot = strchr(name, '.');
+    int labelLength = dot ? dot - name : strlen(name);
+    data[length++] = labelLength;
+    memcpy(data + length, name, labelLength);
+    length += labelLength;
+    name += labelLength + (dot ? 1 : 0);
+  }
+  data[length++] = 0;
+}
+
+void MDNSPacket::question(const char *qname, uint16_t type, bool unicast)
+{
+  name(qname);
+  data[length++] = type >> 8;
+  data[length++] = type & 0xFF;
+  data[length++] = unicast ? 0x80 : 0x00;
+  data[length++] = 0x01;
+  count(0);
+}
+
+void MDNSPacket::answer(const char *rname, uint16_t type, uint32_t ttl,
+  const uint8_t *rdata, uint16_t rlength)
+{
+  name(rname);
+  data[length++] = type >> 8;
+  data[length++] = type & 0xFF;
+  data[length++] = 0x00;
+  data[length++] = 0x01;
+  for(int shift = 24; shift >= 0; shift -= 8){
+    data[length++] = (ttl >> shift) & 0xFF;
+  }
+  data[length++] = rlength >> 8;
+  data[length++] = rlength & 0xFF;
+  memcpy(data + length, rdata, rlength);
+  length += rlength;
+  count(1);
+}
+
+void MDNSPacket::answerName(const char *rname, uint16_t type, uint32_t ttl, const char *target)
+{
+  uint16_t start;
+
+  answer(rname, type, ttl, NULL, 0);
+  start = length;
+  name(target);
+  data[start - 2] = (length - start) >> 8;
+  data[start - 1] = (length - start) & 0xFF;
+}
+
+bool mdnsName(const uint8_t *packet, int length, int *offset, char *name)
+{
+  int at = *offset;
+  int limit = at;
+  int end = -1;
+  int used = 0;
+
+  name[0] = 0;
+  for(;;){
+    if(at >= length){
+      return false;
+    }
+    uint8_t label = packet[at];
+    if((label & 0xC0) == 0xC0){
+      if(at + 1 >= length){
+        return false;
+      }
+      int target = ((label & 0x3F) << 8) | packet[at + 1];
+      //  pointers only go backwards, so names can't loop
+      if(target >= limit){
+        return false;
+      }
+      if(end < 0){
+        end = at + 2;
+      }
+      at = limit = target;
+      continue;
+    }
+    if(label & 0xC0){
+      return false;
+    }
+    at++;
+    if(label == 0){
+      break;
+    }
+    if(at + label > length || used + label + 2 > 255){
+      return false;
+    }
+    if(used){
+      name[used++] = '.';
+    }
+    memcpy(name + used, packet + at, label);
+    used += label;
+    name[used] = 0;
+    at += label;
+  }
+
+  *offset = (end >= 0) ? end : at;
+  return true;
+}
+
+int mdnsRecords(const uint8_t *packet, int length, MDNSRecord *records, int max)
+{
+  if(length < 12){
+    return -1;
+  }
+
+  int counts[4];
+  for(int i = 0; i < 4; i++){
+    counts[i] = (packet[4 + 2 * i] << 8) | packet[5 + 2 * i];
+  }
+
+  int offset = 12;
+  char name[256];
+  for(int i = 0; i < counts[0]; i++){
+    if(!mdnsName(packet, length, &offset, name) || offset + 4 > length){
+      return -1;
+    }
+    offset += 4;
+  }
+
+  int n = 0;
+  for(int section = 1; section <= 3; section++){
+    for(int i = 0; i < counts[section]; i++){
+      MDNSRecord record;
+      if(!mdnsName(packet, length, &offset, record.name) || offset + 10 > length){
+        return -1;
+      }
+      record.type = (packet[offset] << 8) | packet[offset + 1];
+      record.rclass = (packet[offset + 2] << 8) | packet[offset + 3];
+      record.ttl = ((uint32_t)packet[offset + 4] << 24) | ((uint32_t)packet[offset + 5] << 16) |
+        ((uint32_t)packet[offset + 6] << 8) | packet[offset + 7];
+      record.length = (packet[offset + 8] << 8) | packet[offset + 9];
+      offset += 10;
+      if(offset + record.length > length){
+        return -1;
+      }
+      record.data = packet + offset;
+      record.section = section;
+      record.target[0] = 0;
+
+      //  the names in PTR and SRV data must end where the data does
+      int target = offset + ((record.type == MDNS_TYPE_SRV) ? 6 : 0);
+      if(record.type == MDNS_TYPE_PTR || record.type == MDNS_TYPE_SRV){
+        if(!mdnsName(packet, length, &target, record.target) ||
+           target != offset + record.length){
+          return -1;
+        }
+      }
+
+      offset += record.length;
+      if(n < max){
+        records[n] = record;
+      }
+      n++;
+    }
+  }
+
+  return (offset == length) ? n : -1;
+}
+
+void mdnsHarnessBegin(const char *name)
+{
+  struct sockaddr_in addr;
+  struct ip_mreq mreq;
+  int one = 1;
+
+  //  an address of its own, to tell the library's replies from the
+  //  querier's packets, on the loopback interface like the querier's
+  hostDHCPAddress = IPAddress(127, 0, 0, 2);
+
+  init();
+  hostAdvanceTime(3000);
+  Ethernet.begin(mac);
+  EthernetBonjour.begin(name);
+
+  for(int s = 0; s < MAX_SOCK_NUM; s++){
+    if(W5100.readSnSR(s) == SnSR::UDP && W5100.readSnPORT(s) == 5353){
+      mdnsSocket = s;
+    }
+  }
+
+  //  bound after the library's socket, so unicast replies to port
+  //  5353 come here
+  querier = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  setsockopt(querier, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(5353);
+  if(bind(querier, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    perror("mdns_harness: bind");
+  }
+  mreq.imr_multiaddr.s_addr = inet_addr("224.0.0.251");
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+  setsockopt(querier, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+  setsockopt(querier, IPPROTO_IP, IP_PKTINFO, &one, sizeof(one));
+
+  //  the announcements the library starts with
+  mdnsHarnessDrain(50);
+}
+
+int mdnsHarnessSocket()
+{
+  return mdnsSocket;
+}
+
+bool mdnsHarnessSend(const MDNSPacket &packet)
+{
+  struct sockaddr_in to;
+
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_addr.s_addr = inet_addr("224.0.0.251");
+  to.sin_port = htons(5353);
+  if(sendto(querier, packet.data, packet.length, 0, (struct sockaddr *)&to, sizeof(to)) < 0){
+    return false;
+  }
+
+  unsigned long start = millis();
+  while(W5100.readSnRX_RSR(mdnsSocket) == 0){
+    if(millis() - start > 1000){
+      return false;
+    }
+    usleep(50);
+  }
+
+  W5100Chip.resetCounters();
+#if defined(ETHERNET_COMPAT_STATS)
+  ethernet_compat_reset_spi_transactions();
+#endif
+  return true;
+}
+
+int mdnsHarnessReceive(uint8_t *packet, int size, unsigned long timeout,
+  uint32_t *from, uint32_t *to)
+{
+  unsigned long start = millis();
+
+  do {
+    struct sockaddr_in sender;
+    char control[64];
+    struct iovec iov = { packet, (size_t)size };
+    struct msghdr message;
+
+    EthernetBonjour.run();
+
+    memset(&message, 0, sizeof(message));
+    message.msg_name = &sender;
+    message.msg_namelen = sizeof(sender);
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    int length = recvmsg(querier, &message, 0);
+    //  our own queries come back too
+    if(length >= 12 && (packet[2] & 0x80)){
+      if(from != NULL){
+        *from = sender.sin_addr.s_addr;
+      }
+      for(struct cmsghdr *c = CMSG_FIRSTHDR(&message); to != NULL && c != NULL;
+          c = CMSG_NXTHDR(&message, c)){
+        if(c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_PKTINFO){
+          *to = ((struct in_pktinfo *)CMSG_DATA(c))->ipi_addr.s_addr;
+        }
+      }
+      return length;
+    }
+    if(length < 0){
+      usleep(50);
+    }
+  } while(millis() - start < timeout);
+
+  return -1;
+}
+
+void mdnsHarnessDrain(unsigned long ms)
+{
+  uint8_t packet[1500];
+
+  unsigned long start = millis();
+  while(millis() - start < ms){
+    EthernetBonjour.run();
+    usleep(100);
+  }
+  while(recv(querier, packet, sizeof(packet), 0) >= 0)
+    ;
+}
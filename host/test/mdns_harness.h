@@ -0,0 +1,82 @@
+//  EthernetBonjour on the simulated W5100, with a querier on the host's
+//  side of it: packets are multicast to 224.0.0.251:5353 from port
+//  5353, as a querier on the LAN sends them, and the library's replies
+//  are caught on the same socket. MDNSPacket builds queries with name
+//  compression like real queriers do, mdnsRecords() takes replies apart.
+
+#ifndef mdns_harness_h
+#define mdns_harness_h
+
+#include <stdint.h>
+
+#define MDNS_TYPE_A 1
+#define MDNS_TYPE_PTR 12
+#define MDNS_TYPE_TXT 16
+#define MDNS_TYPE_AAAA 28
+#define MDNS_TYPE_SRV 33
+#define MDNS_TYPE_NSEC 47
+
+class MDNSPacket {
+public:
+  MDNSPacket(uint16_t xid = 0, uint16_t flags = 0);
+
+  //  sections must be filled in order
+  void question(const char *name, uint16_t type, bool unicast = false);
+  void answer(const char *name, uint16_t type, uint32_t ttl,
+    const uint8_t *data, uint16_t length);
+  void answerName(const char *name, uint16_t type, uint32_t ttl, const char *target);
+
+  //  off by default, to build packets without pointers
+  bool compress;
+
+  uint8_t data[1500];
+  uint16_t length;
+
+private:
+  void name(const char *name);
+  void count(int section);
+
+  static const int NAMES = 32;
+  uint16_t nameOffsets[NAMES];
+  int names;
+};
+
+struct MDNSRecord {
+  char name[256];
+  uint16_t type;
+  uint16_t rclass;
+  uint32_t ttl;
+  const uint8_t *data;
+  uint16_t length;
+  int section;      //  1 answer, 2 authority, 3 additional
+  char target[256]; //  the name a PTR or SRV points to
+};
+
+//  the records of a response, -1 if it doesn't parse: a name or
+//  record runs past the end, or a pointer doesn't point backwards
+int mdnsRecords(const uint8_t *packet, int length, MDNSRecord *records, int max);
+
+//  reads a name at *offset as above, into name as dotted text
+bool mdnsName(const uint8_t *packet, int length, int *offset, char *name);
+
+//  Ethernet and EthernetBonjour as a sketch starts them, past the
+//  library's wait for the shield, and the querier socket
+void mdnsHarnessBegin(const char *name);
+
+//  the chip socket EthernetBonjour uses
+int mdnsHarnessSocket();
+
+//  multicasts the packet and waits until it is in the chip's RX buffer;
+//  the frame counters are reset then, so they count what follows
+bool mdnsHarnessSend(const MDNSPacket &packet);
+
+//  runs the library until a response arrives, or timeout ms pass;
+//  its length, or -1. from gets the sender's address, to the address
+//  it was sent to: the group, or the querier's for a unicast reply.
+int mdnsHarnessReceive(uint8_t *packet, int size, unsigned long timeout,
+  uint32_t *from = 0, uint32_t *to = 0);
+
+//  drops whatever arrived, running the library for ms first
+void mdnsHarnessDrain(unsigned long ms);
+
+#endif
@@ -0,0 +1,94 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+//  the core's IPAddress has a constant of this name
+#undef INADDR_NONE
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "W5100Sim.h"
+#include "sketch_harness.h"
+
+void sketchBegin()
+{
+  W5100Chip.mapPort(80, 0);
+  init();
+  setup();
+}
+
+int sketchConnect()
+{
+  struct sockaddr_in addr;
+  int one = 1;
+
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = htons(W5100Chip.hostPort(80));
+  if(connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    perror("sketch_harness: connect");
+    close(s);
+    return -1;
+  }
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return s;
+}
+
+int sketchGet(const char *path, char *body, int size)
+{
+  char response[4096];
+  int length = 0;
+
+  int s = sketchConnect();
+  if(s < 0){
+    return -1;
+  }
+
+  snprintf(response, sizeof(response), "GET %s HTTP/1.0\r\n\r\n", path);
+  if(send(s, response, strlen(response), 0) < 0){
+    close(s);
+    return -1;
+  }
+
+  unsigned long start = millis();
+  for(;;){
+    hostInterrupts();
+    loop();
+
+    int n = recv(s, response + length, sizeof(response) - 1 - length, MSG_DONTWAIT);
+    if(n == 0 || length == (int)sizeof(response) - 1){
+      break;
+    }
+    if(n > 0){
+      length += n;
+    }
+    else if(errno != EAGAIN && errno != EWOULDBLOCK){
+      break;
+    }
+    if(millis() - start > 1000){
+      close(s);
+      return -1;
+    }
+  }
+  close(s);
+  response[length] = '\0';
+
+  char *end = strstr(response, "\r\n\r\n");
+  if(strncmp(response, "HTTP/1.", 7) != 0 || end == NULL){
+    return -1;
+  }
+  if(body != NULL && size > 0){
+    strncpy(body, end + 4, size - 1);
+    body[size - 1] = '\0';
+  }
+  return atoi(response + 9);
+}
@@ -0,0 +1,21 @@
+//  the sketch on the simulated W5100, with an HTTP client on the host's
+//  side of it: setup() as the board runs it, and requests that are
+//  answered by running loop() until the response has come back
+
+#ifndef sketch_harness_h
+#define sketch_harness_h
+
+//  init() and setup(), with the sketch's port 80 on a host port of
+//  its own
+void sketchBegin();
+
+//  sends an HTTP/1.0 GET for path on a new connection and runs loop()
+//  until the sketch closes it, or a second passes; the status, or -1.
+//  body gets the response body, cut to size.
+int sketchGet(const char *path, char *body, int size);
+
+//  a connection to the sketch, for clients that take their time; -1
+//  if it can't be made
+int sketchConnect();
+
+#endif
@@ -0,0 +1,60 @@
+//  EthernetBonjour's writes into the W5100's TX buffer, on the
+//  simulated chip: each byte is one 4 byte write frame to the next
+//  address, as the W5100 has no burst write, a run past the end of the 2K buffer wraps to its start,
+//  and the frames the library counts (ETHERNET_COMPAT_STATS) are the
+//  frames the chip took
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <utility/EthernetCompat.h>
+
+#include "W5100Sim.h"
+#include "check.h"
+
+#define SOCKET 1
+#define TX_BASE (0x4000 + SOCKET * 0x800)
+
+static byte mac[] = { 0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED };
+
+static void checkRun(uint16_t pointer, uint16_t length)
+{
+  static uint8_t data[2048];
+
+  for(uint16_t i = 0; i < length; i++){
+    data[i] = (uint8_t)(pointer + 7 * i + 1);
+  }
+
+  ethernet_compat_reset_spi_transactions();
+  W5100Chip.resetCounters();
+  SPI.resetTransferred();
+
+  ethernet_compat_write_data(SOCKET, data, (uint8_t *)(uintptr_t)pointer, length);
+
+  CHECK_EQUAL(length, ethernet_compat_spi_transactions());
+  CHECK_EQUAL(length, W5100Chip.frames());
+  CHECK_EQUAL(0, W5100Chip.badFrames());
+  CHECK_EQUAL(4 * length, SPI.transferred());
+
+  for(uint16_t i = 0; i < length; i++){
+    CHECK_EQUAL(data[i], W5100Chip.memory(TX_BASE + ((pointer + i) & 0x7FF)));
+  }
+}
+
+int main()
+{
+  init();
+  Ethernet.begin(mac);
+
+  checkRun(0x0000, 1);
+  checkRun(0x0100, 12);
+  checkRun(0x07F0, 32);
+  checkRun(0x07FF, 2);
+  checkRun(0x1234, 300);
+  checkRun(0x0000, 2048);
+
+  //  the other sockets' buffers are left alone
+  CHECK_EQUAL(0, W5100Chip.memory(TX_BASE - 1));
+  CHECK_EQUAL(0, W5100Chip.memory(TX_BASE + 0x800));
+
+  return checkResult("test_compat_write");
+}
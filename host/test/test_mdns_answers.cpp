@@ -0,0 +1,199 @@
+//  what EthernetBonjour puts in a response, with service registration
+//  compiled in (RFC 6762, sections 6 and 7.1): the records a query asks
+//  for in one message, none the querier lists as known with half their
+//  TTL left, our A record added to service answers unless known, an
+//  NSEC record for AAAA questions, and announcements compressed.
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetBonjour.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "mdns_harness.h"
+
+static uint8_t reply[1500];
+static int replyLength;
+static MDNSRecord records[16];
+
+//  sends the packet once the records may be multicast again and returns
+//  the number of records in the reply, 0 if there is none
+static int exchange(const MDNSPacket &packet, unsigned long ms = 1100)
+{
+  hostAdvanceTime(ms);
+  CHECK(mdnsHarnessSend(packet));
+
+  //  service answers are delayed by up to 120 ms
+  replyLength = mdnsHarnessReceive(reply, sizeof(reply), 200);
+  if(replyLength < 0){
+    return 0;
+  }
+  int count = mdnsRecords(reply, replyLength, records, 16);
+  CHECK(count >= 0);
+  return count;
+}
+
+static const MDNSRecord *find(int count, uint16_t type, int section = 1)
+{
+  for(int i = 0; i < count; i++){
+    if(records[i].type == type && records[i].section == section){
+      return &records[i];
+    }
+  }
+  return NULL;
+}
+
+static const MDNSRecord *findNamed(int count, uint16_t type, const char *name)
+{
+  for(int i = 0; i < count; i++){
+    if(records[i].type == type && !strcmp(name, records[i].name)){
+      return &records[i];
+    }
+  }
+  return NULL;
+}
+
+static int occurrences(const uint8_t *data, int length, const char *text)
+{
+  int n = 0;
+  int textLength = strlen(text);
+  for(int i = 0; i + textLength <= length; i++){
+    if(memcmp(data + i, text, textLength) == 0){
+      n++;
+    }
+  }
+  return n;
+}
+
+int main()
+{
+  const MDNSRecord *record;
+  int count;
+
+  mdnsHarnessBegin("restduino");
+  CHECK(EthernetBonjour.addServiceRecord("RESTduino._http", 80, MDNSServiceTCP, "\x06path=/"));
+  mdnsHarnessDrain(50);
+
+  IPAddress ip = Ethernet.localIP();
+  uint8_t address[4] = { ip[0], ip[1], ip[2], ip[3] };
+  uint8_t other[4] = { 10, 0, 0, 99 };
+
+  //  our A record, known with at least half its 120 s TTL left
+  MDNSPacket knownA;
+  knownA.compress = true;
+  knownA.question("restduino.local", MDNS_TYPE_A);
+  knownA.answer("restduino.local", MDNS_TYPE_A, 60, address, 4);
+  CHECK_EQUAL(0, exchange(knownA));
+
+  MDNSPacket staleA;
+  staleA.compress = true;
+  staleA.question("restduino.local", MDNS_TYPE_A);
+  staleA.answer("restduino.local", MDNS_TYPE_A, 59, address, 4);
+  CHECK_EQUAL(1, exchange(staleA));
+
+  MDNSPacket wrongA;
+  wrongA.compress = true;
+  wrongA.question("restduino.local", MDNS_TYPE_A);
+  wrongA.answer("restduino.local", MDNS_TYPE_A, 120, other, 4);
+  CHECK_EQUAL(1, exchange(wrongA));
+
+  //  the service's PTR, known: nothing of the service is repeated
+  MDNSPacket knownPTR;
+  knownPTR.compress = true;
+  knownPTR.question("_http._tcp.local", MDNS_TYPE_PTR);
+  knownPTR.answerName("_http._tcp.local", MDNS_TYPE_PTR, 120, "RESTduino._http._tcp.local");
+  CHECK_EQUAL(0, exchange(knownPTR));
+
+  MDNSPacket otherPTR;
+  otherPTR.compress = true;
+  otherPTR.question("_http._tcp.local", MDNS_TYPE_PTR);
+  otherPTR.answerName("_http._tcp.local", MDNS_TYPE_PTR, 120, "Printer._http._tcp.local");
+  CHECK_EQUAL(4, exchange(otherPTR));
+
+  //  the enumeration's PTR to our service type, known
+  MDNSPacket knownType;
+  knownType.compress = true;
+  knownType.question("_services._dns-sd._udp.local", MDNS_TYPE_PTR);
+  knownType.answerName("_services._dns-sd._udp.local", MDNS_TYPE_PTR, 120, "_http._tcp.local");
+  CHECK_EQUAL(0, exchange(knownType));
+
+  MDNSPacket staleType;
+  staleType.compress = true;
+  staleType.question("_services._dns-sd._udp.local", MDNS_TYPE_PTR);
+  staleType.answerName("_services._dns-sd._udp.local", MDNS_TYPE_PTR, 30, "_http._tcp.local");
+  CHECK_EQUAL(1, exchange(staleType));
+
+  //  several questions get one message, our A record in it once
+  MDNSPacket several;
+  several.compress = true;
+  several.question("restduino.local", MDNS_TYPE_A);
+  several.question("_http._tcp.local", MDNS_TYPE_PTR);
+  several.question("_services._dns-sd._udp.local", MDNS_TYPE_PTR);
+  count = exchange(several);
+  CHECK_EQUAL(5, count);
+  CHECK(find(count, MDNS_TYPE_A) != NULL);
+  CHECK(find(count, MDNS_TYPE_A, 3) == NULL);
+  CHECK(find(count, MDNS_TYPE_SRV) != NULL);
+  CHECK(find(count, MDNS_TYPE_TXT) != NULL);
+  int ptrs = 0;
+  for(int i = 0; i < count; i++){
+    ptrs += (records[i].type == MDNS_TYPE_PTR);
+  }
+  CHECK_EQUAL(2, ptrs);
+  CHECK_EQUAL(-1, mdnsHarnessReceive(reply, sizeof(reply), 200));
+
+  //  multicast responses carry no questions
+  CHECK(replyLength >= 12);
+  CHECK_EQUAL(0, (reply[4] << 8) | reply[5]);
+
+  //  there is no AAAA record: an NSEC says so, with our A record added
+  MDNSPacket aaaa;
+  aaaa.question("restduino.local", MDNS_TYPE_AAAA);
+  count = exchange(aaaa);
+  CHECK_EQUAL(2, count);
+  record = find(count, MDNS_TYPE_NSEC);
+  CHECK(record != NULL && !strcmp("restduino.local", record->name));
+  CHECK(find(count, MDNS_TYPE_A, 3) != NULL);
+
+  //  a QU question for the service, multicast a moment ago, is answered
+  //  by unicast: our A record is added, unless the querier knows it
+  MDNSPacket qu;
+  qu.question("_http._tcp.local", MDNS_TYPE_PTR, true);
+  CHECK_EQUAL(4, exchange(qu));
+  CHECK(find(4, MDNS_TYPE_A, 3) != NULL);
+  count = exchange(qu, 100);
+  CHECK_EQUAL(4, count);
+  CHECK(find(count, MDNS_TYPE_A, 3) != NULL);
+
+  MDNSPacket quKnownA;
+  quKnownA.compress = true;
+  quKnownA.question("_http._tcp.local", MDNS_TYPE_PTR, true);
+  quKnownA.answer("restduino.local", MDNS_TYPE_A, 120, address, 4);
+  count = exchange(quKnownA, 100);
+  CHECK_EQUAL(3, count);
+  CHECK(find(count, MDNS_TYPE_A, 3) == NULL);
+
+  //  a new service is announced with its SRV, TXT and both PTRs, our A
+  //  record added, and each name is written out once, pointed to after
+  hostAdvanceTime(1100);
+  CHECK(EthernetBonjour.addServiceRecord("RESTduino._ipp", 631, MDNSServiceTCP, "\x04q=ok"));
+  replyLength = mdnsHarnessReceive(reply, sizeof(reply), 200);
+  CHECK(replyLength > 0);
+  count = mdnsRecords(reply, replyLength, records, 16);
+  CHECK_EQUAL(5, count);
+  record = findNamed(count, MDNS_TYPE_SRV, "RESTduino._ipp._tcp.local");
+  CHECK(record != NULL && !strcmp("restduino.local", record->target));
+  CHECK(findNamed(count, MDNS_TYPE_TXT, "RESTduino._ipp._tcp.local") != NULL);
+  record = findNamed(count, MDNS_TYPE_PTR, "_services._dns-sd._udp.local");
+  CHECK(record != NULL && !strcmp("_ipp._tcp.local", record->target));
+  record = findNamed(count, MDNS_TYPE_PTR, "_ipp._tcp.local");
+  CHECK(record != NULL && !strcmp("RESTduino._ipp._tcp.local", record->target));
+  CHECK(find(count, MDNS_TYPE_A, 3) != NULL);
+  CHECK_EQUAL(1, occurrences(reply, replyLength, "\x09RESTduino\x04_ipp"));
+  CHECK_EQUAL(1, occurrences(reply, replyLength, "\x09restduino"));
+  CHECK_EQUAL(1, occurrences(reply, replyLength, "\x04_tcp"));
+
+  return checkResult("test_mdns_answers");
+}
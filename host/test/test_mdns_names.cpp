@@ -0,0 +1,108 @@
+//  which questions EthernetBonjour takes as asking for its names, with
+//  service registration compiled in: the host name, a service type
+//  and the DNS-SD service enumeration, in any case, and nothing that
+//  merely starts or ends like them. Also the limits setBonjourName()
+//  puts on names.
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetBonjour.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "mdns_harness.h"
+
+static uint8_t reply[1500];
+static MDNSRecord records[16];
+
+static int ask(const char *name, uint16_t type)
+{
+  MDNSPacket packet;
+  packet.question(name, type);
+
+  //  past the once a second limit on multicasting a record
+  hostAdvanceTime(1100);
+  CHECK(mdnsHarnessSend(packet));
+
+  //  service answers are delayed by up to 120 ms
+  int length = mdnsHarnessReceive(reply, sizeof(reply), 200);
+  if(length < 0){
+    return 0;
+  }
+  int count = mdnsRecords(reply, length, records, 16);
+  CHECK(count >= 0);
+  return count;
+}
+
+static const MDNSRecord *find(int count, uint16_t type, int section = 1)
+{
+  for(int i = 0; i < count; i++){
+    if(records[i].type == type && records[i].section == section){
+      return &records[i];
+    }
+  }
+  return NULL;
+}
+
+int main()
+{
+  const MDNSRecord *record;
+  int count;
+
+  mdnsHarnessBegin("restduino");
+  CHECK(EthernetBonjour.addServiceRecord("RESTduino._http", 80, MDNSServiceTCP, "\x06path=/"));
+  mdnsHarnessDrain(50);
+
+  //  the host name, in any case
+  CHECK_EQUAL(1, ask("restduino.local", MDNS_TYPE_A));
+  CHECK_EQUAL(1, ask("RESTDUINO.Local", MDNS_TYPE_A));
+  CHECK(!strcmp("restduino.local", records[0].name));
+
+  //  a service type: its PTR, SRV and TXT, with our address added
+  count = ask("_HTTP._tcp.LOCAL", MDNS_TYPE_PTR);
+  CHECK_EQUAL(4, count);
+  record = find(count, MDNS_TYPE_PTR);
+  CHECK(record != NULL && !strcmp("RESTduino._http._tcp.local", record->target));
+  record = find(count, MDNS_TYPE_SRV);
+  CHECK(record != NULL && !strcmp("restduino.local", record->target));
+  CHECK(find(count, MDNS_TYPE_TXT) != NULL);
+  CHECK(find(count, MDNS_TYPE_A, 3) != NULL);
+
+  //  the enumeration of service types gets the type PTRs only
+  count = ask("_services._dns-sd._udp.local", MDNS_TYPE_PTR);
+  CHECK_EQUAL(1, count);
+  record = find(count, MDNS_TYPE_PTR);
+  CHECK(record != NULL && !strcmp("_http._tcp.local", record->target));
+
+  //  names that start or end like ours, or have the same length
+  CHECK_EQUAL(0, ask("restduino2.local", MDNS_TYPE_A));
+  CHECK_EQUAL(0, ask("duino.local", MDNS_TYPE_A));
+  CHECK_EQUAL(0, ask("restduino.local.local", MDNS_TYPE_A));
+  CHECK_EQUAL(0, ask("restduinx.local", MDNS_TYPE_A));
+  CHECK_EQUAL(0, ask("restduino.locam", MDNS_TYPE_A));
+  CHECK_EQUAL(0, ask("_https._tcp.local", MDNS_TYPE_PTR));
+  CHECK_EQUAL(0, ask("_http._udp.local", MDNS_TYPE_PTR));
+  CHECK_EQUAL(0, ask("_http.local", MDNS_TYPE_PTR));
+
+  //  labels of up to 63 bytes, whole names of up to 72 on the wire
+  char name[80];
+  memset(name, 'a', 64);
+  name[64] = '\0';
+  CHECK(!EthernetBonjour.setBonjourName(name));
+  name[63] = '\0';
+  CHECK(EthernetBonjour.setBonjourName(name));
+  strcat(name, ".local");
+  CHECK_EQUAL(1, ask(name, MDNS_TYPE_A));
+
+  memset(name, 'b', 70);
+  name[40] = '.';
+  name[70] = '\0';
+  CHECK(!EthernetBonjour.setBonjourName(name));
+
+  CHECK(EthernetBonjour.setBonjourName("RESTduino"));
+  CHECK_EQUAL(1, ask("restduino.local", MDNS_TYPE_A));
+
+  return checkResult("test_mdns_names");
+}
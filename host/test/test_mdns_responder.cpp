@@ -0,0 +1,133 @@
+//  how EthernetBonjour answers (RFC 6762, sections 5.4 and 6): QU
+//  questions by unicast from a socket of their own once the record
+//  has been multicast recently, by multicast otherwise or when no
+//  socket is free, and no record multicast twice within a second.
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetBonjour.h>
+#include <HostBoard.h>
+#include <utility/EthernetCompat.h>
+#include <utility/socket.h>
+
+#include "W5100Sim.h"
+#include "check.h"
+#include "mdns_harness.h"
+
+#define GROUP 0xFB0000E0UL  //  224.0.0.251 in network order
+
+static uint8_t reply[1500];
+static uint32_t replyFrom;
+static uint32_t replyTo;
+static uint32_t uncounted;
+
+//  sends the packet after ms and returns the number of records in the
+//  reply, 0 if there is none
+static int exchange(const MDNSPacket &packet, unsigned long ms = 1100)
+{
+  MDNSRecord records[8];
+
+  hostAdvanceTime(ms);
+  CHECK(mdnsHarnessSend(packet));
+
+  int length = mdnsHarnessReceive(reply, sizeof(reply), 20, &replyFrom, &replyTo);
+  uncounted = W5100Chip.frames() - ethernet_compat_spi_transactions();
+  if(length < 0){
+    return 0;
+  }
+  int count = mdnsRecords(reply, length, records, 8);
+  CHECK(count >= 0);
+  return count;
+}
+
+int main()
+{
+  mdnsHarnessBegin("restduino");
+
+  IPAddress ip = Ethernet.localIP();
+  uint32_t address;
+  memcpy(&address, &ip[0], 4);
+
+  MDNSPacket qu;
+  qu.question("restduino.local", MDNS_TYPE_A, true);
+  MDNSPacket qm;
+  qm.question("restduino.local", MDNS_TYPE_A);
+
+  //  not multicast yet, so everyone gets it
+  CHECK_EQUAL(1, exchange(qu));
+  CHECK_EQUAL(GROUP, replyTo);
+  CHECK_EQUAL(0, uncounted);
+
+  //  multicast a second ago: only the querier gets it, from the chip's
+  //  address, and the multicast socket is left as it was. Opening the
+  //  reply's socket goes through the Ethernet library, the compat layer
+  //  doesn't count those frames. The next run() closes it.
+  CHECK_EQUAL(1, exchange(qu));
+  CHECK(replyTo != GROUP);
+  CHECK_EQUAL(address, replyFrom);
+  CHECK(uncounted > 0);
+  CHECK_EQUAL(SnSR::UDP, W5100.readSnSR(mdnsHarnessSocket()));
+  EthernetBonjour.run();
+  for(int s = 0; s < MAX_SOCK_NUM; s++){
+    if(s != mdnsHarnessSocket()){
+      CHECK_EQUAL(SnSR::CLOSED, W5100.readSnSR(s));
+    }
+  }
+
+  //  a multicast query for the same record goes to the group still
+  CHECK_EQUAL(1, exchange(qm));
+  CHECK_EQUAL(GROUP, replyTo);
+  CHECK_EQUAL(0, uncounted);
+
+  //  but not twice within a second
+  CHECK_EQUAL(0, exchange(qm, 200));
+  CHECK_EQUAL(1, exchange(qm, 1000));
+
+  //  a quarter of the TTL on, everyone gets it again
+  hostAdvanceTime(31000);
+  CHECK_EQUAL(1, exchange(qu));
+  CHECK_EQUAL(GROUP, replyTo);
+
+  //  with the other sockets taken, the unicast answer is multicast
+  for(int s = 0; s < MAX_SOCK_NUM; s++){
+    if(s != mdnsHarnessSocket()){
+      socket(s, SnMR::TCP, 4000 + s, 0);
+    }
+  }
+  CHECK_EQUAL(1, exchange(qu));
+  CHECK_EQUAL(GROUP, replyTo);
+  CHECK_EQUAL(0, uncounted);
+  for(int s = 0; s < MAX_SOCK_NUM; s++){
+    if(s != mdnsHarnessSocket()){
+      close(s);
+    }
+  }
+
+  //  a querier that doesn't answer ARP gets nothing, the chip gives up
+  //  on the reply and run() carries on and closes its socket
+  W5100Chip.failArp(true);
+  CHECK_EQUAL(0, exchange(qu));
+  EthernetBonjour.run();
+  for(int s = 0; s < MAX_SOCK_NUM; s++){
+    if(s != mdnsHarnessSocket()){
+      CHECK_EQUAL(SnSR::CLOSED, W5100.readSnSR(s));
+      CHECK_EQUAL(0, W5100.readSnIR(s) & (SnIR::SEND_OK | SnIR::TIMEOUT));
+    }
+  }
+  W5100Chip.failArp(false);
+  CHECK_EQUAL(1, exchange(qu));
+  CHECK(replyTo != GROUP);
+  EthernetBonjour.run();
+
+  //  nothing received, nothing sent: run() only asks for the RX size
+  hostAdvanceTime(1100);
+  W5100Chip.resetCounters();
+  ethernet_compat_reset_spi_transactions();
+  EthernetBonjour.run();
+  CHECK_EQUAL(2, ethernet_compat_spi_transactions());
+  CHECK_EQUAL(-1, mdnsHarnessReceive(reply, sizeof(reply), 20));
+
+  return checkResult("test_mdns_responder");
+}
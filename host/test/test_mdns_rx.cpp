@@ -0,0 +1,130 @@
+//  EthernetBonjour's parsing of received packets, built once with the
+//  Uno's default MDNS_RX_BUFFER_SIZE (0, every read goes to the chip)
+//  and once with the RX cache of the larger boards: the answers must
+//  be the same, and the compat layer must count every frame the chip
+//  sees.
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <EthernetBonjour.h>
+#include <HostBoard.h>
+#include <utility/EthernetCompat.h>
+
+#include "W5100Sim.h"
+#include "check.h"
+#include "mdns_harness.h"
+
+static uint8_t reply[1500];
+static MDNSRecord records[16];
+
+//  sends the packet, runs the library once and returns the number of
+//  records in its reply, 0 if there is none
+static int exchange(const MDNSPacket &packet)
+{
+  hostAdvanceTime(1100);
+  CHECK(mdnsHarnessSend(packet));
+
+  EthernetBonjour.run();
+  CHECK_EQUAL(W5100Chip.frames(), ethernet_compat_spi_transactions());
+
+  int length = mdnsHarnessReceive(reply, sizeof(reply), 20);
+  if(length < 0){
+    return 0;
+  }
+  int count = mdnsRecords(reply, length, records, 16);
+  CHECK(count >= 0);
+  return count;
+}
+
+//  the reply has our address, and an NSEC record for the AAAA questions
+static void checkAddress(int count)
+{
+  IPAddress ip = Ethernet.localIP();
+  int found = 0;
+
+  CHECK(count >= 1);
+  for(int i = 0; i < count; i++){
+    CHECK(!strcmp("restduino.local", records[i].name));
+    if(records[i].type != MDNS_TYPE_A){
+      CHECK_EQUAL(MDNS_TYPE_NSEC, records[i].type);
+      continue;
+    }
+    found++;
+    CHECK_EQUAL(4, records[i].length);
+    for(int j = 0; j < 4 && records[i].length == 4; j++){
+      CHECK_EQUAL(ip[j], records[i].data[j]);
+    }
+  }
+  CHECK_EQUAL(1, found);
+}
+
+int main()
+{
+  mdnsHarnessBegin("restduino");
+
+  MDNSPacket ours;
+  ours.question("restduino.local", MDNS_TYPE_A);
+  checkAddress(exchange(ours));
+
+  MDNSPacket upper;
+  upper.question("RESTduino.LOCAL", MDNS_TYPE_A);
+  checkAddress(exchange(upper));
+
+  MDNSPacket other;
+  other.question("printer.local", MDNS_TYPE_A);
+  CHECK_EQUAL(0, exchange(other));
+
+  //  the question's name is a pointer to the first one
+  MDNSPacket second;
+  second.compress = true;
+  second.question("printer.local", MDNS_TYPE_A);
+  second.question("restduino.local", MDNS_TYPE_A);
+  second.question("restduino.local", MDNS_TYPE_AAAA);
+  checkAddress(exchange(second));
+
+  //  the known answer is the cached question's name
+  MDNSPacket known;
+  known.compress = true;
+  known.question("restduino.local", MDNS_TYPE_A);
+  IPAddress ip = Ethernet.localIP();
+  uint8_t address[4] = { ip[0], ip[1], ip[2], ip[3] };
+  known.answer("restduino.local", MDNS_TYPE_A, 120, address, 4);
+  CHECK_EQUAL(0, exchange(known));
+
+  //  longer than the cache: the last question points back into it from
+  //  past its end
+  MDNSPacket longer;
+  longer.compress = true;
+  longer.question("restduino.local", MDNS_TYPE_AAAA);
+  for(int i = 0; i < 20; i++){
+    char name[32];
+    snprintf(name, sizeof(name), "host-number-%02d.local", i);
+    longer.question(name, MDNS_TYPE_A);
+  }
+  longer.question("restduino.local", MDNS_TYPE_A);
+  CHECK(longer.length > 256);
+  checkAddress(exchange(longer));
+
+  //  a pointer to itself, and a name that runs off the end
+  MDNSPacket loop;
+  loop.question("restduino.local", MDNS_TYPE_A);
+  loop.data[12] = 0xc0;
+  loop.data[13] = 12;
+  CHECK_EQUAL(0, exchange(loop));
+
+  MDNSPacket truncated;
+  truncated.question("restduino.local", MDNS_TYPE_A);
+  truncated.length -= 6;
+  CHECK_EQUAL(0, exchange(truncated));
+
+  //  still answering after the bad ones
+  checkAddress(exchange(ours));
+
+#if defined(MDNS_RX_BUFFER_SIZE)
+  return checkResult("test_mdns_rx_buffered");
+#else
+  return checkResult("test_mdns_rx");
+#endif
+}
@@ -0,0 +1,119 @@
+//  the sketch's request parser fed a byte at a time, as serviceConnection()
+//  feeds it from the socket: the method, path segments and query string
+//  it hands out, keep-alive, and requests it takes as bad
+
+#include <string.h>
+
+#include "../sketch.cpp"
+
+#include "check.h"
+
+static Request req;
+
+//  feeds text until the parser is done; the bytes it took
+static int feed(const char *text)
+{
+  int n = 0;
+
+  resetRequest(&req);
+  while(text[n] != '\0'){
+    if(parseRequest(&req, text[n++]) == PARSE_DONE){
+      break;
+    }
+  }
+  return n;
+}
+
+static bool segmentsAre(const char *a, const char *b = NULL, const char *c = NULL)
+{
+  const char *expected[] = { a, b, c };
+  byte count = 0;
+
+  while(count < 3 && expected[count] != NULL){
+    count++;
+  }
+  if(req.segmentCount != count){
+    return false;
+  }
+  for(byte i = 0; i < count; i++){
+    if(strcmp(req.segments[i], expected[i]) != 0){
+      return false;
+    }
+  }
+  return true;
+}
+
+int main()
+{
+  const char *get = "GET /13/high HTTP/1.1\r\nHost: restduino\r\n\r\n";
+  int length = strlen(get);
+
+  //  the whole request is taken, nothing past its blank line
+  CHECK_EQUAL(length, feed(get));
+  CHECK_EQUAL(PARSE_DONE, req.state);
+  CHECK(!req.error);
+  CHECK(!strcmp("GET", req.method));
+  CHECK(segmentsAre("13", "HIGH"));
+  CHECK(req.query == NULL);
+  CHECK(req.keepAlive);
+  CHECK(req.chunked);
+
+  //  pipelined: the second request is left on the socket
+  char pipelined[256];
+  strcpy(pipelined, get);
+  strcat(pipelined, "GET /8 HTTP/1.1\r\n\r\n");
+  CHECK_EQUAL(length, feed(pipelined));
+  CHECK_EQUAL(strlen(pipelined) - length, feed(pipelined + length));
+  CHECK(segmentsAre("8"));
+
+  //  the query string, and runs of slashes
+  feed("GET //BATCH//?2=high&a0 HTTP/1.1\r\n\r\n");
+  CHECK(segmentsAre("BATCH"));
+  CHECK(req.query != NULL && !strcmp("2=HIGH&A0", req.query));
+
+  feed("GET /a0/history/ HTTP/1.1\r\n\r\n");
+  CHECK(segmentsAre("A0", "HISTORY"));
+
+  //  HTTP/1.0 closes unless asked not to, HTTP/1.1 when asked to
+  feed("GET /8 HTTP/1.0\r\n\r\n");
+  CHECK(!req.keepAlive);
+  CHECK(!req.chunked);
+  feed("GET /8 HTTP/1.0\r\nCONNECTION: Keep-Alive\r\n\r\n");
+  CHECK(req.keepAlive);
+  feed("GET /8 HTTP/1.1\r\nUser-Agent: x\r\nConnection: close\r\n\r\n");
+  CHECK(!req.keepAlive);
+  feed("GET /8 HTTP/1.1\r\nX-Connection: close\r\n\r\n");
+  CHECK(req.keepAlive);
+
+  //  blank lines ahead of a request, and a request line on its own
+  feed("\r\n\r\nGET /8 HTTP/1.1\r\n\r\n");
+  CHECK(!req.error && segmentsAre("8"));
+  CHECK_EQUAL(7, feed("GET /8\nHost: x\r\n\r\n"));
+  CHECK(!req.error && segmentsAre("8"));
+
+  //  segments past MAXSEGMENTS are dropped, the path is kept whole
+  feed("GET /1/2/3/4/5/6/7 HTTP/1.1\r\n\r\n");
+  CHECK(!req.error);
+  CHECK_EQUAL(MAXSEGMENTS, req.segmentCount);
+  CHECK(!strcmp("5", req.segments[MAXSEGMENTS - 1]));
+
+  //  a request line that doesn't fit is bad, not cut short
+  char longPath[BUFSIZE + 64] = "GET /";
+  memset(longPath + 5, 'x', BUFSIZE);
+  strcpy(longPath + 5 + BUFSIZE, " HTTP/1.1\r\n\r\n");
+  feed(longPath);
+  CHECK_EQUAL(PARSE_DONE, req.state);
+  CHECK(req.error);
+
+  //  long headers are skipped over
+  char longHeader[1024] = "GET /8 HTTP/1.1\r\nCookie: ";
+  memset(longHeader + strlen(longHeader), 'c', 900);
+  strcat(longHeader, "\r\n\r\n");
+  feed(longHeader);
+  CHECK(!req.error && segmentsAre("8"));
+
+  feed("GET\r\n");
+  CHECK(req.error);
+
+  return checkResult("test_request_parser");
+}
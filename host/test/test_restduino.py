@@ -0,0 +1,85 @@
+#  the sketch on the host build, over real sockets: HTTP requests on
+#  new and kept-alive connections, and its mDNS name
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import harness
+
+
+class RestduinoTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.board = harness.Restduino().__enter__()
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.board.__exit__()
+
+    def test_write_then_read_pin(self):
+        status, _, _ = self.board.get('/8/HIGH')
+        self.assertEqual(status, 200)
+        status, _, body = self.board.get('/8')
+        self.assertEqual(status, 200)
+        self.assertEqual(body, '{"8":"HIGH"}')
+
+    def test_keep_alive(self):
+        connection = self.board.connect()
+        try:
+            for level in ('HIGH', 'LOW', 'HIGH'):
+                status, _, _ = connection.get('/9/' + level)
+                self.assertEqual(status, 200)
+                status, _, body = connection.get('/9')
+                self.assertEqual(body, '{"9":"%s"}' % level)
+        finally:
+            connection.close()
+
+    def test_pipelined(self):
+        connection = self.board.connect()
+        try:
+            for path in ('/9/HIGH', '/9', '/9/LOW', '/9'):
+                connection.send(path)
+            bodies = [connection.response() for _ in range(4)]
+        finally:
+            connection.close()
+        self.assertEqual([status for status, _, _ in bodies], [200] * 4)
+        self.assertEqual(bodies[1][2], '{"9":"HIGH"}')
+        self.assertEqual(bodies[3][2], '{"9":"LOW"}')
+
+    def test_connection_close(self):
+        connection = self.board.connect()
+        try:
+            status, headers, _ = connection.get('/8', close=True)
+            self.assertEqual(status, 200)
+            self.assertRaises(EOFError, connection.response)
+        finally:
+            connection.close()
+
+    def test_connections_back_to_back(self):
+        #  the server hands a reaped socket to the next client while
+        #  the sketch may still be closing its last connection on it
+        for i in range(40):
+            level = ('HIGH', 'LOW')[i % 2]
+            status, _, _ = self.board.get('/7/' + level)
+            self.assertEqual(status, 200)
+            status, _, body = self.board.get('/7')
+            self.assertEqual(body, '{"7":"%s"}' % level)
+
+    def test_mdns_address(self):
+        querier = harness.MDNSQuerier()
+        try:
+            reply = querier.ask(harness.mdns_query('restduino.local'), timeout=2.0)
+        finally:
+            querier.close()
+        self.assertIsNotNone(reply)
+        _, flags, records = harness.mdns_records(reply[1])
+        self.assertTrue(flags & 0x8400)
+        addresses = [r[4] for r in records if r[0] == 'restduino.local' and r[1] == 1]
+        self.assertEqual(addresses, [bytes([127, 0, 0, 1])])
+
+
+if __name__ == '__main__':
+    unittest.main()
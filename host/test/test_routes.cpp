@@ -0,0 +1,29 @@
+//  the sketch's route table: each route's name finds its handler,
+//  and anything else, pins and names that merely hash like a route,
+//  goes to the pin handler
+
+#include "../sketch.cpp"
+
+#include "check.h"
+
+int main()
+{
+  CHECK(findRoute("PORT") == routePorts);
+  CHECK(findRoute("D*") == routePorts);
+  CHECK(findRoute("BATCH") == routeBatch);
+  CHECK(findRoute("EVENTS") == openEventStream);
+  CHECK(findRoute("STATE") == routeState);
+  CHECK(findRoute("CAPTURE") == routeCapture);
+  CHECK(findRoute("PWM") == routePwm);
+
+  //  pins, and names with a route's first letter and length
+  static const char *others[] = {
+    "13", "A0", "D13", "PORTS", "POST", "D", "BATCHES", "EVENT", "STATS", "CAPTURED",
+    "PWN", ""
+  };
+  for(unsigned i = 0; i < sizeof(others) / sizeof(others[0]); i++){
+    CHECK(findRoute(others[i]) == routePin);
+  }
+
+  return checkResult("test_routes");
+}
@@ -0,0 +1,134 @@
+//  the analog scanner on the simulated ADC: /An reads the latest
+//  conversion without stopping the scan, /An/HISTORY holds one sample
+//  every HISTORY_INTERVAL ms with their minimum, maximum and mean, and
+//  oversampling widens the readings and clears the history
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+static char body[1024];
+
+//  the number after key in the last response, or -1
+static long number(const char *key)
+{
+  const char *at = strstr(body, key);
+  if(at == NULL){
+    return -1;
+  }
+  at += strlen(key);
+  if(*at == '"'){
+    at++;
+  }
+  return strtol(at, NULL, 10);
+}
+
+//  the samples of the last /An/HISTORY response
+static int samples(long *values, int max)
+{
+  const char *at = strstr(body, "\"SAMPLES\":[");
+  int n = 0;
+
+  if(at == NULL){
+    return -1;
+  }
+  at += 11;
+  while(*at != ']' && n < max){
+    char *end;
+    values[n++] = strtol(at, &end, 10);
+    at = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+int main()
+{
+  long values[32];
+  int count;
+
+  sketchBegin();
+
+  //  a second's worth of conversions fills the history
+  hostSetAnalog(0, 512);
+  hostSetAnalog(1, 100);
+  hostAdvanceTime(1000);
+
+  CHECK_EQUAL(200, sketchGet("/A0", body, sizeof(body)));
+  CHECK_EQUAL(512, number("\"A0\":"));
+  CHECK(strstr(body, "BITS") == NULL);
+  CHECK_EQUAL(200, sketchGet("/A1", body, sizeof(body)));
+  CHECK_EQUAL(100, number("\"A1\":"));
+
+  //  reading leaves the scan running
+  CHECK(ADCSRA & _BV(ADIE));
+
+  CHECK_EQUAL(200, sketchGet("/A0/HISTORY", body, sizeof(body)));
+  CHECK_EQUAL(100, number("\"INTERVAL\":"));
+  CHECK_EQUAL(10, number("\"BITS\":"));
+  count = samples(values, 32);
+  CHECK(count >= 8);
+  for(int i = 0; i < count; i++){
+    CHECK_EQUAL(512, values[i]);
+  }
+  CHECK_EQUAL(512, number("\"MIN\":"));
+  CHECK_EQUAL(512, number("\"MAX\":"));
+  CHECK_EQUAL(512, number("\"MEAN\":"));
+
+  //  a step: the newest samples take the new level, the oldest keep
+  //  the old one
+  hostSetAnalog(0, 300);
+  hostAdvanceTime(350);
+  CHECK_EQUAL(200, sketchGet("/A0", body, sizeof(body)));
+  CHECK_EQUAL(300, number("\"A0\":"));
+  CHECK_EQUAL(200, sketchGet("/A0/HISTORY", body, sizeof(body)));
+  count = samples(values, 32);
+  CHECK(count >= 8);
+  CHECK_EQUAL(512, values[0]);
+  CHECK_EQUAL(300, values[count - 1]);
+  CHECK_EQUAL(300, number("\"MIN\":"));
+  CHECK_EQUAL(512, number("\"MAX\":"));
+  long mean = number("\"MEAN\":");
+  CHECK(mean > 300 && mean < 512);
+
+  //  4x oversampling gives 11 bit readings and starts a new history;
+  //  with interrupts off no conversion comes in between to refill it
+  cli();
+  CHECK_EQUAL(200, sketchGet("/A0?OS=4", body, sizeof(body)));
+  CHECK_EQUAL(11, number("\"BITS\":"));
+  CHECK_EQUAL(200, sketchGet("/A0/HISTORY", body, sizeof(body)));
+  CHECK_EQUAL(11, number("\"BITS\":"));
+  CHECK(strstr(body, "MIN") == NULL && strstr(body, "MAX") == NULL &&
+    strstr(body, "MEAN") == NULL);
+  CHECK_EQUAL(0, samples(values, 32));
+  sei();
+
+  hostAdvanceTime(1000);
+  CHECK_EQUAL(200, sketchGet("/A0", body, sizeof(body)));
+  CHECK_EQUAL(600, number("\"A0\":"));
+  CHECK_EQUAL(200, sketchGet("/A0/HISTORY", body, sizeof(body)));
+  CHECK_EQUAL(600, number("\"MIN\":"));
+  CHECK_EQUAL(600, number("\"MAX\":"));
+
+  //  an average over 2^4 readings follows a step part of the way
+  CHECK_EQUAL(200, sketchGet("/A1?OS=1&EMA=4", body, sizeof(body)));
+  hostAdvanceTime(1000);
+  hostSetAnalog(1, 900);
+  hostAdvanceTime(1);
+  CHECK_EQUAL(200, sketchGet("/A1", body, sizeof(body)));
+  long smoothed = number("\"A1\":");
+  CHECK(smoothed > 100 && smoothed < 900);
+  hostAdvanceTime(1000);
+  CHECK_EQUAL(200, sketchGet("/A1", body, sizeof(body)));
+  CHECK(number("\"A1\":") >= 890);
+
+  //  settings the scanner can't take
+  CHECK_EQUAL(400, sketchGet("/A0?OS=3", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/A0?EMA=9", body, sizeof(body)));
+
+  return checkResult("test_sketch_analog");
+}
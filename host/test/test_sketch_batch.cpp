@@ -0,0 +1,63 @@
+//  /BATCH on the simulated board: the writes and reads of a query are
+//  applied in order and answered in one object, and a query with a
+//  pin the board lacks or a value a pin can't take is refused before
+//  any pin is touched
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+static char body[1024];
+
+int main()
+{
+  sketchBegin();
+
+  hostSetAnalog(0, 432);
+  hostSetAnalog(1, 517);
+  hostDrivePin(2, HIGH);
+  hostAdvanceTime(100);
+
+  //  writes and reads, in the order given
+  CHECK_EQUAL(200, sketchGet("/BATCH?D9=HIGH&D5=128&A0&A1&D2", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"D9\":\"HIGH\",\"D5\":\"128\",\"A0\":\"432\",\"A1\":\"517\",\"D2\":\"HIGH\"}"));
+  CHECK(DDRB & _BV(1));
+  CHECK(PORTB & _BV(1));
+  CHECK(DDRD & _BV(5));
+  CHECK_EQUAL(128, OCR0B);
+  CHECK(TCCR0A & _BV(COM0B1));
+
+  //  a pin written earlier in the query reads back what was written
+  CHECK_EQUAL(200, sketchGet("/BATCH?D7=HIGH&D7&D9=LOW&D9", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"D7\":\"HIGH\",\"D7\":\"HIGH\",\"D9\":\"LOW\",\"D9\":\"LOW\"}"));
+  CHECK_EQUAL(0, PORTB & _BV(1));
+
+  //  empty parameters are skipped, an empty query is an empty object
+  CHECK_EQUAL(200, sketchGet("/BATCH?&D5&", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"D5\":\"128\"}"));
+  CHECK_EQUAL(200, sketchGet("/BATCH", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{}"));
+
+  //  refused as a whole: the Ethernet shield's select on 4 and a pin
+  //  the Uno lacks are 404, a PWM value on a pin without PWM or out of
+  //  range is 400, and pin 6 before them is left alone
+  CHECK_EQUAL(404, sketchGet("/BATCH?D6=HIGH&D4=LOW", body, sizeof(body)));
+  CHECK_EQUAL(404, sketchGet("/BATCH?D6=HIGH&D20", body, sizeof(body)));
+  CHECK_EQUAL(404, sketchGet("/BATCH?D6=HIGH&A8", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/BATCH?D6=HIGH&D8=128", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/BATCH?D6=HIGH&D5=256", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/BATCH?D6=HIGH&D5=HALF", body, sizeof(body)));
+  CHECK_EQUAL(0, DDRD & _BV(6));
+  CHECK_EQUAL(0, PORTD & _BV(6));
+  CHECK_EQUAL(128, OCR0B);
+
+  //  a URL longer than the Uno's request buffer is 404
+  CHECK_EQUAL(404, sketchGet("/BATCH?D2&D3&D5&D6&D7&D8&D9&A0&A1&A2&A3&A4&A5"
+    "&D2&D3&D5&D6&D7&D8&D9&A0&A1&A2&A3&A4&A5&D2&D3&D5&D6&D7&D8&D9&A0", body, sizeof(body)));
+
+  return checkResult("test_sketch_batch");
+}
@@ -0,0 +1,153 @@
+//  the logic capture on the simulated Timer2: a triggered capture waits
+//  for its edge and stores the port as runs, stopping once the Uno's
+//  32 runs are full, a free running one keeps the latest 32, and the
+//  timer behind PWM on pin 3 is busy until the capture is over
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+#define CAPTURESIZE 32
+
+static char body[1024];
+
+//  the number after key in the last response, or -1
+static long number(const char *key)
+{
+  const char *at = strstr(body, key);
+  return (at != NULL) ? strtol(at + strlen(key), NULL, 10) : -1;
+}
+
+//  the values and lengths of the runs in the last /CAPTURE/DATA
+static int runs(long *values, long *lengths, int max)
+{
+  const char *at = strstr(body, "\"RUNS\":[");
+  int n = 0;
+
+  if(at == NULL){
+    return -1;
+  }
+  at += 8;
+  while(*at != ']' && n < max){
+    char *end;
+    values[n] = strtol(at, &end, 10);
+    lengths[n++] = strtol(end + 1, &end, 10);
+    at = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+static bool state(const char *name)
+{
+  char entry[32] = "\"STATE\":\"";
+  strcat(entry, name);
+  strcat(entry, "\"");
+  return strstr(body, entry) != NULL;
+}
+
+int main()
+{
+  static const int levels[] = { 1, 0, 1, 0 };
+  static const int times[] = { 3, 5, 2, 4 };
+  long values[64], lengths[64];
+  int count;
+
+  sketchBegin();
+
+  CHECK_EQUAL(200, sketchGet("/CAPTURE", body, sizeof(body)));
+  CHECK(state("IDLE"));
+  CHECK_EQUAL(0, number("\"COUNT\":"));
+
+  //  the pin, the rate and the edge are checked before the timer is
+  //  taken
+  CHECK_EQUAL(400, sketchGet("/CAPTURE/ARM?RATE=1000", body, sizeof(body)));
+  CHECK_EQUAL(404, sketchGet("/CAPTURE/ARM?PIN=D4", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/CAPTURE/ARM?PIN=D2&RATE=60000", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/CAPTURE/ARM?PIN=D2&RATE=0", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/CAPTURE/ARM?PIN=D2&EDGE=UP", body, sizeof(body)));
+  CHECK_EQUAL(404, sketchGet("/CAPTURE/START", body, sizeof(body)));
+  CHECK_EQUAL(0, TIMSK2);
+
+  //  a capture on the rising edge of pin 2, a sample a millisecond
+  hostDrivePin(2, LOW);
+  CHECK_EQUAL(200, sketchGet("/CAPTURE/ARM?PIN=D2&RATE=1000&EDGE=RISE", body, sizeof(body)));
+  CHECK(state("ARMED"));
+  CHECK_EQUAL(1000, number("\"RATE\":"));
+  CHECK_EQUAL(400, sketchGet("/D3/128", body, sizeof(body)));
+
+  //  nothing is stored until the edge
+  hostAdvanceTime(20);
+  CHECK_EQUAL(200, sketchGet("/CAPTURE", body, sizeof(body)));
+  CHECK(state("ARMED"));
+  CHECK_EQUAL(0, number("\"COUNT\":"));
+
+  for(int i = 0; i < 4; i++){
+    hostDrivePin(2, levels[i]);
+    hostAdvanceTime(times[i]);
+  }
+  CHECK_EQUAL(200, sketchGet("/CAPTURE/DATA", body, sizeof(body)));
+  CHECK(state("DONE"));
+  CHECK(strstr(body, "\"PINS\":[0,1,2,3,4,5,6,7]") != NULL);
+  count = runs(values, lengths, 64);
+  CHECK_EQUAL(4, count);
+  CHECK_EQUAL(4, number("\"COUNT\":"));
+  for(int i = 0; i < count; i++){
+    CHECK_EQUAL(levels[i] ? _BV(2) : 0, values[i] & _BV(2));
+    //  the last run goes on until the request stops it
+    if(i < count - 1){
+      CHECK(labs(lengths[i] - times[i]) <= 1);
+    }
+  }
+
+  //  the timer is put back as the core had it, and PWM on pin 3 works
+  CHECK_EQUAL(0, TIMSK2);
+  CHECK_EQUAL(_BV(WGM20), TCCR2A);
+  CHECK_EQUAL(_BV(CS22), TCCR2B);
+  CHECK_EQUAL(200, sketchGet("/D3/128", body, sizeof(body)));
+
+  //  a triggered capture stops with its runs full, keeping the first
+  CHECK_EQUAL(200, sketchGet("/CAPTURE/ARM?PIN=D2&RATE=1000&EDGE=ANY", body, sizeof(body)));
+  for(int i = 0; i < 2 * CAPTURESIZE; i++){
+    hostDrivePin(2, (i & 1) == 0);
+    hostAdvanceTime(2);
+  }
+  CHECK_EQUAL(200, sketchGet("/CAPTURE", body, sizeof(body)));
+  CHECK(state("DONE"));
+  CHECK_EQUAL(CAPTURESIZE, number("\"COUNT\":"));
+  CHECK_EQUAL(0, TIMSK2);
+  CHECK_EQUAL(200, sketchGet("/CAPTURE/DATA", body, sizeof(body)));
+  count = runs(values, lengths, 64);
+  CHECK_EQUAL(CAPTURESIZE, count);
+  for(int i = 0; i < count; i++){
+    CHECK_EQUAL((i & 1) == 0 ? _BV(2) : 0, values[i] & _BV(2));
+  }
+
+  //  a free running capture keeps the latest runs, the last one with
+  //  the level the pin was left at
+  CHECK_EQUAL(200, sketchGet("/CAPTURE/ARM?PIN=D2&RATE=1000", body, sizeof(body)));
+  CHECK(state("RUNNING"));
+  for(int i = 0; i < 2 * CAPTURESIZE + 1; i++){
+    hostDrivePin(2, (i & 1) == 0);
+    hostAdvanceTime(2);
+  }
+  CHECK_EQUAL(200, sketchGet("/CAPTURE", body, sizeof(body)));
+  CHECK(state("RUNNING"));
+  CHECK_EQUAL(CAPTURESIZE, number("\"COUNT\":"));
+  CHECK_EQUAL(200, sketchGet("/CAPTURE/DATA", body, sizeof(body)));
+  CHECK(state("DONE"));
+  count = runs(values, lengths, 64);
+  CHECK_EQUAL(CAPTURESIZE, count);
+  CHECK_EQUAL(_BV(2), values[count - 1] & _BV(2));
+  for(int i = 1; i < count - 1; i++){
+    CHECK(values[i] != values[i - 1]);
+    CHECK(labs(lengths[i] - 2) <= 1);
+  }
+  CHECK_EQUAL(0, TIMSK2);
+
+  return checkResult("test_sketch_capture");
+}
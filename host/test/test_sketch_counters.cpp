@@ -0,0 +1,144 @@
+//  the pulse counters on the simulated board: external interrupts 0 and
+//  1 count edges on pins 2 and 3, Timer1's input capture times them on
+//  pin 8 across its overflows, and a reading gives the count with the
+//  frequency and period of the edges since the one before
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+static char body[256];
+
+//  the number after key in the last response, or -1
+static double number(const char *key)
+{
+  const char *at = strstr(body, key);
+  return (at != NULL) ? strtod(at + strlen(key), NULL) : -1;
+}
+
+//  pulses on a pin, low for low ms then high for high ms each, so
+//  their rising edges come one period after the last high
+static void pulses(int pin, int count, int low, int high)
+{
+  for(int i = 0; i < count; i++){
+    hostDrivePin(pin, LOW);
+    hostAdvanceTime(low);
+    hostDrivePin(pin, HIGH);
+    hostAdvanceTime(high);
+  }
+}
+
+//  within a percent of what the simulated time makes it
+static bool near(double value, double expected)
+{
+  return value > expected * 0.99 && value < expected * 1.01;
+}
+
+int main()
+{
+  sketchBegin();
+
+  //  pins without a counter, edges a counter can't take and actions
+  //  it doesn't have
+  CHECK_EQUAL(404, sketchGet("/D5/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(404, sketchGet("/D8/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(404, sketchGet("/A0/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(404, sketchGet("/D2/FREQ", body, sizeof(body)));
+  CHECK_EQUAL(404, sketchGet("/D2/COUNT/PAUSE", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/D2/COUNT?EDGE=UP", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/D8/FREQ?EDGE=ANY", body, sizeof(body)));
+  CHECK_EQUAL(0, EIMSK);
+  CHECK_EQUAL(0, TIMSK1);
+
+  //  rising edges on pin 2 at 100 Hz, none of pin 3's
+  hostDrivePin(2, LOW);
+  hostDrivePin(3, LOW);
+  CHECK_EQUAL(200, sketchGet("/D2/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(0, number("\"COUNT\":"));
+  CHECK_EQUAL(0, number("\"FREQ\":"));
+  CHECK_EQUAL(200, sketchGet("/D3/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(_BV(INT0) | _BV(INT1), EIMSK);
+  pulses(2, 10, 7, 3);
+  CHECK_EQUAL(200, sketchGet("/D2/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(10, number("\"COUNT\":"));
+  CHECK(near(number("\"FREQ\":"), 100));
+  CHECK(near(number("\"PERIOD\":"), 10000));
+  CHECK_EQUAL(200, sketchGet("/D3/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(0, number("\"COUNT\":"));
+
+  //  the next reading covers only the edges since, at their own rate
+  pulses(2, 5, 17, 3);
+  CHECK_EQUAL(200, sketchGet("/D2/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(15, number("\"COUNT\":"));
+  CHECK(near(number("\"FREQ\":"), 50));
+  CHECK(near(number("\"PERIOD\":"), 20000));
+
+  //  quiet for two periods reads 0 and keeps the count
+  hostAdvanceTime(100);
+  CHECK_EQUAL(200, sketchGet("/D2/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(15, number("\"COUNT\":"));
+  CHECK_EQUAL(0, number("\"FREQ\":"));
+  CHECK_EQUAL(0, number("\"PERIOD\":"));
+
+  //  both edges on pin 3, from zero; it is low already, so the first
+  //  pulse has only its rising edge
+  CHECK_EQUAL(200, sketchGet("/D3/COUNT?EDGE=ANY", body, sizeof(body)));
+  CHECK_EQUAL(0, number("\"COUNT\":"));
+  pulses(3, 8, 5, 5);
+  CHECK_EQUAL(200, sketchGet("/D3/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(15, number("\"COUNT\":"));
+  CHECK(near(number("\"FREQ\":"), 200));
+  CHECK_EQUAL(200, sketchGet("/D3/COUNT?EDGE=FALL", body, sizeof(body)));
+  pulses(3, 4, 5, 5);
+  CHECK_EQUAL(200, sketchGet("/D3/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(4, number("\"COUNT\":"));
+
+  //  a stopped counter lets its interrupt go and counts nothing
+  CHECK_EQUAL(200, sketchGet("/D2/COUNT/STOP", body, sizeof(body)));
+  CHECK_EQUAL(_BV(INT1), EIMSK);
+  pulses(2, 4, 5, 5);
+  CHECK_EQUAL(200, sketchGet("/D2/COUNT", body, sizeof(body)));
+  CHECK_EQUAL(0, number("\"COUNT\":"));
+  CHECK_EQUAL(200, sketchGet("/D2/COUNT/STOP", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/D3/COUNT/STOP", body, sizeof(body)));
+  CHECK_EQUAL(0, EIMSK);
+
+  //  input capture at 16 MHz: a 10 ms period is 160000 ticks, so
+  //  every one spans two overflows of the timer
+  hostDrivePin(8, LOW);
+  CHECK_EQUAL(200, sketchGet("/D8/FREQ", body, sizeof(body)));
+  CHECK_EQUAL(0, number("\"COUNT\":"));
+  CHECK_EQUAL(_BV(ICIE1) | _BV(TOIE1), TIMSK1);
+  pulses(8, 10, 6, 4);
+  CHECK_EQUAL(200, sketchGet("/D8/FREQ", body, sizeof(body)));
+  CHECK_EQUAL(10, number("\"COUNT\":"));
+  CHECK(near(number("\"FREQ\":"), 100));
+  CHECK(near(number("\"PERIOD\":"), 10000));
+
+  //  falling edges, 1 kHz
+  CHECK_EQUAL(200, sketchGet("/D8/FREQ?EDGE=FALL", body, sizeof(body)));
+  pulses(8, 20, 1, 1);
+  CHECK_EQUAL(200, sketchGet("/D8/FREQ", body, sizeof(body)));
+  CHECK_EQUAL(20, number("\"COUNT\":"));
+  CHECK(near(number("\"FREQ\":"), 500));
+  CHECK(near(number("\"PERIOD\":"), 2000));
+
+  //  the timer is busy for PWM on 9 and reconfiguration until the
+  //  counter stops, then back as the core had it
+  CHECK_EQUAL(400, sketchGet("/D9/128", body, sizeof(body)));
+  CHECK_EQUAL(503, sketchGet("/PWM/1?BITS=10", body, sizeof(body)));
+  CHECK_EQUAL(503, sketchGet("/PWM/1/RESET", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/D8/FREQ/STOP", body, sizeof(body)));
+  CHECK_EQUAL(0, TIMSK1);
+  CHECK_EQUAL(_BV(WGM10), TCCR1A);
+  CHECK_EQUAL(_BV(CS11) | _BV(CS10), TCCR1B);
+  CHECK_EQUAL(200, sketchGet("/D9/128", body, sizeof(body)));
+  CHECK_EQUAL(128, OCR1A);
+
+  return checkResult("test_sketch_counters");
+}
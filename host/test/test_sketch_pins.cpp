@@ -0,0 +1,78 @@
+//  pin names against the Uno's pin table: multi-digit and analog pins
+//  address the pin they name, pins the board lacks and the ones the
+//  Ethernet shield uses are 404, and values a pin can't take are 400,
+//  with nothing written to the hardware for a request that fails
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+static char body[256];
+
+//  the pin registers, to show a request left them alone
+static void ports(uint8_t *saved)
+{
+  saved[0] = DDRB;
+  saved[1] = PORTB;
+  saved[2] = DDRC;
+  saved[3] = PORTC;
+  saved[4] = DDRD;
+  saved[5] = PORTD;
+}
+
+int main()
+{
+  static const char *unknown[] = {
+    //  the SPI pins, the W5100's select and the SD card's
+    "/D10", "/D11/HIGH", "/12", "/D13/LOW", "/D4", "/4/HIGH",
+    //  pins the Uno lacks, and names that aren't pins
+    "/D20", "/D99/HIGH", "/A6", "/A10", "/D1000", "/DX", "/D", "/A",
+  };
+  static const char *badValue[] = {
+    //  PWM on pins without it, values past 255 or not numbers
+    "/D8/128", "/D2/1", "/A0/128", "/D9/256", "/D9/-1", "/D9/HI", "/D9/1.5",
+  };
+  uint8_t before[6], after[6];
+
+  sketchBegin();
+
+  ports(before);
+  for(unsigned i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++){
+    CHECK_EQUAL(404, sketchGet(unknown[i], body, sizeof(body)));
+  }
+  for(unsigned i = 0; i < sizeof(badValue) / sizeof(badValue[0]); i++){
+    CHECK_EQUAL(400, sketchGet(badValue[i], body, sizeof(body)));
+  }
+  ports(after);
+  CHECK_EQUAL(0, memcmp(before, after, sizeof(before)));
+
+  //  D, d and a bare number are the same pin, two digits included;
+  //  the path is read in upper case
+  hostDrivePin(19, HIGH);
+  CHECK_EQUAL(200, sketchGet("/D19", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"D19\":\"HIGH\"}"));
+  CHECK_EQUAL(200, sketchGet("/d19", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"D19\":\"HIGH\"}"));
+  CHECK_EQUAL(200, sketchGet("/19", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"19\":\"HIGH\"}"));
+
+  //  an analog input written to is driven as its digital pin
+  CHECK_EQUAL(200, sketchGet("/A1/HIGH", body, sizeof(body)));
+  CHECK(DDRC & _BV(1));
+  CHECK(PORTC & _BV(1));
+  CHECK_EQUAL(200, sketchGet("/D9/255", body, sizeof(body)));
+  CHECK(DDRB & _BV(1));
+  CHECK(PORTB & _BV(1));
+
+  //  the analog inputs read as channels
+  hostSetAnalog(5, 321);
+  hostAdvanceTime(100);
+  CHECK_EQUAL(200, sketchGet("/A5", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"A5\":\"321\"}"));
+
+  return checkResult("test_sketch_pins");
+}
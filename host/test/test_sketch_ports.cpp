@@ -0,0 +1,84 @@
+//  /PORT on the simulated register file: pins driven from outside and
+//  pins the sketch drives itself come back in one snapshot, as the
+//  bitmask and pin by pin, and reading them leaves the pins as they were
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+static char body[2048];
+
+//  the MASK of the last /PORT response
+static unsigned long portMask()
+{
+  const char *mask = strstr(body, "\"MASK\":\"0x");
+  return (mask != NULL) ? strtoul(mask + 10, NULL, 16) : 0xFFFFFFFFUL;
+}
+
+static bool pinReads(int pin, bool high)
+{
+  char entry[16];
+  snprintf(entry, sizeof(entry), "\"D%d\":\"%s\"", pin, high ? "HIGH" : "LOW");
+  return strstr(body, entry) != NULL;
+}
+
+int main()
+{
+  //  inputs 2 to 9 driven to these levels in turn, pin n by bit n
+  static const unsigned long patterns[] = { 0x000, 0x3FC, 0x154, 0x2A8, 0x204 };
+
+  sketchBegin();
+
+  for(unsigned p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++){
+    for(int pin = 2; pin <= 9; pin++){
+      hostDrivePin(pin, (patterns[p] >> pin) & 1);
+    }
+
+    CHECK_EQUAL(200, sketchGet("/PORT", body, sizeof(body)));
+    CHECK_EQUAL(patterns[p], portMask() & 0x3FC);
+    for(int pin = 2; pin <= 9; pin++){
+      CHECK(pinReads(pin, (patterns[p] >> pin) & 1));
+    }
+  }
+
+  //  /D* is the same snapshot
+  CHECK_EQUAL(200, sketchGet("/D*", body, sizeof(body)));
+  CHECK_EQUAL(patterns[4], portMask() & 0x3FC);
+
+  //  an output reads what the sketch writes to it, whatever drives it
+  //  from outside, and the inputs stay inputs
+  CHECK_EQUAL(200, sketchGet("/8/LOW", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/PORT", body, sizeof(body)));
+  CHECK(pinReads(8, false));
+  CHECK(pinReads(9, true));
+  CHECK_EQUAL(0, portMask() & (1UL << 8));
+  CHECK_EQUAL(0, DDRD & 0xFC);
+  CHECK_EQUAL(_BV(0), DDRB & 0x03);
+
+  //  floating inputs read their pull-ups: off, then on
+  hostReleasePin(5);
+  hostReleasePin(6);
+  CHECK_EQUAL(0, PORTD & _BV(6));
+  //  set behind the core's back, so the PIN registers are brought up
+  //  to date here
+  PORTD |= _BV(6);
+  hostUpdatePins();
+  CHECK_EQUAL(200, sketchGet("/PORT", body, sizeof(body)));
+  CHECK(pinReads(5, false));
+  CHECK(pinReads(6, true));
+
+  //  every digital pin is in the map
+  for(int pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+    char key[8];
+    snprintf(key, sizeof(key), "\"D%d\"", pin);
+    CHECK(strstr(body, key) != NULL);
+  }
+
+  return checkResult("test_sketch_ports");
+}
@@ -0,0 +1,125 @@
+//  /PWM on the simulated Timer1: a resolution or a frequency sets the
+//  timer's mode, prescaler and TOP, pins already running PWM keep their
+//  duty across the change, writes are checked against the new TOP, and
+//  RESET gives the timer back to the core's 8-bit PWM
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+static char body[512];
+
+//  the number after key in the last response, or -1
+static double number(const char *key)
+{
+  const char *at = strstr(body, key);
+  return (at != NULL) ? strtod(at + strlen(key), NULL) : -1;
+}
+
+static bool mode(const char *name)
+{
+  char entry[32] = "\"MODE\":\"";
+  strcat(entry, name);
+  strcat(entry, "\"");
+  return strstr(body, entry) != NULL;
+}
+
+int main()
+{
+  static const char *badValue[] = {
+    //  neither FREQ nor BITS, or both
+    "/PWM/1?MODE=FAST", "/PWM/1?FREQ=50&BITS=8",
+    //  out of range or not numbers, and a mode it lacks
+    "/PWM/1?BITS=1", "/PWM/1?BITS=17", "/PWM/1?BITS=X", "/PWM/1?FREQ=0",
+    "/PWM/1?FREQ=-5", "/PWM/1?FREQ=1.5", "/PWM/1?BITS=8&MODE=SLOW",
+    //  too fast for a TOP of 3
+    "/PWM/1?FREQ=5000000", "/PWM/1?FREQ=3000000&MODE=PHASE",
+  };
+  static const char *unknown[] = {
+    "/PWM", "/PWM/0", "/PWM/2", "/PWM/3", "/PWM/X", "/PWM/1/STOP",
+  };
+
+  sketchBegin();
+
+  //  the core's phase correct PWM at a prescaler of 64; pin 10 is the
+  //  W5100's select and isn't listed
+  CHECK_EQUAL(200, sketchGet("/PWM/1", body, sizeof(body)));
+  CHECK_EQUAL(1, number("\"TIMER\":"));
+  CHECK(mode("DEFAULT"));
+  CHECK_EQUAL(490.2, number("\"FREQ\":"));
+  CHECK_EQUAL(255, number("\"TOP\":"));
+  CHECK_EQUAL(8, number("\"BITS\":"));
+  CHECK(strstr(body, "\"PINS\":[9]") != NULL);
+
+  //  nothing is changed by a request that is refused
+  for(unsigned i = 0; i < sizeof(badValue) / sizeof(badValue[0]); i++){
+    CHECK_EQUAL(400, sketchGet(badValue[i], body, sizeof(body)));
+  }
+  for(unsigned i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++){
+    CHECK_EQUAL(404, sketchGet(unknown[i], body, sizeof(body)));
+  }
+  CHECK_EQUAL(_BV(WGM10), TCCR1A);
+  CHECK_EQUAL(_BV(CS11) | _BV(CS10), TCCR1B);
+
+  //  10 bits of fast PWM at the full clock, with pin 9 at half duty
+  //  before and after
+  CHECK_EQUAL(200, sketchGet("/D9/128", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/PWM/1?BITS=10", body, sizeof(body)));
+  CHECK(mode("FAST"));
+  CHECK_EQUAL(15625, number("\"FREQ\":"));
+  CHECK_EQUAL(1023, number("\"TOP\":"));
+  CHECK_EQUAL(10, number("\"BITS\":"));
+  CHECK_EQUAL(_BV(WGM11) | _BV(COM1A1), TCCR1A);
+  CHECK_EQUAL(_BV(WGM13) | _BV(WGM12) | _BV(CS10), TCCR1B);
+  CHECK_EQUAL(1023, ICR1);
+  CHECK_EQUAL(513, OCR1A);
+
+  //  values up to the new TOP, and no further
+  CHECK_EQUAL(200, sketchGet("/D9/1000", body, sizeof(body)));
+  CHECK_EQUAL(1000, OCR1A);
+  CHECK_EQUAL(200, sketchGet("/D9", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"D9\":\"1000\"}"));
+  CHECK_EQUAL(400, sketchGet("/D9/1024", body, sizeof(body)));
+  CHECK_EQUAL(1000, OCR1A);
+  CHECK_EQUAL(200, sketchGet("/D9/1023", body, sizeof(body)));
+  CHECK_EQUAL(0, TCCR1A & _BV(COM1A1));
+  CHECK(PORTB & _BV(1));
+
+  //  50 Hz phase correct for a servo: a prescaler of 8, TOP 20000
+  CHECK_EQUAL(200, sketchGet("/D9/512", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/PWM/1?FREQ=50&MODE=PHASE", body, sizeof(body)));
+  CHECK(mode("PHASE"));
+  CHECK_EQUAL(50, number("\"FREQ\":"));
+  CHECK_EQUAL(20000, number("\"TOP\":"));
+  CHECK_EQUAL(14, number("\"BITS\":"));
+  CHECK_EQUAL(_BV(WGM11) | _BV(COM1A1), TCCR1A);
+  CHECK_EQUAL(_BV(WGM13) | _BV(CS11), TCCR1B);
+  CHECK_EQUAL(20000, ICR1);
+  CHECK_EQUAL(512L * 20000 / 1023, OCR1A);
+  CHECK_EQUAL(200, sketchGet("/STATE", body, sizeof(body)));
+  CHECK(strstr(body, "\"D9\":{\"MODE\":\"PWM\",\"VALUE\":10009}") != NULL);
+
+  //  1 kHz fast, the finest TOP at the full clock
+  CHECK_EQUAL(200, sketchGet("/PWM/1?FREQ=1000", body, sizeof(body)));
+  CHECK(mode("FAST"));
+  CHECK_EQUAL(1000, number("\"FREQ\":"));
+  CHECK_EQUAL(15999, ICR1);
+  CHECK_EQUAL(_BV(WGM13) | _BV(WGM12) | _BV(CS10), TCCR1B);
+
+  //  back to the core's PWM, the duty scaled down to 8 bits
+  CHECK_EQUAL(200, sketchGet("/PWM/1/RESET", body, sizeof(body)));
+  CHECK(mode("DEFAULT"));
+  CHECK_EQUAL(255, number("\"TOP\":"));
+  CHECK_EQUAL(_BV(WGM10), TCCR1A & ~_BV(COM1A1));
+  CHECK_EQUAL(_BV(CS11) | _BV(CS10), TCCR1B);
+  CHECK_EQUAL(10009L * 15999 / 20000 * 255 / 15999, OCR1A);
+  CHECK_EQUAL(400, sketchGet("/D9/256", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/PWM/1/RESET", body, sizeof(body)));
+
+  return checkResult("test_sketch_pwm");
+}
@@ -0,0 +1,125 @@
+//  timed pin actions through requests: writes with FOR, pulses and ramps
+//  wait in the Uno's heap of 6 and come due in time order whatever
+//  order they were asked for in, a full heap answers 503 without
+//  touching the pin, and a write cancels what is pending for its pin
+
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+#define SCHEDULESIZE 6
+
+static char body[2048];
+
+static bool level(int pin)
+{
+  return (*portOutputRegister(digitalPinToPort(pin)) & digitalPinToBitMask(pin)) != 0;
+}
+
+//  run loop() as ms pass, a millisecond at a time
+static void run(int ms)
+{
+  for(int i = 0; i < ms; i++){
+    hostAdvanceTime(1);
+    loop();
+  }
+}
+
+int main()
+{
+  //  the pins and how long each is held HIGH, asked for out of order
+  static const int pins[SCHEDULESIZE] = { 2, 3, 5, 6, 7, 8 };
+  static const char *requests[SCHEDULESIZE] = {
+    "/D2/HIGH?FOR=60", "/D3/HIGH?FOR=20ms", "/D5/HIGH?FOR=50000us",
+    "/D6/HIGH?FOR=10", "/D7/HIGH?FOR=40", "/D8/HIGH?FOR=30",
+  };
+  static const int expected[SCHEDULESIZE] = { 6, 3, 8, 7, 5, 2 };
+  int order[SCHEDULESIZE];
+  int done = 0;
+
+  sketchBegin();
+
+  for(int i = 0; i < SCHEDULESIZE; i++){
+    CHECK_EQUAL(200, sketchGet(requests[i], body, sizeof(body)));
+    CHECK(level(pins[i]));
+  }
+
+  //  the heap is full: nothing more is taken, and the pin is left alone
+  CHECK_EQUAL(503, sketchGet("/D9/HIGH?FOR=10", body, sizeof(body)));
+  CHECK_EQUAL(503, sketchGet("/D9/PULSE/10ms", body, sizeof(body)));
+  CHECK_EQUAL(503, sketchGet("/D9/RAMP/0/255/1s", body, sizeof(body)));
+  CHECK_EQUAL(0, DDRB & _BV(1));
+  CHECK_EQUAL(200, sketchGet("/STATE", body, sizeof(body)));
+  CHECK(strstr(body, "\"D9\":{\"MODE\":\"UNSET\"}") != NULL);
+
+  //  pulses short enough to be timed inline don't need the heap
+  CHECK_EQUAL(200, sketchGet("/D9/PULSE/20us", body, sizeof(body)));
+  CHECK(!level(9));
+
+  //  back to LOW earliest first
+  for(int ms = 0; ms < 100 && done < SCHEDULESIZE; ms++){
+    run(1);
+    for(int i = 0; i < SCHEDULESIZE; i++){
+      bool seen = false;
+      for(int j = 0; j < done; j++){
+        seen = seen || order[j] == pins[i];
+      }
+      if(!seen && !level(pins[i])){
+        order[done++] = pins[i];
+      }
+    }
+  }
+  CHECK_EQUAL(SCHEDULESIZE, done);
+  for(int i = 0; i < done; i++){
+    CHECK_EQUAL(expected[i], order[i]);
+  }
+
+  //  a write cancels what is pending for the pin, freeing its place
+  for(int i = 0; i < SCHEDULESIZE; i++){
+    CHECK_EQUAL(200, sketchGet("/D7/HIGH?FOR=20", body, sizeof(body)));
+  }
+  CHECK_EQUAL(200, sketchGet("/D7/HIGH", body, sizeof(body)));
+  run(40);
+  CHECK(level(7));
+  for(int i = 0; i < SCHEDULESIZE; i++){
+    CHECK_EQUAL(200, sketchGet(requests[i], body, sizeof(body)));
+  }
+  CHECK_EQUAL(503, sketchGet("/D9/HIGH?FOR=10", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/D2/LOW", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/D9/HIGH?FOR=10", body, sizeof(body)));
+  run(100);
+
+  //  a pulse flips the pin and back, a write FOR a while puts back
+  //  the duty it replaced
+  CHECK_EQUAL(200, sketchGet("/D8/PULSE/30", body, sizeof(body)));
+  CHECK(level(8));
+  run(40);
+  CHECK(!level(8));
+  CHECK_EQUAL(200, sketchGet("/D5/100", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/D5/200?FOR=20", body, sizeof(body)));
+  CHECK_EQUAL(200, OCR0B);
+  run(30);
+  CHECK_EQUAL(100, OCR0B);
+  CHECK_EQUAL(200, sketchGet("/STATE", body, sizeof(body)));
+  CHECK(strstr(body, "\"D5\":{\"MODE\":\"PWM\",\"VALUE\":100}") != NULL);
+
+  //  a ramp steps the duty through its duration and ends on the last
+  CHECK_EQUAL(200, sketchGet("/D9/RAMP/0/100/100", body, sizeof(body)));
+  run(50);
+  CHECK(OCR1A >= 40 && OCR1A <= 60);
+  run(60);
+  CHECK_EQUAL(100, OCR1A);
+  CHECK_EQUAL(200, sketchGet("/STATE", body, sizeof(body)));
+  CHECK(strstr(body, "\"D9\":{\"MODE\":\"PWM\",\"VALUE\":100}") != NULL);
+
+  //  durations past the scheduler's reach, or not durations
+  CHECK_EQUAL(400, sketchGet("/D7/HIGH?FOR=2001s", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/D7/HIGH?FOR=10min", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/D7/PULSE/0", body, sizeof(body)));
+
+  return checkResult("test_sketch_schedule");
+}
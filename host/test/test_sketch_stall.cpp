@@ -0,0 +1,157 @@
+//  a client that stops reading: it pipelines requests and never takes
+//  the responses, so its socket's buffer fills. The sketch stops
+//  answering it and goes on serving everyone else, then drops it. An
+//  event stream that isn't read stops getting events, without losing
+//  any it was sent, and is closed a heartbeat's time later.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+//  the core's IPAddress has a constant of this name
+#undef INADDR_NONE
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+#define PIPELINED 400
+
+//  the sketch's EVENTS_INTERVAL, EVENTS_HEARTBEAT and CLOSE_TIMEOUT
+#define EVENTS_INTERVAL 50
+#define EVENTS_HEARTBEAT 15000
+#define CLOSE_TIMEOUT 1000
+
+#include "W5100Sim.h"
+
+//  a connection with a receive window as small as the host allows, so
+//  it fills with a few responses as a stalled browser's does in time
+static int stalledConnect()
+{
+  struct sockaddr_in addr;
+  int size = 2048;
+
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(s, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = htons(W5100Chip.hostPort(80));
+  if(connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+    close(s);
+    return -1;
+  }
+  return s;
+}
+
+int main()
+{
+  static char requests[PIPELINED * 32];
+  char body[256];
+  int length = 0;
+
+  sketchBegin();
+
+  int s = stalledConnect();
+  CHECK(s >= 0);
+  for(int i = 0; i < PIPELINED; i++){
+    length += snprintf(requests + length, sizeof(requests) - length,
+      "GET /STATE HTTP/1.1\r\n\r\n");
+  }
+  CHECK_EQUAL(length, (int)send(s, requests, length, 0));
+
+  //  until the host's socket buffers are full and the sketch's socket
+  //  has stopped emptying
+  unsigned long start = millis();
+  while(millis() - start < 300){
+    hostInterrupts();
+    loop();
+  }
+
+  //  everyone else is still answered, one after the other on the
+  //  other connection
+  for(int i = 0; i < 4; i++){
+    CHECK_EQUAL(200, sketchGet("/2", body, sizeof(body)));
+  }
+
+  //  the stalled client is dropped: it gets the responses that were
+  //  sent before it stalled, then the end of the connection
+  start = millis();
+  while(millis() - start < 3000){
+    hostInterrupts();
+    loop();
+  }
+  int received = 0;
+  for(;;){
+    static char data[65536];
+    int n = recv(s, data, sizeof(data), MSG_DONTWAIT);
+    if(n > 0){
+      received += n;
+      continue;
+    }
+    CHECK(n == 0 || errno == ECONNRESET);
+    break;
+  }
+  CHECK(received > 0);
+  close(s);
+
+  CHECK_EQUAL(200, sketchGet("/2", body, sizeof(body)));
+
+  //  an event stream whose client stops reading while pin 3 keeps
+  //  changing between most samples
+  s = stalledConnect();
+  CHECK(s >= 0);
+  length = snprintf(requests, sizeof(requests), "GET /EVENTS?D3 HTTP/1.1\r\n\r\n");
+  CHECK_EQUAL(length, (int)send(s, requests, length, 0));
+  for(int i = 0; i < 4000; i++){
+    hostDrivePin(3, (i / 3) & 1);
+    hostAdvanceTime(EVENTS_INTERVAL / 2);
+    loop();
+  }
+  for(int i = 0; i < 4; i++){
+    CHECK_EQUAL(200, sketchGet("/2", body, sizeof(body)));
+  }
+
+  //  closed once nothing has been taken for a heartbeat's time, and
+  //  every event that came before is whole
+  hostAdvanceTime(EVENTS_HEARTBEAT + EVENTS_INTERVAL);
+  loop();
+  hostAdvanceTime(CLOSE_TIMEOUT + 1);
+  loop();
+  loop();
+  static char events[1 << 20];
+  received = 0;
+  for(;;){
+    int n = recv(s, events + received, sizeof(events) - 1 - received, MSG_DONTWAIT);
+    if(n > 0){
+      received += n;
+      continue;
+    }
+    CHECK(n == 0 || errno == ECONNRESET);
+    break;
+  }
+  events[received] = '\0';
+  close(s);
+
+  char *event = strstr(events, "\r\n\r\n");
+  CHECK(event != NULL);
+  int count = 0;
+  for(event += 4; strstr(event, "\n\n") != NULL; count++){
+    char *end = strstr(event, "\n\n");
+    *end = '\0';
+    CHECK(strcmp(event, "data: {\"D3\":\"HIGH\"}") == 0 ||
+      strcmp(event, "data: {\"D3\":\"LOW\"}") == 0 ||
+      strcmp(event, ":") == 0);
+    event = end + 2;
+  }
+  CHECK(count > 0);
+  CHECK(count < 4000 / 6);
+
+  return checkResult("test_sketch_stall");
+}
@@ -0,0 +1,92 @@
+//  the pin state table through requests: /STATE lists every pin the
+//  sketch may use with the mode and value last set, reading a pin the
+//  sketch drives answers from the table without making it an input,
+//  and neither touches the pin registers
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <HostBoard.h>
+
+#include "check.h"
+#include "sketch_harness.h"
+
+static char body[2048];
+
+//  is the entry for pin in the last /STATE response this one?
+static bool pinState(int pin, const char *state)
+{
+  char entry[64];
+  snprintf(entry, sizeof(entry), "\"D%d\":{%s}", pin, state);
+  return strstr(body, entry) != NULL;
+}
+
+static bool listed(int pin)
+{
+  char key[8];
+  snprintf(key, sizeof(key), "\"D%d\"", pin);
+  return strstr(body, key) != NULL;
+}
+
+int main()
+{
+  sketchBegin();
+
+  //  nothing used since reset; the pins the Ethernet shield keeps
+  //  aren't listed
+  CHECK_EQUAL(200, sketchGet("/STATE", body, sizeof(body)));
+  for(int pin = 0; pin < NUM_DIGITAL_PINS; pin++){
+    if(pin == 4 || (pin >= 10 && pin <= 13)){
+      CHECK(!listed(pin));
+    }
+    else {
+      CHECK(pinState(pin, "\"MODE\":\"UNSET\""));
+    }
+  }
+
+  CHECK_EQUAL(200, sketchGet("/D7/HIGH", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/D8/LOW", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/D9/128", body, sizeof(body)));
+  hostDrivePin(2, HIGH);
+  CHECK_EQUAL(200, sketchGet("/D2", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/A0/HIGH", body, sizeof(body)));
+
+  uint8_t ddrb = DDRB, portb = PORTB, ddrd = DDRD, portd = PORTD;
+  CHECK_EQUAL(200, sketchGet("/STATE", body, sizeof(body)));
+  CHECK(pinState(7, "\"MODE\":\"OUTPUT\",\"VALUE\":\"HIGH\""));
+  CHECK(pinState(8, "\"MODE\":\"OUTPUT\",\"VALUE\":\"LOW\""));
+  CHECK(pinState(9, "\"MODE\":\"PWM\",\"VALUE\":128"));
+  CHECK(pinState(2, "\"MODE\":\"INPUT\""));
+  CHECK(pinState(14, "\"MODE\":\"OUTPUT\",\"VALUE\":\"HIGH\""));
+  CHECK(pinState(3, "\"MODE\":\"UNSET\""));
+  CHECK_EQUAL(ddrb, DDRB);
+  CHECK_EQUAL(portb, PORTB);
+  CHECK_EQUAL(ddrd, DDRD);
+  CHECK_EQUAL(portd, PORTD);
+
+  //  an output reads what was written to it, whatever is on the pin,
+  //  and stays an output
+  hostDrivePin(7, LOW);
+  CHECK_EQUAL(200, sketchGet("/D7", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"D7\":\"HIGH\"}"));
+  CHECK(DDRD & _BV(7));
+  CHECK(PORTD & _BV(7));
+  CHECK_EQUAL(200, sketchGet("/D9", body, sizeof(body)));
+  CHECK_EQUAL(0, strcmp(body, "{\"D9\":\"128\"}"));
+  CHECK(TCCR1A & _BV(COM1A1));
+  CHECK_EQUAL(128, OCR1A);
+
+  //  a level after PWM turns the PWM off, PWM on a pin without it is
+  //  refused and leaves the table as it was
+  CHECK_EQUAL(200, sketchGet("/D9/LOW", body, sizeof(body)));
+  CHECK_EQUAL(0, TCCR1A & _BV(COM1A1));
+  CHECK_EQUAL(200, sketchGet("/D5/64", body, sizeof(body)));
+  CHECK_EQUAL(400, sketchGet("/D7/64", body, sizeof(body)));
+  CHECK_EQUAL(200, sketchGet("/STATE", body, sizeof(body)));
+  CHECK(pinState(9, "\"MODE\":\"OUTPUT\",\"VALUE\":\"LOW\""));
+  CHECK(pinState(5, "\"MODE\":\"PWM\",\"VALUE\":64"));
+  CHECK(pinState(7, "\"MODE\":\"OUTPUT\",\"VALUE\":\"HIGH\""));
+
+  return checkResult("test_sketch_state");
+}
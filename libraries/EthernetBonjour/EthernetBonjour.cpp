@@ -18,8 +18,12 @@
 //  <http://www.gnu.org/licenses/>.
 //
 
+#if !defined(HAS_SERVICE_REGISTRATION)
 #define  HAS_SERVICE_REGISTRATION      0  // disabling saves about 1.25 kilobytes
+#endif
+#if !defined(HAS_NAME_BROWSING)
 #define  HAS_NAME_BROWSING             0  // disable together with above, additionally saves about 4.3 kilobytes
+#endif
 
 #include <Arduino.h>
 #include <stdlib.h>
@@ -39,8 +43,22 @@ extern "C" {
 #define  MDNS_NQUERY_RESEND_TIME (1000)   // 1 second, name query resend timeout
 #define  MDNS_SQUERY_RESEND_TIME (10000)  // 10 seconds, service query resend timeout
 #define  MDNS_RESPONSE_TTL       (120)    // two minutes (in seconds)
+#define  MDNS_RESPONSE_DELAY_MIN (20)     // shared records are answered after a random delay
+#define  MDNS_RESPONSE_DELAY_MAX (120)    // between these two (in milliseconds)
+#define  MDNS_MULTICAST_INTERVAL (1000)   // 1 second, minimum time between multicasts of a record
+#define  MDNS_UNICAST_INTERVAL   (250UL*MDNS_RESPONSE_TTL) // QU questions are answered by
+                                          // multicast if we didn't do so for a quarter TTL
 
 #define  MDNS_MAX_SERVICES_PER_PACKET  (6)
+#define  MDNS_MAX_NAME_LEN       (72)     // longest wire-format name we answer to
+#define  MDNS_HASH_SEED          (5381)
+#if !defined(MDNS_RX_BUFFER_SIZE)         // stack cache for the start of a received packet,
+#if defined(RAMEND) && RAMEND < 0x1000    // 0 to read everything from the chip. boards with
+#define  MDNS_RX_BUFFER_SIZE     (0)      // 2K of RAM (Uno) have no room for it next to the
+#else                                     // sketch.
+#define  MDNS_RX_BUFFER_SIZE     (256)
+#endif
+#endif
 
 #define  NUM_SOCKETS             (4)
 
@@ -50,9 +68,11 @@ extern "C" {
 static uint8_t mdnsMulticastIPAddr[] = { 224, 0, 0, 251 };
 static uint8_t mdnsHWAddr[] = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0xfb };
 
+// DNS_SD_SERVICE in wire format, the terminating zero is the string's own
+static uint8_t mdnsDNSSDWireName[] = "\x09_services\x07_dns-sd\x04_udp\x05local";
+
 typedef enum _MDNSPacketType_t {
    MDNSPacketTypeMyIPAnswer,
-   MDNSPacketTypeNoIPv6AddrAvailable,
    MDNSPacketTypeServiceRecord,
    MDNSPacketTypeServiceRecordRelease,
    MDNSPacketTypeNameQuery,
@@ -77,6 +97,35 @@ typedef struct _DNSHeader_t {
    uint16_t    additionalCount;
 } __attribute__((__packed__)) DNSHeader_t;
 
+// a received DNS payload in the chip's RX buffer, with the part of it read so far
+// cached in RAM
+typedef struct _MDNSRxPacket_t {
+   int         socket;
+   uint16_t    ptr;        // chip address of the payload
+   uint16_t    len;
+   uint8_t*    buf;        // cache of the start of the payload, NULL if there is none
+   uint16_t    size;       // size of buf
+   uint16_t    cached;     // bytes of the payload in buf
+} MDNSRxPacket_t;
+
+// what to answer for each of our names in a response (see _sendMDNSResponse). the first entry
+// is our host name, the rest are our services.
+#define  MDNS_ANSWER_ADDRESS     (0x01)   // host: our A record
+#define  MDNS_ANSWER_NO_IPV6     (0x02)   // host: NSEC record saying there is no AAAA record
+#define  MDNS_KNOWN_ADDRESS      (0x04)   // host: the querier has our A record already
+#define  MDNS_ANSWER_SERVICE     (0x01)   // service: its PTR, SRV and TXT records
+#define  MDNS_ANSWER_TYPE        (0x02)   // service: its DNS-SD service type PTR record
+#define  MDNS_ANSWER_MASK        (0x03)   // the flags above that are records of their own
+
+#define  MDNS_NO_PARENT          (0xFF)
+#define  MDNS_PENDING_PARENT     (0xFE)
+
+// walks the labels of a dotted name, optionally continued by a second dotted name
+typedef struct _MDNSLabelIter_t {
+   const uint8_t*    p;
+   const uint8_t*    postfix;
+} MDNSLabelIter_t;
+
 typedef enum _DNSOpCode_t {
    DNSOpQuery     = 0,
    DNSOpIQuery    = 1,
@@ -112,6 +161,225 @@ void my_free(void* ptr)
 #endif
 }
 
+// reads len bytes at offset into the DNS payload. reads that continue where the cache ends
+// and still fit into it go through the cache, so that compression pointers back into the
+// packet are answered from RAM; everything else is read from the chip. reads beyond the
+// end of the payload yield zeroes, which terminates any name being parsed.
+static void mdnsReadPacket(MDNSRxPacket_t* packet, uint16_t offset, uint8_t* dst, uint16_t len)
+{
+   uint16_t avail = (offset < packet->len) ? packet->len - offset : 0, n;
+   if (avail > len)
+      avail = len;
+   
+   memset(dst + avail, 0, len - avail);
+   
+   if (offset < packet->cached) {
+      n = packet->cached - offset;
+      if (n > avail)
+         n = avail;
+      
+      memcpy(dst, packet->buf + offset, n);
+      dst += n;
+      offset += n;
+      avail -= n;
+   }
+   
+   if (0 == avail)
+      return;
+   
+   if (offset == packet->cached && offset + avail <= packet->size) {
+      ethernet_compat_read_data(packet->socket, (uint8_t*)(packet->ptr+offset),
+                                packet->buf + offset, avail);
+      packet->cached += avail;
+      memcpy(dst, packet->buf + offset, avail);
+   } else
+      ethernet_compat_read_data(packet->socket, (uint8_t*)(packet->ptr+offset), dst, avail);
+}
+
+// names are compared case-insensitively, so every byte is folded before hashing
+static inline uint8_t mdnsFoldCase(uint8_t c)
+{
+   return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// appends one folded byte to a wire-format name and updates its hash.
+// return values:
+// 1 on success
+// 0 if the name would exceed MDNS_MAX_NAME_LEN
+static int mdnsWireNameAppend(uint8_t* data, uint8_t* pLen, uint16_t* pHash, uint8_t c)
+{
+   if (*pLen >= MDNS_MAX_NAME_LEN)
+      return 0;
+   
+   c = mdnsFoldCase(c);
+   data[(*pLen)++] = c;
+   *pHash = ((*pHash << 5) + *pHash) ^ c;
+   
+   return 1;
+}
+
+// reads the name at *pOffset into a folded wire-format name, following compression
+// pointers, and advances *pOffset past the name as it appears in the packet.
+// return values:
+// 1 on success
+// 0 if the name is malformed or longer than MDNS_MAX_NAME_LEN
+static int mdnsReadName(MDNSRxPacket_t* packet, uint16_t* pOffset, uint8_t* name,
+                        uint8_t* pLen, uint16_t* pHash)
+{
+   uint16_t offset = *pOffset, start = *pOffset, target;
+   uint8_t c[2], i, jumped = 0, valid = 1;
+   
+   *pLen = 0;
+   *pHash = MDNS_HASH_SEED;
+   
+   for (;;) {
+      if (offset >= packet->len) {
+         // ran off the end of the packet without finding the end of the name
+         if (!jumped)
+            *pOffset = offset;
+         return 0;
+      }
+      
+      mdnsReadPacket(packet, offset, c, 1);
+      
+      if (0xC0 == (c[0] & 0xC0)) {
+         // the rest of the name is somewhere earlier in the packet
+         mdnsReadPacket(packet, offset+1, &c[1], 1);
+         if (!jumped)
+            *pOffset = offset + 2;
+         jumped = 1;
+         
+         // only allow pointers backwards from where the current run of labels started,
+         // so that a malicious packet can't send us in circles
+         target = ((uint16_t)(c[0] & 0x3F) << 8) | c[1];
+         if (!valid || target >= start)
+            return 0;
+         
+         start = offset = target;
+      } else if (c[0] > 63) {
+         // reserved label types, we can't know where the name ends
+         if (!jumped)
+            *pOffset = offset + 1;
+         return 0;
+      } else {
+         if (valid && (!mdnsWireNameAppend(name, pLen, pHash, c[0]) ||
+                       *pLen + c[0] > MDNS_MAX_NAME_LEN))
+            valid = 0;
+         
+         if (valid) {
+            // read the label in place, then fold and hash it byte by byte
+            mdnsReadPacket(packet, offset+1, name + *pLen, c[0]);
+            for (i=0; i<c[0]; i++)
+               (void)mdnsWireNameAppend(name, pLen, pHash, name[*pLen]);
+         }
+         
+         offset += 1 + c[0];
+         
+         if (0 == c[0])
+            break;
+      }
+   }
+   
+   if (!jumped)
+      *pOffset = offset;
+   
+   return valid;
+}
+
+// return value:
+// the next label (and its length in *pLen), or NULL at the end of the name
+static const uint8_t* mdnsNextLabel(MDNSLabelIter_t* it, uint8_t* pLen)
+{
+   const uint8_t* label;
+   
+   while ('.' == *it->p)
+      it->p++;
+   
+   if (0 == *it->p && NULL != it->postfix) {
+      it->p = it->postfix;
+      it->postfix = NULL;
+      while ('.' == *it->p)
+         it->p++;
+   }
+   
+   if (0 == *it->p)
+      return NULL;
+   
+   label = it->p;
+   while (0 != *it->p && '.' != *it->p)
+      it->p++;
+   
+   *pLen = it->p - label;
+   
+   return label;
+}
+
+// return value:
+// the entry at which the rest of the name (from it on) was already written, or MDNS_NO_PARENT
+static uint8_t mdnsFindSuffix(const MDNSNameTable_t* table, const MDNSLabelIter_t* it)
+{
+   MDNSLabelIter_t walk;
+   const uint8_t* label;
+   uint8_t e, cur, len;
+   
+   for (e=0; e<table->count; e++) {
+      walk = *it;
+      cur = e;
+      
+      while (NULL != (label = mdnsNextLabel(&walk, &len))) {
+         if (cur >= table->count || table->entries[cur].len != len ||
+             0 != memcmp(table->entries[cur].label, label, len))
+            break;
+         
+         cur = table->entries[cur].parent;
+      }
+      
+      if (NULL == label && MDNS_NO_PARENT == cur)
+         return e;
+   }
+   
+   return MDNS_NO_PARENT;
+}
+
+// return value:
+// 1 if the folded wire-format name equals the dotted name (followed by postfix), 0 otherwise
+static int mdnsWireNameEquals(const uint8_t* wire, uint8_t wireLen, const uint8_t* name,
+                              const uint8_t* postfix)
+{
+   MDNSLabelIter_t it;
+   const uint8_t* label;
+   uint8_t len, i, pos = 0;
+   
+   it.p = name;
+   it.postfix = postfix;
+   
+   while (NULL != (label = mdnsNextLabel(&it, &len))) {
+      if (pos + 1 + len >= wireLen || wire[pos] != len)
+         return 0;
+      
+      for (i=0; i<len; i++)
+         if (wire[pos+1+i] != mdnsFoldCase(label[i]))
+            return 0;
+      
+      pos += 1 + len;
+   }
+   
+   return (pos + 1 == wireLen && 0 == wire[pos]);
+}
+
+// collects bytes in buf and writes them to the chip whenever it fills up
+static void mdnsPutByte(int socket, uint8_t c, uint16_t* pPtr, uint8_t* buf, int bufSize,
+                        int* pUsed)
+{
+   buf[(*pUsed)++] = c;
+   
+   if (*pUsed >= bufSize) {
+      ethernet_compat_write_data(socket, buf, (uint8_t*)*pPtr, *pUsed);
+      *pPtr += *pUsed;
+      *pUsed = 0;
+   }
+}
+
 EthernetBonjourClass::EthernetBonjourClass()
 {
    memset(&this->_mdnsData, 0, sizeof(MDNSDataInternal_t));
@@ -119,12 +387,32 @@ EthernetBonjourClass::EthernetBonjourClass()
    
    this->_state = MDNSStateIdle;
    this->_socket = -1;
+   this->_replySocket = -1;
    
    this->_bonjourName = NULL;
+   memset(&this->_bonjourWireName, 0, sizeof(MDNSWireName_t));
+   
+   uint8_t i;
+   this->_dnsSDWireName.data = mdnsDNSSDWireName;
+   this->_dnsSDWireName.len = 0;
+   this->_dnsSDWireName.hash = MDNS_HASH_SEED;
+   for (i=0; i<sizeof(mdnsDNSSDWireName); i++)
+      (void)mdnsWireNameAppend(mdnsDNSSDWireName, &this->_dnsSDWireName.len,
+                               &this->_dnsSDWireName.hash, mdnsDNSSDWireName[i]);
+   
+   this->_nameTable = NULL;
    this->_resolveNames[0] = NULL;
    this->_resolveNames[1] = NULL;
    
    this->_lastAnnounceMillis = 0;
+   
+   // nothing is pending, and nothing has been multicast recently
+   memset(this->_pendingAnswers, 0, sizeof(this->_pendingAnswers));
+   this->_answersPending = 0;
+   this->_pendingAnswersMillis = 0;
+   for (i=0; i<NumMDNSServiceRecords+2; i++)
+      this->_lastMulticastMillis[i][0] = this->_lastMulticastMillis[i][1] =
+         0UL - MDNS_UNICAST_INTERVAL;
 }
 
 EthernetBonjourClass::~EthernetBonjourClass()
@@ -301,8 +589,13 @@ int EthernetBonjourClass::_closeMDNSSession()
 {
    if (this->_socket > -1)
       ethernet_compat_close(this->_socket);
+   if (this->_replySocket > -1)
+      ethernet_compat_close(this->_replySocket);
 
    this->_socket = -1;
+   this->_replySocket = -1;
+   
+   return 1;
 }
 
 // return value:
@@ -320,8 +613,14 @@ MDNSError_t EthernetBonjourClass::_sendMDNSMessage(uint32_t peerAddress, uint32_
    DNSHeader_t* dnsHeader = &dnsHeaderBuf;
 #endif
    uint8_t* buf;
+   MDNSNameTable_t nameTable;
    
    ptr = ethernet_compat_read_SnTX_WR(this->_socket);
+   
+   // names in this message are compressed against each other
+   nameTable.start = ptr;
+   nameTable.count = 0;
+   this->_nameTable = &nameTable;
 
 #if defined(_USE_MALLOC_)
    dnsHeader = (DNSHeader_t*)my_malloc(sizeof(DNSHeader_t));
@@ -353,13 +652,6 @@ MDNSError_t EthernetBonjourClass::_sendMDNSMessage(uint32_t peerAddress, uint32_
       case MDNSPacketTypeServiceQuery:
          dnsHeader->queryCount = ethutil_htons(1);
          break;
-      case MDNSPacketTypeNoIPv6AddrAvailable:
-         dnsHeader->queryCount = ethutil_htons(1);
-         dnsHeader->additionalCount = ethutil_htons(1);
-         dnsHeader->responseCode = 0x03;
-         dnsHeader->authoritiveAnswer = 1;
-         dnsHeader->queryResponse = 1;
-         break;
    }
    
    ethernet_compat_write_data(this->_socket, (uint8_t*)dnsHeader, (uint8_t*)ptr, sizeof(DNSHeader_t));
@@ -379,85 +671,13 @@ MDNSError_t EthernetBonjourClass::_sendMDNSMessage(uint32_t peerAddress, uint32_
       case MDNSPacketTypeServiceRecord: {
 
          // SRV location record
-         this->_writeServiceRecordName(serviceRecord, &ptr, buf, sizeof(DNSHeader_t), 0);
-         
-         buf[0] = 0x00;
-         buf[1] = 0x21;    // SRV record
-         buf[2] = 0x80;    // cache flush
-         buf[3] = 0x01;    // class IN
-         
-         // ttl
-         *((uint32_t*)&buf[4]) = ethutil_htonl(MDNS_RESPONSE_TTL);
-         
-         // data length
-         *((uint16_t*)&buf[8]) = ethutil_htons(8 + strlen((char*)this->_bonjourName));
-         
-         ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 10);
-         ptr += 10;
-         
-         // priority and weight
-         buf[0] = buf[1] = buf[2] = buf[3] = 0;
-         
-         // port
-         *((uint16_t*)&buf[4]) = ethutil_htons(this->_serviceRecords[serviceRecord]->port);
-         
-         ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 6);
-         ptr += 6;
-         
-         // target
-         this->_writeDNSName(this->_bonjourName, &ptr, buf, sizeof(DNSHeader_t), 1);
+         this->_writeServiceRecordSRV(serviceRecord, &ptr, buf, sizeof(DNSHeader_t));
          
          // TXT record
-         this->_writeServiceRecordName(serviceRecord, &ptr, buf, sizeof(DNSHeader_t), 0);
-         
-         buf[0] = 0x00;
-         buf[1] = 0x10;    // TXT record
-         buf[2] = 0x80;    // cache flush
-         buf[3] = 0x01;    // class IN
-         
-         // ttl
-         *((uint32_t*)&buf[4]) = ethutil_htonl(MDNS_RESPONSE_TTL);
-         
-         ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 8);
-         ptr += 8;
-         
-         // data length && text
-         if (NULL == this->_serviceRecords[serviceRecord]->textContent) {
-            buf[0] = 0x00;
-            buf[1] = 0x01;
-            buf[2] = 0x00;
-            ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 3);
-            ptr += 3;
-         } else {
-            int slen = strlen((char*)this->_serviceRecords[serviceRecord]->textContent);
-            *((uint16_t*)buf) = ethutil_htons(slen);
-            ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 2);
-            ptr += 2;
-            ethernet_compat_write_data(this->_socket, (uint8_t*)this->_serviceRecords[serviceRecord]->textContent,
-                       (uint8_t*)ptr, slen);
-            ptr += slen;
-         }
+         this->_writeServiceRecordTXT(serviceRecord, &ptr, buf, sizeof(DNSHeader_t));
          
          // PTR record (for the dns-sd service in general)
-         this->_writeDNSName((const uint8_t*)DNS_SD_SERVICE, &ptr, buf,
-                                          sizeof(DNSHeader_t), 1);
-         
-         buf[0] = 0x00;
-         buf[1] = 0x0c;    // PTR record
-         buf[2] = 0x00;    // no cache flush
-         buf[3] = 0x01;    // class IN
-         
-         // ttl
-         *((uint32_t*)&buf[4]) = ethutil_htonl(MDNS_RESPONSE_TTL);
-         
-         // data length.
-         uint16_t dlen = strlen((char*)this->_serviceRecords[serviceRecord]->servName) + 2;
-         *((uint16_t*)&buf[8]) = ethutil_htons(dlen);
-         
-         ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 10);
-         ptr += 10;
-         
-         this->_writeServiceRecordName(serviceRecord, &ptr, buf, sizeof(DNSHeader_t), 1);
+         this->_writeServiceTypePTR(serviceRecord, &ptr, buf, sizeof(DNSHeader_t));
          
          // PTR record (our service)
          this->_writeServiceRecordPTR(serviceRecord, &ptr, buf, sizeof(DNSHeader_t),
@@ -465,6 +685,10 @@ MDNSError_t EthernetBonjourClass::_sendMDNSMessage(uint32_t peerAddress, uint32_
          
          // finally, our IP address as additional record
          this->_writeMyIPAnswerRecord(&ptr, buf, sizeof(DNSHeader_t));
+         
+         this->_lastMulticastMillis[serviceRecord+2][0] =
+            this->_lastMulticastMillis[serviceRecord+2][1] =
+            this->_lastMulticastMillis[0][0] = millis();
 
          break;
       }
@@ -486,7 +710,7 @@ MDNSError_t EthernetBonjourClass::_sendMDNSMessage(uint32_t peerAddress, uint32_
          this->_writeDNSName(
                (type == MDNSPacketTypeServiceQuery) ? this->_resolveNames[1] :
                                                       this->_resolveNames[0],
-               &ptr, buf, sizeof(DNSHeader_t), 1);
+               NULL, &ptr, buf, sizeof(DNSHeader_t));
 
          buf[0] = buf[2] = 0x0;
          buf[1] = (type == MDNSPacketTypeServiceQuery) ? 0x0c : 0x01; 
@@ -501,22 +725,6 @@ MDNSError_t EthernetBonjourClass::_sendMDNSMessage(uint32_t peerAddress, uint32_
       
 #endif // defined(HAS_NAME_BROWSING) && HAS_NAME_BROWSING
       
-      case MDNSPacketTypeNoIPv6AddrAvailable: {
-         // since the WIZnet doesn't have IPv6, we will respond with a Not Found message
-         this->_writeDNSName(this->_bonjourName, &ptr, buf, sizeof(DNSHeader_t), 1);
-         
-         buf[0] = buf[2] = 0x0;
-         buf[1] = 0x1c; // AAAA record
-         buf[3] = 0x01;
-         
-         ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 4);
-         ptr += 4;
-         
-         // send our IPv4 address record as additional record, in case the peer wants it.
-         this->_writeMyIPAnswerRecord(&ptr, buf, sizeof(DNSHeader_t));
-         
-         break;
-      }
    }
 
    ethernet_compat_write_SnTX_WR(this->_socket, ptr);
@@ -526,6 +734,8 @@ MDNSError_t EthernetBonjourClass::_sendMDNSMessage(uint32_t peerAddress, uint32_
 
 errorReturn:
 
+   this->_nameTable = NULL;
+
 #if defined(_USE_MALLOC_)
    if (NULL != dnsHeader)
       my_free(dnsHeader);
@@ -534,6 +744,161 @@ errorReturn:
    return statusCode;
 }
 
+// closes the socket of the last unicast reply once the chip is done with it: the send went
+// out, or ended in a timeout because the querier didn't answer ARP.
+// return values:
+// 1 if no unicast reply is in flight anymore
+// 0 if the chip is still sending it
+int EthernetBonjourClass::_finishUnicastReply()
+{
+   if (this->_replySocket < 0)
+      return 1;
+   
+   if (!(ethernet_compat_read_SnIR(this->_replySocket) & (ECSnIrSendOk | ECSnIrTimeout)) &&
+       ECSockClosed != ethernet_compat_read_SnSr(this->_replySocket))
+      return 0;
+   
+   ethernet_compat_write_SnIR(this->_replySocket, ECSnIrSendOk | ECSnIrTimeout);
+   ethernet_compat_close(this->_replySocket);
+   this->_replySocket = -1;
+   
+   return 1;
+}
+
+// sends all records flagged in answers (see MDNS_ANSWER_*) in a single response message,
+// either to peerAddress or, if that is 0, to the multicast group
+// return value:
+// A DNSError_t (DNSSuccess on success, something else otherwise), MDNSTryLater if no
+// socket is free for a unicast reply, or the last one is still being sent
+// in "int" mode: positive on success, negative on error
+MDNSError_t EthernetBonjourClass::_sendMDNSResponse(uint32_t peerAddress, uint32_t xid,
+                                                    const uint8_t* answers)
+{
+   DNSHeader_t dnsHeader;
+   MDNSNameTable_t nameTable;
+   uint8_t* buf = (uint8_t*)&dnsHeader;
+   uint16_t ptr, start, answerCount = 0, additionalCount = 0;
+   uint8_t wantsAddress = (answers[0] & MDNS_ANSWER_NO_IPV6);
+   int i, mdnsSocket = this->_socket;
+   
+   for (i=0; i<NumMDNSServiceRecords+2 && 0 == (answers[i] & MDNS_ANSWER_MASK); i++);
+   if (NumMDNSServiceRecords+2 == i)
+      return MDNSNothingToDo;
+   
+   // unicast replies need a plain UDP socket of their own: the multicast socket sends every
+   // frame to the group's MAC address, whatever its destination IP is. the record writers
+   // send through this->_socket, so it stands in for the multicast socket until we're done.
+   if (0 != peerAddress) {
+      if (!this->_finishUnicastReply())
+         return MDNSTryLater;
+      
+      for (i = NUM_SOCKETS-1; i>=0 && ECSockClosed != ethernet_compat_read_SnSr(i); i--);
+      if (i < 0)
+         return MDNSTryLater;
+      
+      ethernet_compat_write_SnDIPR(i, (uint8_t*)&peerAddress);
+      ethernet_compat_write_SnDPORT(i, MDNS_SERVER_PORT);
+      (void)ethernet_compat_socket(i, ECSnMrUDP, MDNS_SERVER_PORT, 0);
+      this->_socket = i;
+   }
+   
+   ptr = start = ethernet_compat_read_SnTX_WR(this->_socket);
+   
+   nameTable.start = start;
+   nameTable.count = 0;
+   this->_nameTable = &nameTable;
+   
+   // the header is written last, once we know what went into the message
+   ptr += sizeof(DNSHeader_t);
+   
+   if (answers[0] & MDNS_ANSWER_ADDRESS) {
+      this->_writeMyIPAnswerRecord(&ptr, buf, sizeof(DNSHeader_t));
+      answerCount++;
+   }
+   
+   if (answers[0] & MDNS_ANSWER_NO_IPV6) {
+      this->_writeNoIPv6Record(&ptr, buf, sizeof(DNSHeader_t));
+      answerCount++;
+   }
+   
+#if defined(HAS_SERVICE_REGISTRATION) && HAS_SERVICE_REGISTRATION
+
+   for (i=0; i<NumMDNSServiceRecords; i++) {
+      if (NULL == this->_serviceRecords[i])
+         continue;
+      
+      if (answers[i+2] & MDNS_ANSWER_TYPE) {
+         this->_writeServiceTypePTR(i, &ptr, buf, sizeof(DNSHeader_t));
+         answerCount++;
+      }
+      
+      if (answers[i+2] & MDNS_ANSWER_SERVICE) {
+         this->_writeServiceRecordPTR(i, &ptr, buf, sizeof(DNSHeader_t), MDNS_RESPONSE_TTL);
+         this->_writeServiceRecordSRV(i, &ptr, buf, sizeof(DNSHeader_t));
+         this->_writeServiceRecordTXT(i, &ptr, buf, sizeof(DNSHeader_t));
+         answerCount += 3;
+         wantsAddress = 1;
+      }
+   }
+
+#endif // defined(HAS_SERVICE_REGISTRATION) && HAS_SERVICE_REGISTRATION
+   
+   if (0 == answerCount) {
+      if (0 != peerAddress) {
+         ethernet_compat_close(this->_socket);
+         this->_socket = mdnsSocket;
+      }
+      this->_nameTable = NULL;
+      return MDNSNothingToDo;
+   }
+   
+   // our IP address as additional record, unless it is an answer already or known
+   if (wantsAddress && !(answers[0] & (MDNS_ANSWER_ADDRESS | MDNS_KNOWN_ADDRESS))) {
+      this->_writeMyIPAnswerRecord(&ptr, buf, sizeof(DNSHeader_t));
+      additionalCount++;
+   }
+   
+   memset(&dnsHeader, 0, sizeof(DNSHeader_t));
+   dnsHeader.xid = ethutil_htons(xid);
+   dnsHeader.opCode = DNSOpQuery;
+   dnsHeader.queryResponse = 1;
+   dnsHeader.authoritiveAnswer = 1;
+   dnsHeader.answerCount = ethutil_htons(answerCount);
+   dnsHeader.additionalCount = ethutil_htons(additionalCount);
+   
+   ethernet_compat_write_data(this->_socket, (uint8_t*)&dnsHeader, (uint8_t*)start,
+                              sizeof(DNSHeader_t));
+   
+   ethernet_compat_write_SnTX_WR(this->_socket, ptr);
+   ethernet_compat_write_SnCR(this->_socket, ECSnCrSockSend);
+
+   while(ethernet_compat_read_SnCR(this->_socket));
+   
+   if (0 != peerAddress) {
+      // closing the socket before the chip is done would drop the reply, and the chip may
+      // have to wait for ARP first, so the socket is closed from a later run()
+      this->_replySocket = this->_socket;
+      this->_socket = mdnsSocket;
+   } else {
+      // remember when each record was multicast last (see _limitMulticast)
+      unsigned long now = millis();
+      
+      for (i=0; i<NumMDNSServiceRecords+2; i++) {
+         if (answers[i] & 0x01)
+            this->_lastMulticastMillis[i][0] = now;
+         if (answers[i] & 0x02)
+            this->_lastMulticastMillis[i][1] = now;
+      }
+      
+      if (additionalCount)
+         this->_lastMulticastMillis[0][0] = now;
+   }
+   
+   this->_nameTable = NULL;
+   
+   return MDNSSuccess;
+}
+
 // return value:
 // A DNSError_t (DNSSuccess on success, something else otherwise)
 // in "int" mode: positive on success, negative on error
@@ -551,10 +916,15 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
    uint32_t peer_addr, xid;
    uint16_t peer_port, udp_len, ptr, qCnt, aCnt, aaCnt, addCnt;
    uint8_t recordsAskedFor[NumMDNSServiceRecords+2];
+   uint8_t recordsAskedForQU[NumMDNSServiceRecords+2];
    uint8_t recordsFound[2];
-   uint8_t wantsIPv6Addr = 0;
+   MDNSRxPacket_t packet;
+#if MDNS_RX_BUFFER_SIZE > 0
+   uint8_t rxBuf[MDNS_RX_BUFFER_SIZE];
+#endif
    
    memset(recordsAskedFor, 0, sizeof(uint8_t)*(NumMDNSServiceRecords+2));
+   memset(recordsAskedForQU, 0, sizeof(uint8_t)*(NumMDNSServiceRecords+2));
    memset(recordsFound, 0, sizeof(uint8_t)*2);
    
    if (0 == ethernet_compat_read_SnRX_RSR(this->_socket)) {
@@ -581,7 +951,18 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
    *((uint16_t*)&peer_port) = ethutil_ntohs(*((uint32_t*)(buf+4)));
    *((uint16_t*)&udp_len) = ethutil_ntohs(*((uint32_t*)(buf+6)));
    
-   ethernet_compat_read_data(this->_socket, (uint8_t*)ptr, (uint8_t*)dnsHeader, sizeof(DNSHeader_t));
+   packet.socket = this->_socket;
+   packet.ptr = ptr;
+   packet.len = udp_len;
+   packet.buf = NULL;
+   packet.size = 0;
+   packet.cached = 0;
+#if MDNS_RX_BUFFER_SIZE > 0
+   packet.buf = rxBuf;
+   packet.size = MDNS_RX_BUFFER_SIZE;
+#endif
+   
+   mdnsReadPacket(&packet, 0, (uint8_t*)dnsHeader, sizeof(DNSHeader_t));
    
    xid = ethutil_ntohs(dnsHeader->xid);
    qCnt = ethutil_ntohs(dnsHeader->queryCount);
@@ -594,101 +975,115 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
        MDNS_SERVER_PORT == peer_port) {
       
       // process an MDNS query
-      int offset = sizeof(DNSHeader_t);
+      uint16_t offset = sizeof(DNSHeader_t), rdOffset;
       uint8_t* buf = (uint8_t*)dnsHeader;
-      int rLen = 0, tLen = 0;
+      uint8_t name[MDNS_MAX_NAME_LEN];
+      uint8_t nameLen, nameValid;
+      uint16_t nameHash;
 
       // read over the query section 
-      for (i=0; i<qCnt; i++) {         
-         // construct service name data structures for comparison
-         const uint8_t* servNames[NumMDNSServiceRecords+2];
-         int servLens[NumMDNSServiceRecords+2];
-         uint8_t servNamePos[NumMDNSServiceRecords+2];
-         uint8_t servMatches[NumMDNSServiceRecords+2];
+      for (i=0; i<qCnt; i++) {
+         // the question name is collected in wire format, folded and hashed as it is read,
+         // and then compared against our precomputed names (see _makeWireName) in one go.
+         // first entry is our own MDNS name, the second one the general DNS-SD service,
+         // the rest are our services.
+         nameValid = mdnsReadName(&packet, &offset, name, &nameLen, &nameHash);
+
+         // if this matched a name of ours, then check wether this is an A record query
+         // (for our own name) or a PTR record query (for one of our services).
+         // if so, we'll note to send a record
+         mdnsReadPacket(&packet, offset, (uint8_t*)buf, 4);
+         offset += 4;
          
-         // first entry is our own MDNS name, the rest are our services
-         servNames[0] = (const uint8_t*)this->_bonjourName;
-         servNamePos[0] = 0;
-         servLens[0] = strlen((char*)this->_bonjourName);
-         servMatches[0] = 1;
+         if (!nameValid || buf[0] != 0 || buf[3] != 0x01 || (buf[2] != 0x00 && buf[2] != 0x80))
+            continue;
          
-         // second entry is our own the general DNS-SD service
-         servNames[1] = (const uint8_t*)DNS_SD_SERVICE;
-         servNamePos[1] = 0;
-         servLens[1] = strlen((char*)DNS_SD_SERVICE);
-         servMatches[1] = 1;
-                  
-         for (j=2; j<NumMDNSServiceRecords+2; j++)
-            if (NULL != this->_serviceRecords[j-2] && NULL != this->_serviceRecords[j-2]->servName) {
-               servNames[j] = this->_serviceRecords[j-2]->servName;
-               servLens[j] = strlen((char*)servNames[j]);
-               servMatches[j] = 1;
-               servNamePos[j] = 0;
-            } else {
-               servNames[j] = NULL;
-               servLens[j] = 0;
-               servMatches[j] = 0;
-               servNamePos[j] = 0;
-            }
-   
-         tLen = 0;
-         do {
-            ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 1);
-            offset += 1;
-            rLen = buf[0];
-            tLen += 1;
+         // the top bit of the class asks for a unicast response (QU question)
+         uint8_t* asked = (buf[2] & 0x80) ? recordsAskedForQU : recordsAskedFor;
+         
+         for (j=0; j<NumMDNSServiceRecords+2; j++) {
+            const MDNSWireName_t* wireName = this->_wireNameForRecord(j);
             
-            if (rLen > 128) {// handle DNS name compression, kinda, sorta            
-               ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 1);
-               offset += 1;
-               
-               for (j=0; j<NumMDNSServiceRecords+2; j++) {
-                  if (servNamePos[j] && servNamePos[j] != buf[0]) {
-                     servMatches[j] = 0;
-                  }
-               }
-               
-               tLen += 1;
-            } else if (rLen > 0) {
-               int tr = rLen, ir;
-               
-               while (tr > 0) {
-                  ir = (tr > sizeof(DNSHeader_t)) ? sizeof(DNSHeader_t) : tr;
-                  
-                  ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, ir);
-                  offset += ir;
-                  tr -= ir;
-                  
-                  for (j=0; j<NumMDNSServiceRecords+2; j++) {
-                     if (!recordsAskedFor[j] && servMatches[j])
-                        servMatches[j] &= this->_matchStringPart(&servNames[j], &servLens[j], buf,
-                                                                 ir);
-                  }
-               }
-               
-               tLen += rLen;
+            if (NULL != wireName && nameHash == wireName->hash && nameLen == wireName->len &&
+                0 == memcmp(name, wireName->data, nameLen)) {
+               if (0 == j && 0x01 == buf[1])
+                  asked[0] |= MDNS_ANSWER_ADDRESS;
+               else if (0 == j && 0x1c == buf[1])
+                  asked[0] |= MDNS_ANSWER_NO_IPV6;
+               else if (1 == j && 0x0c == buf[1]) {
+                  // service type enumeration, list all of our service types
+                  int k;
+                  for (k=2; k<NumMDNSServiceRecords+2; k++)
+                     asked[k] |= MDNS_ANSWER_TYPE;
+               } else if (1 < j && (0x0c == buf[1] || 0x10 == buf[1] || 0x21 == buf[1]))
+                  asked[j] |= MDNS_ANSWER_SERVICE;
             }
-         } while (rLen > 0 && rLen <= 128);
-
-         // if this matched a name of ours (and there are no characters left), then
-         // check wether this is an A record query (for our own name) or a PTR record query
-         // (for one of our services).
-         // if so, we'll note to send a record
-         ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 4);
-         offset += 4;
+         }
+      }
+      
+      // known-answer suppression (RFC 6762, section 7.1): the querier lists the records
+      // it already has in the answer section, we don't repeat those that have at least
+      // half of their TTL left.
+      for (i=0; i<aCnt; i++) {
+         uint8_t isHost = 0, isDNSSD = 0, services[NumMDNSServiceRecords];
+         
+         nameValid = mdnsReadName(&packet, &offset, name, &nameLen, &nameHash);
+         
+         // type, class, ttl and data length
+         mdnsReadPacket(&packet, offset, (uint8_t*)buf, 10);
+         offset += 10;
+         rdOffset = offset;
+         offset += ethutil_ntohs(*((uint16_t*)&buf[8]));
          
+         if (!nameValid || 0x00 != buf[0] || 0x01 != (buf[3] | ((buf[2] & 0x7f) << 8)) ||
+             ethutil_ntohl(*((uint32_t*)&buf[4])) < MDNS_RESPONSE_TTL/2)
+            continue;
+         
+         // which of our names is this record for?
          for (j=0; j<NumMDNSServiceRecords+2; j++) {
-            if (!recordsAskedFor[j] && servNames[j] && servMatches[j] && 0 == servLens[j]) {
-               if (0 == servNamePos[j])
-                  servNamePos[j] = offset - 4 - tLen;
+            const MDNSWireName_t* wireName = this->_wireNameForRecord(j);
+            uint8_t matches = (NULL != wireName && nameHash == wireName->hash &&
+                               nameLen == wireName->len &&
+                               0 == memcmp(name, wireName->data, nameLen));
+            
+            if (0 == j)
+               isHost = matches;
+            else if (1 == j)
+               isDNSSD = matches;
+            else
+               services[j-2] = matches;
+         }
+         
+         if (0x01 == buf[1] && isHost) {
+            // A record, check that it is our current address
+            uint8_t myIp[4];
+            ethernet_compat_read_SIPR(myIp);
+            mdnsReadPacket(&packet, rdOffset, (uint8_t*)buf, 4);
+            
+            if (0 == memcmp(buf, myIp, 4)) {
+               recordsAskedFor[0] &= ~MDNS_ANSWER_ADDRESS;
+               recordsAskedFor[0] |= MDNS_KNOWN_ADDRESS;
+               recordsAskedForQU[0] &= ~MDNS_ANSWER_ADDRESS;
+               recordsAskedForQU[0] |= MDNS_KNOWN_ADDRESS;
+            }
+         } else if (0x0c == buf[1] && (isDNSSD || NULL != memchr(services, 1, NumMDNSServiceRecords))) {
+            // PTR record, check where it points to
+            nameValid = mdnsReadName(&packet, &rdOffset, name, &nameLen, &nameHash);
+            
+            for (j=0; j<NumMDNSServiceRecords && nameValid; j++) {
+               MDNSServiceRecord_t* record = this->_serviceRecords[j];
+               if (NULL == record)
+                  continue;
                
-               if (buf[0] == 0 && buf[3] == 0x01 &&
-                  (buf[2] == 0x00 || buf[2] == 0x80)) {
-                  
-                  if ((0 == j && 0x01 == buf[1]) || (0 < j && (0x0c == buf[1] || 0x10 == buf[1] || 0x21 == buf[1])))
-                     recordsAskedFor[j] = 1;
-                  else if (0 == j && 0x1c == buf[1])
-                     wantsIPv6Addr = 1;
+               if (isDNSSD && nameHash == record->wireServName.hash &&
+                   nameLen == record->wireServName.len &&
+                   0 == memcmp(name, record->wireServName.data, nameLen)) {
+                  recordsAskedFor[j+2] &= ~MDNS_ANSWER_TYPE;
+                  recordsAskedForQU[j+2] &= ~MDNS_ANSWER_TYPE;
+               } else if (services[j] && mdnsWireNameEquals(name, nameLen, record->name,
+                                                          this->_postfixForProtocol(record->proto))) {
+                  recordsAskedFor[j+2] &= ~MDNS_ANSWER_SERVICE;
+                  recordsAskedForQU[j+2] &= ~MDNS_ANSWER_SERVICE;
                }
             }
          }
@@ -761,13 +1156,13 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
             tLen = 0;
                         
             do {
-               ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 1);
+               mdnsReadPacket(&packet, offset, (uint8_t*)buf, 1);
                offset += 1;
                rLen = buf[0];
                tLen += 1;
             
                if (rLen > 128) { // handle DNS name compression, kinda, sorta...                         
-                  ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 1);
+                  mdnsReadPacket(&packet, offset, (uint8_t*)buf, 1);
                   offset += 1;
 
                   for (j=0; j<2; j++) {
@@ -795,7 +1190,7 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                      while (tr > 0) {
                         ir = (tr > sizeof(DNSHeader_t)) ? sizeof(DNSHeader_t) : tr;
                   
-                        ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, ir);
+                        mdnsReadPacket(&packet, offset, (uint8_t*)buf, ir);
                         offset += ir;
                         tr -= ir;
                   
@@ -840,7 +1235,7 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                
                uint8_t packetHandled = 0;
                               
-               ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 4);
+               mdnsReadPacket(&packet, offset, (uint8_t*)buf, 4);
                offset += 4;
                
                if (i < qCnt+aCnt) {
@@ -858,7 +1253,7 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                            recordsFound[j] = 1;
                         
                            // this is an A or PTR type response. Parse it as such.
-                           ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 6);
+                           mdnsReadPacket(&packet, offset, (uint8_t*)buf, 6);
                            offset += 6;
                         
                            //uint32_t ttl = ethutil_ntohl(*(uint32_t*)buf);
@@ -866,7 +1261,7 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                         
                            if (0 == j && 4 == dataLen) {
                               // ok, this is the IP address. report it via callback.
-                              ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 4);
+                              mdnsReadPacket(&packet, offset, (uint8_t*)buf, 4);
                               
                               this->_finishedResolvingName((char*)this->_resolveNames[0],
                                                            (const byte*)buf);
@@ -882,10 +1277,10 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                                  uint8_t* ptrName = (uint8_t*)my_malloc(l);
                               
                                  if (ptrName) {
-                                    ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset),
+                                    mdnsReadPacket(&packet, offset,
                                              (uint8_t*)buf, 1);
                                     
-                                    ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset+1),
+                                    mdnsReadPacket(&packet, offset+1,
                                              (uint8_t*)ptrName, l-1);
                                  
                                     if (buf[0] < l-1)
@@ -915,14 +1310,14 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                               ((firstNamePtrByte && firstNamePtrByte == ptrOffsets[j]) ||
                               (0 == ptrLensCmp[j] && ptrNamesMatches[j]))) {
                            // we have found the matching SRV location packet to a previous SRV domain
-                           ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 6);
+                           mdnsReadPacket(&packet, offset, (uint8_t*)buf, 6);
                            offset += 6;
                      
                            //uint32_t ttl = ethutil_ntohl(*(uint32_t*)buf);
                            uint16_t dataLen = ethutil_ntohs(*(uint16_t*)&buf[4]);
 
                            if (dataLen >= 8) {
-                              ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 8);
+                              mdnsReadPacket(&packet, offset, (uint8_t*)buf, 8);
                               
                               ptrPorts[j] = ethutil_ntohs(*(uint16_t*)&buf[4]);
                               
@@ -945,7 +1340,7 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                               ((firstNamePtrByte && firstNamePtrByte == ptrOffsets[j]) ||
                               (0 == ptrLensCmp[j] && ptrNamesMatches[j]))) {
                            
-                           ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 6);
+                           mdnsReadPacket(&packet, offset, (uint8_t*)buf, 6);
                            offset += 6;
 
                            //uint32_t ttl = ethutil_ntohl(*(uint32_t*)buf);
@@ -955,7 +1350,7 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                            if (dataLen > 1 && NULL == servTxt[j]) {
                               servTxt[j] = (uint8_t*)my_malloc(dataLen+1);
                               if (NULL != servTxt[j]) {
-                                 ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)servTxt[j],
+                                 mdnsReadPacket(&packet, offset, (uint8_t*)servTxt[j],
                                            dataLen);
                               
                                  // zero-terminate
@@ -974,13 +1369,13 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                         if (0 == servIPs[j][0]) {
                            servIPs[j][0] = firstNamePtrByte ? firstNamePtrByte : 255;
                      
-                           ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 6);
+                           mdnsReadPacket(&packet, offset, (uint8_t*)buf, 6);
                            offset += 6;
                         
                            uint16_t dataLen = ethutil_ntohs(*(uint16_t*)&buf[4]);
                         
                            if (4 == dataLen) {
-                              ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset),
+                              mdnsReadPacket(&packet, offset,
                                         (uint8_t*)&servIPs[j][1], 4);
                            }
                         
@@ -996,7 +1391,7 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
                // eat the answer
                if (!packetHandled) {
                   offset += 4; // ttl
-                  ethernet_compat_read_data(this->_socket, (uint8_t*)(ptr+offset), (uint8_t*)buf, 2); // length
+                  mdnsReadPacket(&packet, offset, (uint8_t*)buf, 2); // length
                   offset += 2 + ethutil_ntohs(*(uint16_t*)buf); // skip over content
                }
             }
@@ -1058,6 +1453,9 @@ MDNSError_t EthernetBonjourClass::_processMDNSQuery()
    ethernet_compat_write_SnCR(this->_socket, ECSnCrSockRecv);
 
    while(ethernet_compat_read_SnCR(this->_socket));
+   
+   // now, answer everything we were asked for, or schedule it to be answered
+   this->_scheduleMDNSResponse(peer_addr, xid, recordsAskedFor, recordsAskedForQU);
 
 errorReturn:
 
@@ -1066,25 +1464,71 @@ errorReturn:
       my_free(dnsHeader);
 #endif
    
-   // now, handle the requests
-   for (j=0; j<NumMDNSServiceRecords+2; j++) {
-      if (recordsAskedFor[j]) {
-         if (0 == j)
-            (void)this->_sendMDNSMessage(peer_addr, xid, (int)MDNSPacketTypeMyIPAnswer, 0);
-         else if (1 == j) {
-            uint8_t k = 2;
-            for (k=0; k<NumMDNSServiceRecords; k++)
-               recordsAskedFor[k+2] = 1;
-         } else if (NULL != this->_serviceRecords[j-2])
-            (void)this->_sendMDNSMessage(peer_addr, xid, (int)MDNSPacketTypeServiceRecord, j-2);
+   return statusCode;
+}
+
+// decides how and when to answer a query (RFC 6762, sections 5.4, 6 and 6.2): QU questions
+// are answered by unicast unless we haven't multicast the record for a quarter of its TTL,
+// no record is multicast more than once per MDNS_MULTICAST_INTERVAL, and answers holding
+// shared records are delayed randomly and aggregated, to be sent from run().
+void EthernetBonjourClass::_scheduleMDNSResponse(uint32_t peerAddress, uint32_t xid,
+                                                 uint8_t* answers, uint8_t* unicastAnswers)
+{
+   unsigned long now = millis();
+   uint8_t isShared = 0;
+   int i, j;
+   
+   for (i=0; i<NumMDNSServiceRecords+2; i++) {
+      for (j=0; j<2; j++) {
+         uint8_t flag = (1 << j);
+         
+         if ((unicastAnswers[i] & flag) &&
+             now - this->_lastMulticastMillis[i][j] >= MDNS_UNICAST_INTERVAL) {
+            unicastAnswers[i] &= ~flag;
+            answers[i] |= flag;
+         }
       }
+      
+      // a record that goes out by multicast anyway doesn't need to be sent to the querier
+      unicastAnswers[i] &= ~(answers[i] & MDNS_ANSWER_MASK);
    }
    
-   // if we were asked for our IPv6 address, say that we don't have any
-   if (wantsIPv6Addr)
-      (void)this->_sendMDNSMessage(peer_addr, xid, (int)MDNSPacketTypeNoIPv6AddrAvailable, 0);
+   // with no socket free to answer from, the querier gets its answers by multicast
+   if (MDNSTryLater == this->_sendMDNSResponse(peerAddress, xid, unicastAnswers))
+      for (i=0; i<NumMDNSServiceRecords+2; i++)
+         answers[i] |= (unicastAnswers[i] & MDNS_ANSWER_MASK);
+
+   this->_limitMulticast(answers, now);
    
-   return statusCode;
+   // everything but our host's records is shared
+   for (i=2; i<NumMDNSServiceRecords+2; i++)
+      isShared |= answers[i];
+   
+   if (!isShared) {
+      (void)this->_sendMDNSResponse(0, 0, answers);
+      return;
+   }
+   
+   if (!this->_answersPending) {
+      this->_pendingAnswersMillis = now + random(MDNS_RESPONSE_DELAY_MIN,
+                                                 MDNS_RESPONSE_DELAY_MAX+1);
+      this->_answersPending = 1;
+   }
+   
+   // known answers only apply to the querier that sent them
+   for (i=0; i<NumMDNSServiceRecords+2; i++)
+      this->_pendingAnswers[i] |= (answers[i] & MDNS_ANSWER_MASK);
+}
+
+// drops all records from answers that we multicast less than MDNS_MULTICAST_INTERVAL ago
+void EthernetBonjourClass::_limitMulticast(uint8_t* answers, unsigned long now)
+{
+   int i, j;
+   
+   for (i=0; i<NumMDNSServiceRecords+2; i++)
+      for (j=0; j<2; j++)
+         if (now - this->_lastMulticastMillis[i][j] < MDNS_MULTICAST_INTERVAL)
+            answers[i] &= ~(1 << j);
 }
 
 void EthernetBonjourClass::run()
@@ -1092,9 +1536,21 @@ void EthernetBonjourClass::run()
    uint8_t i;
    unsigned long now = millis();
    
-   // first, look for MDNS queries to handle
+   // close the last unicast reply's socket if it has gone out
+   (void)this->_finishUnicastReply();
+   
+   // then look for MDNS queries to handle
    (void)_processMDNSQuery();
    
+   // send the answers we delayed, if it is time to do so
+   if (this->_answersPending && (long)(now - this->_pendingAnswersMillis) >= 0) {
+      this->_limitMulticast(this->_pendingAnswers, now);
+      (void)this->_sendMDNSResponse(0, 0, this->_pendingAnswers);
+      
+      memset(this->_pendingAnswers, 0, sizeof(this->_pendingAnswers));
+      this->_answersPending = 0;
+   }
+   
    // are we querying a name or service? if so, should we resend the packet or time out?
    for (i=0; i<2; i++) {
       if (NULL != this->_resolveNames[i]) {
@@ -1165,6 +1621,13 @@ int EthernetBonjourClass::setBonjourName(const char* bonjourName)
    strcpy((char*)this->_bonjourName, bonjourName);
    strcpy((char*)this->_bonjourName+strlen(bonjourName), MDNS_TLD);
    
+   this->_freeWireName(&this->_bonjourWireName);
+   if (!this->_makeWireName(&this->_bonjourWireName, this->_bonjourName)) {
+      my_free(this->_bonjourName);
+      this->_bonjourName = NULL;
+      return 0;
+   }
+   
    return 1;
 }
 
@@ -1191,7 +1654,8 @@ int EthernetBonjourClass::addServiceRecord(const char* name, uint16_t port,
          if (NULL == this->_serviceRecords[i]) {
             record = (MDNSServiceRecord_t*)my_malloc(sizeof(MDNSServiceRecord_t));
             if (NULL != record) {
-               record->name = record->textContent = NULL;
+               record->name = record->servName = record->textContent = NULL;
+               memset(&record->wireServName, 0, sizeof(MDNSWireName_t));
                
                record->name = (uint8_t*)my_malloc(strlen((char*)name));
                if (NULL == record->name)
@@ -1217,6 +1681,9 @@ int EthernetBonjourClass::addServiceRecord(const char* name, uint16_t port,
                   const uint8_t* srv_type = this->_postfixForProtocol(proto);
                   if (srv_type)
                      strcat((char*)record->servName, (const char*)srv_type);
+                  
+                  if (!this->_makeWireName(&record->wireServName, record->servName))
+                     goto errorReturn;
                }
 
                this->_serviceRecords[i] = record;
@@ -1238,6 +1705,7 @@ errorReturn:
          my_free(record->name);
       if (NULL != record->servName)
          my_free(record->servName);
+      this->_freeWireName(&record->wireServName);
       if (NULL != record->textContent)
          my_free(record->textContent);
       
@@ -1258,6 +1726,12 @@ void EthernetBonjourClass::_removeServiceRecord(int idx)
       if (NULL != this->_serviceRecords[idx]->servName)
          my_free(this->_serviceRecords[idx]->servName);
       
+      this->_freeWireName(&this->_serviceRecords[idx]->wireServName);
+      
+      this->_pendingAnswers[idx+2] = 0;
+      this->_lastMulticastMillis[idx+2][0] = this->_lastMulticastMillis[idx+2][1] =
+         millis() - MDNS_UNICAST_INTERVAL;
+      
       my_free(this->_serviceRecords[idx]->name);
       my_free(this->_serviceRecords[idx]);
       
@@ -1290,56 +1764,89 @@ void EthernetBonjourClass::removeAllServiceRecords()
       this->_removeServiceRecord(i);
 }
 
-void EthernetBonjourClass::_writeDNSName(const uint8_t* name, uint16_t* pPtr,
-                                         uint8_t* buf, int bufSize, int zeroTerminate)
+// writes the labels of name, followed by those of postfix (if not NULL), as one DNS name.
+// while a message is being built, the longest ending already written earlier in the
+// message is replaced by a compression pointer.
+void EthernetBonjourClass::_writeDNSName(const uint8_t* name, const uint8_t* postfix,
+                                         uint16_t* pPtr, uint8_t* buf, int bufSize)
 {
-   uint16_t ptr = *pPtr;
-   uint8_t* p1 = (uint8_t*)name, *p2, *p3;
-   int i, c, len;
+   MDNSNameTable_t* table = this->_nameTable;
+   MDNSLabelIter_t it, next;
+   const uint8_t* label;
+   uint8_t len, i, match = MDNS_NO_PARENT, first = 0, prev = MDNS_NO_PARENT;
+   uint16_t ptr = *pPtr, target;
+   int used = 0;
    
-   while(*p1) {
-      c = 1;
-      p2 = p1;
-      while (0 != *p2 && '.' != *p2) { p2++; c++; };
-
-      p3 = buf;
-      i = c;
-      len = bufSize-1;
-      *p3++ = (uint8_t)--i;
-      while (i-- > 0) {
-         *p3++ = *p1++;
-
-         if (--len <= 0) {
-            ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, bufSize);
-            ptr += bufSize;
-            len = bufSize;
-            p3 = buf;
+   it.p = name;
+   it.postfix = postfix;
+   
+   if (NULL != table)
+      first = table->count;
+   
+   for (;;) {
+      if (NULL != table && MDNS_NO_PARENT != (match = mdnsFindSuffix(table, &it)))
+         break;
+      
+      next = it;
+      if (NULL == (label = mdnsNextLabel(&next, &len)))
+         break;
+      
+      // remember where this label goes, chained to the label that will follow it
+      if (NULL != table) {
+         if (table->count < MDNS_MAX_NAME_OFFSETS) {
+            MDNSNameOffset_t* entry = &table->entries[table->count];
+            entry->label = label;
+            entry->len = len;
+            entry->parent = MDNS_PENDING_PARENT;
+            entry->offset = ptr + used - table->start;
+            
+            if (MDNS_NO_PARENT != prev)
+               table->entries[prev].parent = table->count;
+            prev = table->count++;
+         } else {
+            // out of entries, the rest of this name is written out in full
+            table->count = first;
+            table = NULL;
          }
       }
-
-      while ('.' == *p1)
-         ++p1;
-
-      if (len != bufSize) {
-         ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, bufSize-len);
-         ptr += bufSize-len;
-      }
+      
+      mdnsPutByte(this->_socket, len, &ptr, buf, bufSize, &used);
+      for (i=0; i<len; i++)
+         mdnsPutByte(this->_socket, label[i], &ptr, buf, bufSize, &used);
+      
+      it = next;
    }
    
-   if (zeroTerminate) {
-      buf[0] = 0;
-      ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 1);
-      ptr += 1;
+   if (MDNS_NO_PARENT != match) {
+      target = table->entries[match].offset;
+      mdnsPutByte(this->_socket, 0xC0 | (uint8_t)(target >> 8), &ptr, buf, bufSize, &used);
+      mdnsPutByte(this->_socket, (uint8_t)(target & 0xFF), &ptr, buf, bufSize, &used);
+   } else
+      mdnsPutByte(this->_socket, 0, &ptr, buf, bufSize, &used);
+   
+   if (NULL != table && MDNS_NO_PARENT != prev)
+      table->entries[prev].parent = match;
+   
+   if (used > 0) {
+      ethernet_compat_write_data(this->_socket, buf, (uint8_t*)ptr, used);
+      ptr += used;
    }
       
    *pPtr = ptr;
 }
 
+// fills in the data length at lenPtr for record data ending at endPtr
+void EthernetBonjourClass::_writeDataLength(uint16_t lenPtr, uint16_t endPtr, uint8_t* buf)
+{
+   *((uint16_t*)buf) = ethutil_htons((uint16_t)(endPtr - lenPtr - 2));
+   ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)lenPtr, 2);
+}
+
 void EthernetBonjourClass::_writeMyIPAnswerRecord(uint16_t* pPtr, uint8_t* buf, int bufSize)
 {
    uint16_t ptr = *pPtr;
    
-   this->_writeDNSName(this->_bonjourName, &ptr, buf, bufSize, 1);
+   this->_writeDNSName(this->_bonjourName, NULL, &ptr, buf, bufSize);
 
    buf[0] = 0x00;
    buf[1] = 0x01;
@@ -1365,21 +1872,13 @@ void EthernetBonjourClass::_writeServiceRecordName(int recordIndex, uint16_t* pP
                                                    int bufSize, int tld)
 {
    uint16_t ptr = *pPtr;
-      
-   uint8_t* name = tld ? this->_serviceRecords[recordIndex]->servName :
-                         this->_serviceRecords[recordIndex]->name;
-   
-   this->_writeDNSName(name, &ptr, buf, bufSize, tld);
    
-   if (0 == tld) {
-      const uint8_t* srv_type =
-         this->_postfixForProtocol(this->_serviceRecords[recordIndex]->proto);
-   
-      if (NULL != srv_type) {
-         srv_type++; // eat the dot at the beginning
-         this->_writeDNSName(srv_type, &ptr, buf, bufSize, 1);
-      }
-   }
+   if (tld)
+      this->_writeDNSName(this->_serviceRecords[recordIndex]->servName, NULL, &ptr, buf, bufSize);
+   else
+      this->_writeDNSName(this->_serviceRecords[recordIndex]->name,
+                          this->_postfixForProtocol(this->_serviceRecords[recordIndex]->proto),
+                          &ptr, buf, bufSize);
    
    *pPtr = ptr;
 }
@@ -1399,14 +1898,154 @@ void EthernetBonjourClass::_writeServiceRecordPTR(int recordIndex, uint16_t* pPt
    // ttl
    *((uint32_t*)&buf[4]) = ethutil_htonl(ttl);
    
-   // data length (+13 = "._tcp.local" or "._udp.local" + 1  byte zero termination)
-   *((uint16_t*)&buf[8]) =
-         ethutil_htons(strlen((char*)this->_serviceRecords[recordIndex]->name) + 13);
+   // data length, filled in once the (compressed) name is written
+   uint16_t lenPtr = ptr + 8;
    
    ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 10);
    ptr += 10;
    
    this->_writeServiceRecordName(recordIndex, &ptr, buf, bufSize, 0);
+   this->_writeDataLength(lenPtr, ptr, buf);
+   
+   *pPtr = ptr;
+}
+
+void EthernetBonjourClass::_writeServiceRecordSRV(int recordIndex, uint16_t* pPtr, uint8_t* buf,
+                                                  int bufSize)
+{
+   uint16_t ptr = *pPtr;
+   
+   this->_writeServiceRecordName(recordIndex, &ptr, buf, bufSize, 0);
+   
+   buf[0] = 0x00;
+   buf[1] = 0x21;    // SRV record
+   buf[2] = 0x80;    // cache flush
+   buf[3] = 0x01;    // class IN
+   
+   // ttl
+   *((uint32_t*)&buf[4]) = ethutil_htonl(MDNS_RESPONSE_TTL);
+   
+   // data length, filled in once the (compressed) target is written
+   uint16_t lenPtr = ptr + 8;
+   
+   ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 10);
+   ptr += 10;
+   
+   // priority and weight
+   buf[0] = buf[1] = buf[2] = buf[3] = 0;
+   
+   // port
+   *((uint16_t*)&buf[4]) = ethutil_htons(this->_serviceRecords[recordIndex]->port);
+   
+   ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 6);
+   ptr += 6;
+   
+   // target
+   this->_writeDNSName(this->_bonjourName, NULL, &ptr, buf, bufSize);
+   this->_writeDataLength(lenPtr, ptr, buf);
+   
+   *pPtr = ptr;
+}
+
+void EthernetBonjourClass::_writeServiceRecordTXT(int recordIndex, uint16_t* pPtr, uint8_t* buf,
+                                                  int bufSize)
+{
+   uint16_t ptr = *pPtr;
+   const uint8_t* textContent = this->_serviceRecords[recordIndex]->textContent;
+   
+   this->_writeServiceRecordName(recordIndex, &ptr, buf, bufSize, 0);
+   
+   buf[0] = 0x00;
+   buf[1] = 0x10;    // TXT record
+   buf[2] = 0x80;    // cache flush
+   buf[3] = 0x01;    // class IN
+   
+   // ttl
+   *((uint32_t*)&buf[4]) = ethutil_htonl(MDNS_RESPONSE_TTL);
+   
+   ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 8);
+   ptr += 8;
+   
+   // data length && text
+   if (NULL == textContent) {
+      buf[0] = 0x00;
+      buf[1] = 0x01;
+      buf[2] = 0x00;
+      ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 3);
+      ptr += 3;
+   } else {
+      int slen = strlen((char*)textContent);
+      *((uint16_t*)buf) = ethutil_htons(slen);
+      ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 2);
+      ptr += 2;
+      ethernet_compat_write_data(this->_socket, (uint8_t*)textContent, (uint8_t*)ptr, slen);
+      ptr += slen;
+   }
+   
+   *pPtr = ptr;
+}
+
+// the DNS-SD service type enumeration record, pointing at our service type
+void EthernetBonjourClass::_writeServiceTypePTR(int recordIndex, uint16_t* pPtr, uint8_t* buf,
+                                                int bufSize)
+{
+   uint16_t ptr = *pPtr;
+   
+   this->_writeDNSName((const uint8_t*)DNS_SD_SERVICE, NULL, &ptr, buf, bufSize);
+   
+   buf[0] = 0x00;
+   buf[1] = 0x0c;    // PTR record
+   buf[2] = 0x00;    // no cache flush
+   buf[3] = 0x01;    // class IN
+   
+   // ttl
+   *((uint32_t*)&buf[4]) = ethutil_htonl(MDNS_RESPONSE_TTL);
+   
+   // data length, filled in once the (compressed) name is written
+   uint16_t lenPtr = ptr + 8;
+   
+   ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 10);
+   ptr += 10;
+   
+   this->_writeServiceRecordName(recordIndex, &ptr, buf, bufSize, 1);
+   this->_writeDataLength(lenPtr, ptr, buf);
+   
+   *pPtr = ptr;
+}
+
+// since the WIZnet doesn't have IPv6, we assert that our name has no AAAA record by
+// means of an NSEC record listing only the A record (RFC 6762, section 6.1)
+void EthernetBonjourClass::_writeNoIPv6Record(uint16_t* pPtr, uint8_t* buf, int bufSize)
+{
+   uint16_t ptr = *pPtr;
+   
+   this->_writeDNSName(this->_bonjourName, NULL, &ptr, buf, bufSize);
+   
+   buf[0] = 0x00;
+   buf[1] = 0x2f;    // NSEC record
+   buf[2] = 0x80;    // cache flush
+   buf[3] = 0x01;    // class IN
+   
+   // ttl
+   *((uint32_t*)&buf[4]) = ethutil_htonl(MDNS_RESPONSE_TTL);
+   
+   // data length, filled in once the (compressed) next domain name is written
+   uint16_t lenPtr = ptr + 8;
+   
+   ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 10);
+   ptr += 10;
+   
+   // next domain name is our own name again
+   this->_writeDNSName(this->_bonjourName, NULL, &ptr, buf, bufSize);
+   
+   // type bitmap: window 0, one byte, just the A record
+   buf[0] = 0x00;
+   buf[1] = 0x01;
+   buf[2] = 0x40;
+   ethernet_compat_write_data(this->_socket, (uint8_t*)buf, (uint8_t*)ptr, 3);
+   ptr += 3;
+   
+   this->_writeDataLength(lenPtr, ptr, buf);
    
    *pPtr = ptr;
 }
@@ -1418,6 +2057,70 @@ uint8_t* EthernetBonjourClass::_findFirstDotFromRight(const uint8_t* str)
    return (uint8_t*)&p[2];
 }
 
+// converts a dotted name into a freshly allocated, case-folded wire-format name
+// return values:
+// 1 on success
+// 0 otherwise
+int EthernetBonjourClass::_makeWireName(MDNSWireName_t* wireName, const uint8_t* name)
+{
+   uint8_t data[MDNS_MAX_NAME_LEN];
+   uint8_t len = 0;
+   uint16_t hash = MDNS_HASH_SEED;
+   const uint8_t *p1 = name, *p2;
+   
+   while (*p1) {
+      p2 = p1;
+      while (0 != *p2 && '.' != *p2)
+         p2++;
+      
+      if (p2 - p1 > 63 || !mdnsWireNameAppend(data, &len, &hash, (uint8_t)(p2 - p1)))
+         return 0;
+      
+      while (p1 < p2)
+         if (!mdnsWireNameAppend(data, &len, &hash, *p1++))
+            return 0;
+      
+      while ('.' == *p1)
+         ++p1;
+   }
+   
+   if (!mdnsWireNameAppend(data, &len, &hash, 0))
+      return 0;
+   
+   wireName->data = (uint8_t*)my_malloc(len);
+   if (NULL == wireName->data)
+      return 0;
+   
+   memcpy(wireName->data, data, len);
+   wireName->len = len;
+   wireName->hash = hash;
+   
+   return 1;
+}
+
+void EthernetBonjourClass::_freeWireName(MDNSWireName_t* wireName)
+{
+   if (NULL != wireName->data)
+      my_free(wireName->data);
+   
+   memset(wireName, 0, sizeof(MDNSWireName_t));
+}
+
+// index 0 is our own MDNS name, 1 the general DNS-SD service, the rest are our services
+const MDNSWireName_t* EthernetBonjourClass::_wireNameForRecord(int idx)
+{
+   const MDNSWireName_t* wireName = NULL;
+   
+   if (0 == idx)
+      wireName = &this->_bonjourWireName;
+   else if (1 == idx)
+      wireName = &this->_dnsSDWireName;
+   else if (NULL != this->_serviceRecords[idx-2])
+      wireName = &this->_serviceRecords[idx-2]->wireServName;
+   
+   return (NULL != wireName && NULL != wireName->data) ? wireName : NULL;
+}
+
 int EthernetBonjourClass::_matchStringPart(const uint8_t** pCmpStr, int* pCmpLen, const uint8_t* buf,
                                            int dataLen)
 {
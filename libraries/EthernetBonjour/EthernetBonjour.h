@@ -57,12 +57,38 @@ typedef enum _MDNSServiceProtocol_t {
 
 typedef MDNSServiceProtocol_t MDNSServiceProtocol;
 
+// a name in DNS wire format (length-prefixed labels, zero terminated), folded to
+// lower case, along with its length and hash for matching incoming questions
+typedef struct _MDNSWireName_t {
+   uint8_t*                data;
+   uint8_t                 len;
+   uint16_t                hash;
+} MDNSWireName_t;
+
+#define  MDNS_MAX_NAME_OFFSETS   (12)
+
+// a label already written to the message being sent, so that later names ending in
+// the same labels can point back at it instead of repeating them
+typedef struct _MDNSNameOffset_t {
+   const uint8_t*          label;      // in the dotted name it was written from
+   uint8_t                 len;
+   uint8_t                 parent;     // entry of the rest of the name, 0xFF for none
+   uint16_t                offset;     // from the start of the message
+} MDNSNameOffset_t;
+
+typedef struct _MDNSNameTable_t {
+   uint16_t                start;      // chip address of the message
+   uint8_t                 count;
+   MDNSNameOffset_t        entries[MDNS_MAX_NAME_OFFSETS];
+} MDNSNameTable_t;
+
 typedef struct _MDNSServiceRecord_t {
    uint16_t                port;
    MDNSServiceProtocol_t   proto;
    uint8_t*                name;
    uint8_t*                servName;
    uint8_t*                textContent;
+   MDNSWireName_t          wireServName;
 } MDNSServiceRecord_t;
 
 typedef void (*BonjourNameFoundCallback)(const char*, const byte[4]);
@@ -76,11 +102,20 @@ class EthernetBonjourClass
 private:
    MDNSDataInternal_t    _mdnsData;
    int                  _socket;
+   int                  _replySocket;
    MDNSState_t           _state;
    uint8_t*             _bonjourName;
+   MDNSWireName_t       _bonjourWireName;
+   MDNSWireName_t       _dnsSDWireName;
+   MDNSNameTable_t*     _nameTable;
    MDNSServiceRecord_t* _serviceRecords[NumMDNSServiceRecords];
    unsigned long        _lastAnnounceMillis;
    
+   uint8_t              _pendingAnswers[NumMDNSServiceRecords+2];
+   uint8_t              _answersPending;
+   unsigned long        _pendingAnswersMillis;
+   unsigned long        _lastMulticastMillis[NumMDNSServiceRecords+2][2];
+   
    uint8_t*             _resolveNames[2];
    unsigned long        _resolveLastSendMillis[2];
    unsigned long        _resolveTimeouts[2];
@@ -92,22 +127,36 @@ private:
 
    MDNSError_t _processMDNSQuery();
    MDNSError_t _sendMDNSMessage(uint32_t peerAddress, uint32_t xid, int type, int serviceRecord);
+   MDNSError_t _sendMDNSResponse(uint32_t peerAddress, uint32_t xid, const uint8_t* answers);
+   void _scheduleMDNSResponse(uint32_t peerAddress, uint32_t xid, uint8_t* answers,
+                              uint8_t* unicastAnswers);
+   void _limitMulticast(uint8_t* answers, unsigned long now);
+   int _finishUnicastReply();
 
    int _startMDNSSession();
    int _closeMDNSSession();
    
-   void _writeDNSName(const uint8_t* name, uint16_t* pPtr, uint8_t* buf, int bufSize,
-                      int zeroTerminate);
+   void _writeDNSName(const uint8_t* name, const uint8_t* postfix, uint16_t* pPtr, uint8_t* buf,
+                      int bufSize);
+   void _writeDataLength(uint16_t lenPtr, uint16_t endPtr, uint8_t* buf);
    void _writeMyIPAnswerRecord(uint16_t* pPtr, uint8_t* buf, int bufSize);
    void _writeServiceRecordName(int recordIndex, uint16_t* pPtr, uint8_t* buf, int bufSize, int tld);
    void _writeServiceRecordPTR(int recordIndex, uint16_t* pPtr, uint8_t* buf, int bufSize,
                                uint32_t ttl);
+   void _writeServiceRecordSRV(int recordIndex, uint16_t* pPtr, uint8_t* buf, int bufSize);
+   void _writeServiceRecordTXT(int recordIndex, uint16_t* pPtr, uint8_t* buf, int bufSize);
+   void _writeServiceTypePTR(int recordIndex, uint16_t* pPtr, uint8_t* buf, int bufSize);
+   void _writeNoIPv6Record(uint16_t* pPtr, uint8_t* buf, int bufSize);
    
    int _initQuery(uint8_t idx, const char* name, unsigned long timeout);
    void _cancelQuery(uint8_t idx);
    
    uint8_t* _findFirstDotFromRight(const uint8_t* str);
    
+   int _makeWireName(MDNSWireName_t* wireName, const uint8_t* name);
+   void _freeWireName(MDNSWireName_t* wireName);
+   const MDNSWireName_t* _wireNameForRecord(int idx);
+   
    void _removeServiceRecord(int idx);
    
    int _matchStringPart(const uint8_t** pCmpStr, int* pCmpLen, const uint8_t* buf,
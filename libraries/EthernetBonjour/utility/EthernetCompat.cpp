@@ -38,19 +38,40 @@ const uint8_t ECSnCrSockSend     = Sock_SEND;
 const uint8_t ECSnCrSockRecv     = Sock_RECV;
 const uint8_t ECSnMrUDP          = SnMR::UDP;
 const uint8_t ECSnMrMulticast    = SnMR::MULTI;
+const uint8_t ECSnIrSendOk       = SnIR::SEND_OK;
+const uint8_t ECSnIrTimeout      = SnIR::TIMEOUT;
+
+// every byte the W5100 reads or writes takes a frame of its own, so the
+// register and buffer accesses below count one frame per byte
+#if defined(ETHERNET_COMPAT_STATS)
+static uint32_t ethernet_compat_spi_frames = 0;
+#define COUNT_SPI_FRAMES(n)  (ethernet_compat_spi_frames += (n))
+#else
+#define COUNT_SPI_FRAMES(n)
+#endif
 
 #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
   inline static void initSS()    { DDRB  |=  _BV(4); };
-  inline static void setSS()     { PORTB &= ~_BV(4); };
+  inline static void setSS()     { PORTB &= ~_BV(4); COUNT_SPI_FRAMES(1); };
   inline static void resetSS()   { PORTB |=  _BV(4); };
 #else
   inline static void initSS()    { DDRB  |=  _BV(2); };
-  inline static void setSS()     { PORTB &= ~_BV(2); };
+  inline static void setSS()     { PORTB &= ~_BV(2); COUNT_SPI_FRAMES(1); };
   inline static void resetSS()   { PORTB |=  _BV(2); };
 #endif
 
+// the W5100's SPI mode has no burst frame: each byte needs its own
+// opcode and address, so a run of bytes costs one frame and 4 SPI bytes
+// apiece, the same as writing them one at a time. the only difference
+// is that the bus is claimed once for the run rather than per byte.
+// return values:
+// the number of bytes written
 uint16_t ethernet_compat_write_private(uint16_t _addr, uint8_t *_buf, uint16_t _len)
 {
+#if defined(SPI_ETHERNET_SETTINGS)
+   SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+#endif
+
    for (int i=0; i<_len; i++) {
       setSS();    
       SPI.transfer(0xF0);
@@ -60,6 +81,11 @@ uint16_t ethernet_compat_write_private(uint16_t _addr, uint8_t *_buf, uint16_t _
       SPI.transfer(_buf[i]);
       resetSS();
    }
+
+#if defined(SPI_ETHERNET_SETTINGS)
+   SPI.endTransaction();
+#endif
+
    return _len;
 }
 
@@ -82,6 +108,7 @@ void ethernet_compat_close(int s)
 
 uint16_t ethernet_compat_read_SnTX_WR(int socket)
 {
+   COUNT_SPI_FRAMES(2);
    return W5100.readSnTX_WR(socket);
 }
 
@@ -91,7 +118,7 @@ void ethernet_compat_write_data(int socket, uint8_t* src, uint8_t* dst, uint16_t
    uint16_t dst_mask;
    uint16_t dst_ptr, dst_ptr_base;
 
-   dst_mask = (uint16_t)dst & SMASK;
+   dst_mask = (uint16_t)(uintptr_t)dst & SMASK;
    dst_ptr_base = TXBUF_BASE + socket * W5100Class::SSIZE;
    dst_ptr = dst_ptr_base + dst_mask;
 
@@ -108,79 +135,118 @@ void ethernet_compat_write_data(int socket, uint8_t* src, uint8_t* dst, uint16_t
 
 uint16_t ethernet_compat_read_SnRX_RSR(int socket)
 {
+   COUNT_SPI_FRAMES(2);
    return W5100.readSnRX_RSR(socket);
 }
 
 uint16_t ethernet_compat_read_SnRX_RD(int socket)
 {
+   COUNT_SPI_FRAMES(2);
    return W5100.readSnRX_RD(socket);
 }
 
 void ethernet_compat_read_data(int socket, uint8_t* src, uint8_t* dst, uint16_t len)
 {
+   COUNT_SPI_FRAMES(len);
    W5100.read_data(socket, src, dst, len);
 }
 
 uint8_t ethernet_compat_read_SnSr(int socket)
 {
+   COUNT_SPI_FRAMES(1);
    return W5100.readSnSR(socket);
 }
 
 uint8_t ethernet_compat_read_SnCR(int socket)
 {
+   COUNT_SPI_FRAMES(1);
    return W5100.readSnCR(socket);
 }
 
+uint8_t ethernet_compat_read_SnIR(int socket)
+{
+   COUNT_SPI_FRAMES(1);
+   return W5100.readSnIR(socket);
+}
+
 void ethernet_compat_write_DHAR(int socket, uint8_t* macAddr)
 {
+   COUNT_SPI_FRAMES(6);
    W5100.writeSnDHAR(socket, macAddr);
 }
 
 void ethernet_compat_write_SnDIPR(int socket, uint8_t* serverIpAddr)
 {
+   COUNT_SPI_FRAMES(4);
    W5100.writeSnDIPR(socket, serverIpAddr);
 }
 
 void ethernet_compat_write_SnDPORT(int socket, uint16_t port)
 {
+   COUNT_SPI_FRAMES(2);
    W5100.writeSnDPORT(socket, port);
 }
 
 void ethernet_compat_write_SnTX_WR(int socket, uint16_t ptr)
 {
+   COUNT_SPI_FRAMES(2);
    W5100.writeSnTX_WR(socket, ptr);
 }
 
 void ethernet_compat_write_SnCR(int socket, uint8_t cmd)
 {
+   COUNT_SPI_FRAMES(1);
    W5100.writeSnCR(socket, cmd);
 }
 
 void ethernet_compat_write_SnRX_RD(int socket, uint16_t ptr)
 {
+   COUNT_SPI_FRAMES(2);
    W5100.writeSnRX_RD(socket, ptr);
 }
 
+void ethernet_compat_write_SnIR(int socket, uint8_t flags)
+{
+   COUNT_SPI_FRAMES(1);
+   W5100.writeSnIR(socket, flags);
+}
+
 void ethernet_compat_read_SIPR(uint8_t* dst)
 {
+   COUNT_SPI_FRAMES(4);
    W5100.readSIPR(dst);
 }
 
 void ethernet_compat_write_SIPR(uint8_t* ipAddr)
 {
+   COUNT_SPI_FRAMES(4);
    W5100.writeSIPR(ipAddr);
 }
 
 void ethernet_compat_write_GAR(uint8_t* gatewayAddr)
 {
+   COUNT_SPI_FRAMES(4);
    W5100.writeGAR(gatewayAddr);
 }
 
 void ethernet_compat_write_SUBR(uint8_t* subnetMask)
 {
+   COUNT_SPI_FRAMES(4);
    W5100.writeSUBR(subnetMask);
 }
 
+#if defined(ETHERNET_COMPAT_STATS)
+uint32_t ethernet_compat_spi_transactions()
+{
+   return ethernet_compat_spi_frames;
+}
+
+void ethernet_compat_reset_spi_transactions()
+{
+   ethernet_compat_spi_frames = 0;
+}
+#endif
+
 #else // Arduino before 0019
 
 extern "C" {
@@ -196,6 +262,8 @@ const uint8_t ECSnCrSockSend     = Sn_CR_SEND;
 const uint8_t ECSnCrSockRecv     = Sn_CR_RECV;
 const uint8_t ECSnMrUDP          = Sn_MR_UDP;
 const uint8_t ECSnMrMulticast    = Sn_MR_MULTI;
+const uint8_t ECSnIrSendOk       = Sn_IR_SEND_OK;
+const uint8_t ECSnIrTimeout      = Sn_IR_TIMEOUT;
 
 void ethernet_compat_init(uint8_t* macAddr, uint8_t* ipAddr, uint16_t rxtx_bufsize)
 {
@@ -254,6 +322,11 @@ uint8_t ethernet_compat_read_SnCR(int socket)
    return IINCHIP_READ(Sn_CR(socket));
 }
 
+uint8_t ethernet_compat_read_SnIR(int socket)
+{
+   return IINCHIP_READ(Sn_IR(socket));
+}
+
 void ethernet_compat_write_DHAR(int socket, uint8_t* macAddr)
 {
    for (uint8_t i=0; i<6; i++)
@@ -289,6 +362,11 @@ void ethernet_compat_write_SnRX_RD(int socket, uint16_t ptr)
    IINCHIP_WRITE((Sn_RX_RD0(socket) + 1),(vuint8)(ptr & 0x00ff));
 }
 
+void ethernet_compat_write_SnIR(int socket, uint8_t flags)
+{
+   IINCHIP_WRITE(Sn_IR(socket), flags);
+}
+
 void ethernet_compat_read_SIPR(uint8_t* dst)
 {
    getSIPR(dst);
@@ -23,6 +23,13 @@
 
 #define __ETHERNET_COMPAT_BONJOUR__
 
+// uncomment to count the SPI frames sent to the Ethernet chip, one per
+// byte read or written (the W5100 has no multi-byte frame, so runs of
+// bytes count the same), e.g. to compare parsing strategies against a
+// mock of the chip. ethernet_compat_init, _socket and _close go through
+// the Ethernet library and aren't counted.
+//#define ETHERNET_COMPAT_STATS
+
 #include <stdint.h>
 
 extern const uint8_t ECSockClosed;
@@ -30,6 +37,8 @@ extern const uint8_t ECSnCrSockSend;
 extern const uint8_t ECSnCrSockRecv;
 extern const uint8_t ECSnMrUDP;
 extern const uint8_t ECSnMrMulticast;
+extern const uint8_t ECSnIrSendOk;
+extern const uint8_t ECSnIrTimeout;
 
 void ethernet_compat_init(uint8_t* macAddr, uint8_t* ipAddr, uint16_t rxtx_bufsize);
 
@@ -44,6 +53,7 @@ uint16_t ethernet_compat_read_SnRX_RSR(int socket);
 uint16_t ethernet_compat_read_SnRX_RD(int socket);
 uint8_t ethernet_compat_read_SnSr(int socket);
 uint8_t ethernet_compat_read_SnCR(int socket);
+uint8_t ethernet_compat_read_SnIR(int socket);
 
 void ethernet_compat_write_DHAR(int socket, uint8_t* macAddr);
 void ethernet_compat_write_SnDIPR(int socket, uint8_t* serverIpAddr);
@@ -51,10 +61,16 @@ void ethernet_compat_write_SnDPORT(int socket, uint16_t port);
 void ethernet_compat_write_SnTX_WR(int socket, uint16_t ptr);
 void ethernet_compat_write_SnCR(int socket, uint8_t cmd);
 void ethernet_compat_write_SnRX_RD(int socket, uint16_t ptr);
+void ethernet_compat_write_SnIR(int socket, uint8_t flags);
 
 void ethernet_compat_read_SIPR(uint8_t* dst);
 void ethernet_compat_write_SIPR(uint8_t* ipAddr);
 void ethernet_compat_write_GAR(uint8_t* gatewayAddr);
 void ethernet_compat_write_SUBR(uint8_t* subnetMask);
 
+#if defined(ETHERNET_COMPAT_STATS)
+uint32_t ethernet_compat_spi_transactions();
+void ethernet_compat_reset_spi_transactions();
+#endif
+
 #endif // __ETHERNET_COMPAT_H__
\ No newline at end of file